@@ -1,8 +1,35 @@
 #include <benchmark/benchmark.h>
 
+#include <array>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+
+#include "bitboard.h"
+#include "cpu.h"
+#include "engine.h"
+#include "eval.h"
 #include "hash_table.h"
+#include "logging.h"
+#include "movegen.h"
+#include "pgn.h"
+#include "position.h"
+#include "search.h"
+#include "tracing.h"
+
+using shepichess::Bitboard;
 
 constexpr size_t kTestHashSize = 24;
+constexpr int kSearchDepth = 7;
+const std::string kMiddlegameFen {
+  "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP2BPPP/R1BQK2R w KQ - 0 8"};
+// Blocked positions where neither side can make progress, so the search is
+// dominated by shuffling lines that repeat
+const std::string kFortressFens[] = {
+  "8/8/1k6/1p1p1p2/1P1P1P2/2K5/8/8 w - - 0 1",
+  "8/5k2/8/5p2/2p2P2/2P3K1/8/4B3 w - - 0 1",
+  "6k1/5p2/6pP/6P1/8/8/1R6/6K1 b - - 0 1"};
 
 static void BM_HashTableStash(benchmark::State& state)
 {
@@ -23,6 +50,275 @@ static void BM_HashTableProbe(benchmark::State& state)
   }
 }
 
+// Fixed depth search with state.range(0) PV lines, the time relative to the
+// single PV run is the MultiPV overhead
+static void BM_SearchMultiPV(benchmark::State& state)
+{
+  shepichess::initLogging();
+  shepichess::setLogLevel(shepichess::LogLevel::off);
+  shepichess::bitboards::init();
+  shepichess::ThreadPool threads(1);
+  shepichess::HashTable tt(kTestHashSize);
+  std::stringstream out;
+  shepichess::UCIOutput output(out);
+  shepichess::Search search(threads, tt, output);
+  shepichess::Position position;
+  position.setFen(kMiddlegameFen);
+  shepichess::SearchLimits limits;
+  limits.depth = kSearchDepth;
+  limits.multi_pv = static_cast<int>(state.range(0));
+  uint64_t nodes = 0;
+  for ([[maybe_unused]] auto _ : state) {
+    state.PauseTiming();
+    tt.clear();
+    out.str("");
+    state.ResumeTiming();
+    limits.start_time = shepichess::SearchLimits::Clock::now();
+    search.start(position, limits);
+    search.wait();
+    nodes += search.nodes();
+  }
+  state.counters["nodes"] = benchmark::Counter(
+    static_cast<double>(nodes), benchmark::Counter::kAvgIterations);
+}
+
+// Fixed depth search of a fortress position, where upcoming repetition
+// detection cuts the shuffling lines
+static void BM_SearchFortress(benchmark::State& state)
+{
+  shepichess::initLogging();
+  shepichess::setLogLevel(shepichess::LogLevel::off);
+  shepichess::bitboards::init();
+  shepichess::ThreadPool threads(1);
+  shepichess::HashTable tt(kTestHashSize);
+  std::stringstream out;
+  shepichess::UCIOutput output(out);
+  shepichess::Search search(threads, tt, output);
+  shepichess::Position position;
+  position.setFen(kFortressFens[state.range(0)]);
+  shepichess::SearchLimits limits;
+  limits.depth = static_cast<int>(state.range(1));
+  uint64_t nodes = 0;
+  for ([[maybe_unused]] auto _ : state) {
+    state.PauseTiming();
+    tt.clear();
+    out.str("");
+    state.ResumeTiming();
+    limits.start_time = shepichess::SearchLimits::Clock::now();
+    search.start(position, limits);
+    search.wait();
+    nodes += search.nodes();
+  }
+  state.counters["nodes"] = benchmark::Counter(
+    static_cast<double>(nodes), benchmark::Counter::kAvgIterations);
+}
+
+// Nodes per second of the bench command's fixed depth searches
+static void BM_SearchNps(benchmark::State& state)
+{
+  shepichess::initLogging();
+  shepichess::setLogLevel(shepichess::LogLevel::off);
+  shepichess::bitboards::init();
+  std::stringstream out;
+  shepichess::Engine engine(out, kTestHashSize);
+  uint64_t nodes = 0;
+  for ([[maybe_unused]] auto _ : state) {
+    nodes += engine.bench(static_cast<int>(state.range(0))).nodes;
+    out.str("");
+  }
+  state.counters["nps"] =
+    benchmark::Counter(static_cast<double>(nodes), benchmark::Counter::kIsRate);
+}
+
+// Forced mates and their length in moves
+const std::pair<std::string, int> kMateSuite[] = {
+  {"r1b1kb1r/pppp1ppp/5q2/4n3/3KP3/2N3PN/PPP4P/R1BQ1B1R b kq - 0 1", 3},
+  {"6k1/pp4p1/2p5/2bp4/8/P5Pb/1P3rrP/2BRRN1K b - - 0 1", 2},
+  {"5rk1/1p1q2bp/p2pN1p1/2pP2Bn/2P3P1/1P6/P4QKP/5R2 w - - 1 1", 2},
+  {"r2qkb1r/pp2nppp/3p4/2pNN1B1/2BnP3/3P4/PPP2PPP/R2bK2R w KQkq - 1 1", 2},
+  {"8/8/8/8/8/3k4/8/3K3Q w - - 0 1", 6}};
+
+// The mate suite solved with go mate (state.range(0) == 1) or with an alpha-beta
+// search to the mate's depth, solved counts the mates each found
+static void BM_MateSuite(benchmark::State& state)
+{
+  shepichess::initLogging();
+  shepichess::setLogLevel(shepichess::LogLevel::off);
+  shepichess::bitboards::init();
+  shepichess::ThreadPool threads(1);
+  shepichess::HashTable tt(kTestHashSize);
+  std::stringstream out;
+  shepichess::UCIOutput output(out);
+  shepichess::Search search(threads, tt, output);
+  shepichess::Position position;
+  shepichess::SearchLimits limits;
+  uint64_t nodes = 0, solved = 0;
+  for ([[maybe_unused]] auto _ : state) {
+    for (auto&& [fen, moves] : kMateSuite) {
+      state.PauseTiming();
+      tt.clear();
+      out.str("");
+      position.setFen(fen);
+      limits.clear();
+      if (state.range(0) == 1) {
+        limits.mate = moves;
+      } else {
+        limits.depth = 2 * moves - 1;
+      }
+      state.ResumeTiming();
+      limits.start_time = shepichess::SearchLimits::Clock::now();
+      search.start(position, limits);
+      search.wait();
+      nodes += search.nodes();
+      if (search.score() == shepichess::kMateScore - (2 * moves - 1)) solved++;
+    }
+  }
+  state.counters["nodes"] = benchmark::Counter(
+    static_cast<double>(nodes), benchmark::Counter::kAvgIterations);
+  state.counters["solved"] = benchmark::Counter(
+    static_cast<double>(solved), benchmark::Counter::kAvgIterations);
+}
+
+// Creates an engine with a 1MB table of its own (state.range(0) == 0) or from a
+// pool, and measures its memory after a shallow search
+static void BM_EngineCreate(benchmark::State& state)
+{
+  shepichess::initLogging();
+  shepichess::setLogLevel(shepichess::LogLevel::off);
+  std::stringstream out;
+  shepichess::HashTablePool pool {1};
+  shepichess::Position position;
+  shepichess::SearchLimits limits;
+  limits.depth = 1;
+  uint64_t bytes = 0;
+  for ([[maybe_unused]] auto _ : state) {
+    auto engine = state.range(0) == 0
+      ? std::make_unique<shepichess::Engine>(out, 1, false)
+      : std::make_unique<shepichess::Engine>(out, pool);
+    state.PauseTiming();
+    engine->go(position, limits);
+    engine->wait();
+    bytes += engine->memoryUsage();
+    engine.reset();
+    out.str("");
+    state.ResumeTiming();
+  }
+  state.counters["bytes"] = benchmark::Counter(
+    static_cast<double>(bytes), benchmark::Counter::kAvgIterations);
+}
+
+// Games of pseudo-random legal moves with comments and NAGs, written like a
+// database export
+static std::string generatePgn(int games, int plies)
+{
+  shepichess::bitboards::init();
+  std::string pgn;
+  shepichess::Position position;
+  shepichess::MoveList moves;
+  for (int game = 0; game < games; game++) {
+    pgn += "[Event \"bench\"]\n[Round \"" + std::to_string(game + 1) + "\"]\n\n";
+    position.setStartPosition();
+    for (int ply = 0; ply < plies; ply++) {
+      shepichess::generateLegalMoves(position, moves);
+      if (moves.size() == 0) break;
+      shepichess::Move move = moves[(game * 7 + ply * 13) % moves.size()];
+      if (ply % 2 == 0) pgn += std::to_string(ply / 2 + 1) + ". ";
+      pgn += shepichess::moveToSAN(position, move) + ' ';
+      if (ply % 20 == 9) pgn += "{[%clk 0:05:00]} $1 ";
+      position.makeMove(move);
+    }
+    pgn += "*\n\n";
+  }
+  return pgn;
+}
+
+// Games indexed per second, from splitting the text to the sorted records
+static void BM_PgnIndex(benchmark::State& state)
+{
+  shepichess::initLogging();
+  shepichess::setLogLevel(shepichess::LogLevel::off);
+  static const std::string pgn = generatePgn(2000, 80);
+  std::vector<uint64_t> game_offsets;
+  shepichess::PgnIndexStats stats;
+  uint64_t games = 0;
+  for ([[maybe_unused]] auto _ : state) {
+    auto records = shepichess::indexPgn(
+      pgn, static_cast<int>(state.range(0)), game_offsets, stats);
+    benchmark::DoNotOptimize(records.data());
+    games += stats.games;
+  }
+  state.counters["games"] =
+    benchmark::Counter(static_cast<double>(games), benchmark::Counter::kIsRate);
+}
+
+// Occupancy and white's rook-like and bishop-like sliders in a middlegame
+static std::array<Bitboard, 3> middlegameSliders()
+{
+  using shepichess::Color, shepichess::PieceType;
+  shepichess::bitboards::init();
+  shepichess::Position position;
+  position.setFen(kMiddlegameFen);
+  Bitboard queens = position.piecesByType(Color::White, PieceType::Queen);
+  return {
+    position.occupied(),
+    position.piecesByType(Color::White, PieceType::Rook) | queens,
+    position.piecesByType(Color::White, PieceType::Bishop) | queens};
+}
+
+// Attacks of all of white's sliders, one magic lookup per piece against setwise
+// fills
+static void BM_SliderAttacksMagic(benchmark::State& state)
+{
+  auto [occupancy, rooks, bishops] = middlegameSliders();
+  for ([[maybe_unused]] auto _ : state) {
+    benchmark::DoNotOptimize(occupancy);
+    Bitboard attacks = 0;
+    for (Bitboard set = rooks; set; set = shepichess::bitboards::poplsb(set)) {
+      attacks |= shepichess::attack_maps::rookAttacks(
+        shepichess::bitboards::bitscan(set), occupancy);
+    }
+    for (Bitboard set = bishops; set; set = shepichess::bitboards::poplsb(set)) {
+      attacks |= shepichess::attack_maps::bishopAttacks(
+        shepichess::bitboards::bitscan(set), occupancy);
+    }
+    benchmark::DoNotOptimize(attacks);
+  }
+}
+
+// With the generic (0) or AVX2 (3) variant
+static void BM_SliderAttacksSetwise(benchmark::State& state)
+{
+  auto level = static_cast<shepichess::CpuLevel>(state.range(0));
+  shepichess::CpuLevel previous = shepichess::cpuLevel();
+  if (!shepichess::setCpuLevel(level)) {
+    state.SkipWithError("Instruction set not supported by this host");
+    return;
+  }
+  state.SetLabel(std::string(shepichess::cpuLevelName(level)));
+  auto [occupancy, rooks, bishops] = middlegameSliders();
+  for ([[maybe_unused]] auto _ : state) {
+    benchmark::DoNotOptimize(occupancy);
+    benchmark::DoNotOptimize(
+      shepichess::attack_maps::sliderAttacks(rooks, bishops, occupancy));
+  }
+  shepichess::setCpuLevel(previous);
+}
+
+// A zone with tracing off (0) or recording (1)
+static void BM_TraceZone(benchmark::State& state)
+{
+  if (state.range(0)) {
+    shepichess::startTracing("benchmark-trace.json");
+  } else {
+    shepichess::stopTracing();
+  }
+  for ([[maybe_unused]] auto _ : state) {
+    shepichess::TraceZone zone("benchmark");
+    benchmark::ClobberMemory();
+  }
+  shepichess::stopTracing();
+}
+
 // Stash benchmarks
 BENCHMARK(BM_HashTableStash)->Arg(kTestHashSize);
 BENCHMARK(BM_HashTableStash)->Threads(2)->Arg(kTestHashSize);
@@ -30,4 +326,27 @@ BENCHMARK(BM_HashTableStash)->Threads(4)->Arg(kTestHashSize);
 // Probe benchmarks
 BENCHMARK(BM_HashTableProbe)->Arg(kTestHashSize);
 BENCHMARK(BM_HashTableProbe)->Threads(2)->Arg(kTestHashSize);
-BENCHMARK(BM_HashTableProbe)->Threads(4)->Arg(kTestHashSize);
\ No newline at end of file
+BENCHMARK(BM_HashTableProbe)->Threads(4)->Arg(kTestHashSize);
+// Slider attack benchmarks
+BENCHMARK(BM_SliderAttacksMagic);
+BENCHMARK(BM_SliderAttacksSetwise)->Arg(0)->Arg(3);
+// Tracing benchmarks
+BENCHMARK(BM_TraceZone)->Arg(0)->Arg(1);
+// PGN benchmarks
+BENCHMARK(BM_PgnIndex)->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+// Search benchmarks
+BENCHMARK(BM_SearchMultiPV)
+  ->Arg(1)
+  ->Arg(2)
+  ->Arg(4)
+  ->Unit(benchmark::kMillisecond)
+  ->UseRealTime();
+BENCHMARK(BM_SearchNps)->Arg(8)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_EngineCreate)->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_MateSuite)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_SearchFortress)
+  ->Args({0, 14})
+  ->Args({1, 12})
+  ->Args({2, 10})
+  ->Unit(benchmark::kMillisecond)
+  ->UseRealTime();
@@ -6,7 +6,18 @@
 #include <random>
 #include <sstream>
 
+#include "cpu.h"
 #include "logging.h"
+#include "tracing.h"
+
+// The AVX2 slider attacks are built with a target attribute and picked at runtime
+// where that's supported, otherwise only when compiled for AVX2
+#if SHEPICHESS_MULTI_ISA || defined(__AVX2__)
+#  define SHEPICHESS_AVX2_ATTACKS 1
+#  include <immintrin.h>
+#else
+#  define SHEPICHESS_AVX2_ATTACKS 0
+#endif
 
 namespace shepichess {
 
@@ -44,6 +55,60 @@ Bitboard shiftUntilBlocker(int square, Bitboard blockers)
   return result;
 }
 
+#if SHEPICHESS_AVX2_ATTACKS
+// occludedFill and shift for four directions at once. Each lane has its own step
+// length, and mask of the squares a step can land on.
+template<bool left>
+SHEPICHESS_TARGET_AVX2 __m256i shiftLanes(__m256i boards, __m256i steps)
+{
+  return left ? _mm256_sllv_epi64(boards, steps) : _mm256_srlv_epi64(boards, steps);
+}
+
+template<bool left>
+SHEPICHESS_TARGET_AVX2 __m256i slidingAttacksx4(
+  __m256i sliders, __m256i empty, __m256i step, __m256i mask)
+{
+  __m256i two_steps = _mm256_add_epi64(step, step);
+  __m256i four_steps = _mm256_add_epi64(two_steps, two_steps);
+  __m256i propagator = _mm256_and_si256(empty, mask);
+  __m256i generators = _mm256_or_si256(
+    sliders, _mm256_and_si256(propagator, shiftLanes<left>(sliders, step)));
+  propagator = _mm256_and_si256(propagator, shiftLanes<left>(propagator, step));
+  generators = _mm256_or_si256(
+    generators, _mm256_and_si256(propagator, shiftLanes<left>(generators, two_steps)));
+  propagator = _mm256_and_si256(propagator, shiftLanes<left>(propagator, two_steps));
+  generators = _mm256_or_si256(
+    generators, _mm256_and_si256(propagator, shiftLanes<left>(generators, four_steps)));
+  return _mm256_and_si256(shiftLanes<left>(generators, step), mask);
+}
+
+SHEPICHESS_TARGET_AVX2 Bitboard sliderAttacksAVX2(
+  Bitboard rook_sliders, Bitboard bishop_sliders, Bitboard occupancy)
+{
+  auto rooks = static_cast<long long>(rook_sliders);
+  auto bishops = static_cast<long long>(bishop_sliders);
+  auto not_a = static_cast<long long>(~kFileA), not_h = static_cast<long long>(~kFileH);
+  __m256i empty = _mm256_set1_epi64x(static_cast<long long>(~occupancy));
+  // North, West, NorthEast and NorthWest shift left
+  __m256i left = slidingAttacksx4<true>(
+    _mm256_setr_epi64x(rooks, rooks, bishops, bishops),
+    empty,
+    _mm256_setr_epi64x(8, 1, 7, 9),
+    _mm256_setr_epi64x(-1, not_h, not_a, not_h));
+  // South, East, SouthEast and SouthWest shift right
+  __m256i right = slidingAttacksx4<false>(
+    _mm256_setr_epi64x(rooks, rooks, bishops, bishops),
+    empty,
+    _mm256_setr_epi64x(8, 1, 9, 7),
+    _mm256_setr_epi64x(-1, not_a, not_a, not_h));
+  __m256i attacks = _mm256_or_si256(left, right);
+  __m128i halves = _mm_or_si128(
+    _mm256_castsi256_si128(attacks), _mm256_extracti128_si256(attacks, 1));
+  return static_cast<Bitboard>(
+    _mm_extract_epi64(halves, 0) | _mm_extract_epi64(halves, 1));
+}
+#endif
+
 Bitboard generateAttacks(int square, Bitboard blockers, bool rook)
 {
   Bitboard result = 0;
@@ -163,6 +228,35 @@ static std::array<MagicData, 64> rookMap;
 static std::array<MagicData, 64> bishopMap;
 static std::array<Bitboard, 64> knightMap;
 static std::array<Bitboard, 64> kingMap;
+std::array<Bitboard, 64> attack_maps::rookRayMap;
+std::array<Bitboard, 64> attack_maps::bishopRayMap;
+std::array<std::array<Bitboard, 64>, 64> attack_maps::betweenMap;
+std::array<std::array<Bitboard, 64>, 64> attack_maps::lineMap;
+
+namespace {
+
+// Needs the slider maps
+void genLineMaps(int from)
+{
+  using namespace attack_maps;
+  Bitboard from_bb = bitboards::fromSquare(from);
+  rookRayMap[from] = rookAttacks(from, 0);
+  bishopRayMap[from] = bishopAttacks(from, 0);
+  for (int to = 0; to < 64; to++) {
+    Bitboard to_bb = bitboards::fromSquare(to);
+    if (from != to && rookAttacks(from, 0) & to_bb) {
+      betweenMap[from][to] = rookAttacks(from, to_bb) & rookAttacks(to, from_bb);
+      lineMap[from][to] =
+        (rookAttacks(from, 0) & rookAttacks(to, 0)) | from_bb | to_bb;
+    } else if (from != to && bishopAttacks(from, 0) & to_bb) {
+      betweenMap[from][to] = bishopAttacks(from, to_bb) & bishopAttacks(to, from_bb);
+      lineMap[from][to] =
+        (bishopAttacks(from, 0) & bishopAttacks(to, 0)) | from_bb | to_bb;
+    }
+  }
+}
+
+} // namespace
 static std::once_flag bitboards_init_flag;
 
 void bitboards::init()
@@ -170,6 +264,7 @@ void bitboards::init()
   using std::execution::par_unseq;
   initLogging();
   std::call_once(bitboards_init_flag, []() {
+    TraceZone zone("bitboards init");
     SPDLOG_INFO("Initializing Bitboards");
     std::array<int, 64> sq {0};
     std::iota(sq.begin(), sq.end(), 0);
@@ -179,6 +274,7 @@ void bitboards::init()
     std::transform(par_unseq, sq.begin(), sq.end(), knightMap.begin(), genKnightMap);
     std::transform(par_unseq, sq.begin(), sq.end(), rookMap.begin(), genRookMap);
     std::transform(par_unseq, sq.begin(), sq.end(), bishopMap.begin(), genBishopMap);
+    std::for_each(par_unseq, sq.begin(), sq.end(), genLineMaps);
     SPDLOG_INFO("Bitboards successfully initialized");
   });
 }
@@ -212,4 +308,36 @@ Bitboard attack_maps::queenAttacks(unsigned int square, Bitboard blockers)
   return rookAttacks(square, blockers) | bishopAttacks(square, blockers);
 }
 
-} // namespace shepichess
\ No newline at end of file
+Bitboard attack_maps::rookAttacksSetwise(Bitboard rooks, Bitboard occupancy)
+{
+  using bitboards::slidingAttacks;
+  Bitboard empty = ~occupancy;
+  return slidingAttacks<Direction::North>(rooks, empty) |
+    slidingAttacks<Direction::South>(rooks, empty) |
+    slidingAttacks<Direction::East>(rooks, empty) |
+    slidingAttacks<Direction::West>(rooks, empty);
+}
+
+Bitboard attack_maps::bishopAttacksSetwise(Bitboard bishops, Bitboard occupancy)
+{
+  using bitboards::slidingAttacks;
+  Bitboard empty = ~occupancy;
+  return slidingAttacks<Direction::NorthEast>(bishops, empty) |
+    slidingAttacks<Direction::SouthEast>(bishops, empty) |
+    slidingAttacks<Direction::SouthWest>(bishops, empty) |
+    slidingAttacks<Direction::NorthWest>(bishops, empty);
+}
+
+Bitboard attack_maps::sliderAttacks(
+  Bitboard rook_sliders, Bitboard bishop_sliders, Bitboard occupancy)
+{
+#if SHEPICHESS_AVX2_ATTACKS
+  if (cpuLevel() >= CpuLevel::AVX2) {
+    return sliderAttacksAVX2(rook_sliders, bishop_sliders, occupancy);
+  }
+#endif
+  return rookAttacksSetwise(rook_sliders, occupancy) |
+    bishopAttacksSetwise(bishop_sliders, occupancy);
+}
+
+} // namespace shepichess
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <string>
 
@@ -57,6 +58,16 @@ inline int bitscan(Bitboard);
 inline int popcount(Bitboard);
 template<Direction>
 constexpr Bitboard shift(Bitboard);
+// Shifts by several steps at once without edge masking
+template<Direction>
+constexpr Bitboard shiftSteps(Bitboard, unsigned int steps);
+// Kogge-Stone fill of every generator towards a direction through the empty
+// squares (setwise, any number of generators at once)
+template<Direction>
+constexpr Bitboard occludedFill(Bitboard generators, Bitboard empty);
+// Squares attacked towards a direction by a set of sliders, including blockers
+template<Direction>
+constexpr Bitboard slidingAttacks(Bitboard sliders, Bitboard empty);
 
 } // namespace bitboards
 
@@ -67,6 +78,27 @@ Bitboard kingAttacks(unsigned int);
 Bitboard bishopAttacks(unsigned int, Bitboard);
 Bitboard rookAttacks(unsigned int, Bitboard);
 Bitboard queenAttacks(unsigned int, Bitboard);
+// Attacks on an empty board, from small tables that stay in cache
+inline Bitboard rookRays(unsigned int);
+inline Bitboard bishopRays(unsigned int);
+// Squares strictly between two squares on a rank, file or diagonal, 0 otherwise
+inline Bitboard between(unsigned int, unsigned int);
+// The whole rank, file or diagonal through two squares, 0 if there is none
+inline Bitboard line(unsigned int, unsigned int);
+// Union of the attacks of every piece in a set, computed with occluded fills
+// instead of a table lookup per piece
+Bitboard rookAttacksSetwise(Bitboard rooks, Bitboard occupancy);
+Bitboard bishopAttacksSetwise(Bitboard bishops, Bitboard occupancy);
+// All slider attacks of a side, queens should be in both sets. Fills the eight
+// directions four at a time on AVX2 hosts, see cpu.h.
+Bitboard sliderAttacks(
+  Bitboard rook_sliders, Bitboard bishop_sliders, Bitboard occupancy);
+
+// Tables of the inline lookups, filled by bitboards::init
+extern std::array<Bitboard, 64> rookRayMap;
+extern std::array<Bitboard, 64> bishopRayMap;
+extern std::array<std::array<Bitboard, 64>, 64> betweenMap;
+extern std::array<std::array<Bitboard, 64>, 64> lineMap;
 
 } // namespace attack_maps
 
@@ -155,4 +187,58 @@ constexpr Bitboard bitboards::shift(Bitboard board)
   if constexpr (dir == Direction::SouthWest) return (board >> 7) & ~kFileH;
 }
 
+template<Direction dir>
+constexpr Bitboard bitboards::shiftSteps(Bitboard board, unsigned int steps)
+{
+  if constexpr (dir == Direction::North) return board << (8 * steps);
+  if constexpr (dir == Direction::South) return board >> (8 * steps);
+  if constexpr (dir == Direction::East) return board >> steps;
+  if constexpr (dir == Direction::West) return board << steps;
+  if constexpr (dir == Direction::NorthEast) return board << (7 * steps);
+  if constexpr (dir == Direction::SouthEast) return board >> (9 * steps);
+  if constexpr (dir == Direction::NorthWest) return board << (9 * steps);
+  if constexpr (dir == Direction::SouthWest) return board >> (7 * steps);
+}
+
+// The propagator starts as the empty squares a single step can land on, so the
+// longer steps don't need edge masks: a square only stays in it while the squares
+// behind it (up to the step length) are empty and on the board.
+template<Direction dir>
+constexpr Bitboard bitboards::occludedFill(Bitboard generators, Bitboard empty)
+{
+  Bitboard propagator = empty & shift<dir>(~Bitboard {0});
+  generators |= propagator & shift<dir>(generators);
+  propagator &= shift<dir>(propagator);
+  generators |= propagator & shiftSteps<dir>(generators, 2);
+  propagator &= shiftSteps<dir>(propagator, 2);
+  generators |= propagator & shiftSteps<dir>(generators, 4);
+  return generators;
+}
+
+template<Direction dir>
+constexpr Bitboard bitboards::slidingAttacks(Bitboard sliders, Bitboard empty)
+{
+  return shift<dir>(occludedFill<dir>(sliders, empty));
+}
+
+inline Bitboard attack_maps::rookRays(unsigned int square)
+{
+  return rookRayMap[square];
+}
+
+inline Bitboard attack_maps::bishopRays(unsigned int square)
+{
+  return bishopRayMap[square];
+}
+
+inline Bitboard attack_maps::between(unsigned int from, unsigned int to)
+{
+  return betweenMap[from][to];
+}
+
+inline Bitboard attack_maps::line(unsigned int from, unsigned int to)
+{
+  return lineMap[from][to];
+}
+
 } // namespace shepichess
@@ -0,0 +1,54 @@
+#include "cpu.h"
+
+#include <array>
+#include <atomic>
+
+namespace shepichess {
+
+namespace {
+
+std::atomic<CpuLevel> active_level {detectCpuLevel()};
+
+} // namespace
+
+CpuLevel detectCpuLevel()
+{
+#if SHEPICHESS_MULTI_ISA
+  // libgcc checks the OS saves the AVX registers before reporting avx2
+  __builtin_cpu_init();
+  bool popcnt = __builtin_cpu_supports("popcnt");
+  bool bmi2 = popcnt && __builtin_cpu_supports("bmi") && __builtin_cpu_supports("bmi2");
+  if (bmi2 && __builtin_cpu_supports("avx2")) return CpuLevel::AVX2;
+  if (bmi2) return CpuLevel::BMI2;
+  return popcnt ? CpuLevel::Popcnt : CpuLevel::Generic;
+#elif defined(__AVX2__)
+  return CpuLevel::AVX2;
+#elif defined(__BMI2__)
+  return CpuLevel::BMI2;
+#elif defined(__POPCNT__)
+  return CpuLevel::Popcnt;
+#else
+  return CpuLevel::Generic;
+#endif
+}
+
+CpuLevel cpuLevel()
+{
+  return active_level.load(std::memory_order_relaxed);
+}
+
+bool setCpuLevel(CpuLevel level)
+{
+  if (level > detectCpuLevel()) return false;
+  active_level = level;
+  return true;
+}
+
+std::string_view cpuLevelName(CpuLevel level)
+{
+  constexpr std::array<std::string_view, kCpuLevelCount> kNames {
+    "generic", "popcnt", "bmi2", "avx2"};
+  return kNames[static_cast<int>(level)];
+}
+
+} // namespace shepichess
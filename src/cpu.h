@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string_view>
+
+namespace shepichess {
+
+// Instruction set levels of the host. Each level includes the ones below. Only the
+// setwise slider attacks have a variant picked by level (AVX2), the rest of the
+// engine is built for the generic baseline.
+enum class CpuLevel { Generic, Popcnt, BMI2, AVX2 };
+constexpr int kCpuLevelCount = 4;
+
+// Highest level this host supports (from CPUID), or the level the binary was
+// compiled for where variants can't be built per level
+CpuLevel detectCpuLevel();
+// Level the variants run at, the detected one unless lowered with setCpuLevel
+CpuLevel cpuLevel();
+// Returns false (leaving the level unchanged) if the host doesn't support level
+bool setCpuLevel(CpuLevel level);
+std::string_view cpuLevelName(CpuLevel level);
+
+// Variants are built with target attributes on x86 with GCC and Clang. flatten
+// inlines the inline bitboard helpers into them, so they use the level's
+// instructions too.
+#if (defined(__GNUC__) || defined(__clang__)) && \
+  (defined(__x86_64__) || defined(__i386__))
+#  define SHEPICHESS_MULTI_ISA 1
+#  define SHEPICHESS_TARGET_AVX2 \
+    __attribute__((target("popcnt,bmi,bmi2,avx2"), flatten))
+#else
+#  define SHEPICHESS_MULTI_ISA 0
+#  define SHEPICHESS_TARGET_AVX2
+#endif
+
+} // namespace shepichess
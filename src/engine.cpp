@@ -0,0 +1,205 @@
+#include "engine.h"
+
+#include "bitboard.h"
+#include "movegen.h"
+
+namespace shepichess {
+
+namespace {
+
+// Openings, middlegames and endgames, quiet and tactical
+const std::string kBenchFens[] = {
+  kStartFen,
+  "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+  "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP2BPPP/R1BQK2R w KQ - 0 8",
+  "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+  "2r3k1/1q1nbppp/r3p3/3pP3/pPpP4/P1Q2N2/2RN1PPP/2R4K b - b3 0 23",
+  "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+  "8/8/1k6/1p1p1p2/1P1P1P2/2K5/8/8 w - - 0 1",
+  "6k1/5p2/6pP/6P1/8/8/1R6/6K1 b - - 0 1",
+};
+
+} // namespace
+
+Engine::Engine(std::ostream& out, int64_t hash_size, bool pin_threads)
+  : Engine(
+      out,
+      std::make_unique<HashTable>(static_cast<size_t>(hash_size)),
+      nullptr,
+      hash_size,
+      pin_threads)
+{
+}
+
+Engine::Engine(std::ostream& out, HashTablePool& pool, bool pin_threads)
+  : Engine(
+      out,
+      pool.acquire(),
+      &pool,
+      static_cast<int64_t>(pool.tableSize()),
+      pin_threads)
+{
+}
+
+Engine::Engine(
+  std::ostream& out,
+  std::unique_ptr<HashTable> table,
+  HashTablePool* pool,
+  int64_t hash_size,
+  bool pin_threads)
+  : config()
+  , tt_pool(pool)
+  , tt(std::move(table))
+  , threads(1, pin_threads)
+  , uci_output(out)
+  , search(threads, *tt, uci_output)
+{
+  // Built once per process and read-only afterwards
+  bitboards::init();
+  Position::init();
+  registerOptions(hash_size);
+}
+
+// The table only goes back to the pool once no thread can touch it
+Engine::~Engine()
+{
+  search.stop();
+  search.wait();
+  if (tt_pool) tt_pool->release(std::move(tt));
+}
+
+void Engine::registerOptions(int64_t hash_size)
+{
+  // A failed allocation keeps the old table, the option is rolled back to match
+  auto resizeHash = [this](const UCIOption& option) {
+    if (!idleFor("Hash")) return false;
+    bool resized = tt->resize(static_cast<size_t>(option.asInt()));
+    tt->reclaim();
+    if (!resized) {
+      uci_output.send("info string failed to allocate " + option.asString() +
+                      "MB of hash, keeping the old table");
+    }
+    return resized;
+  };
+  auto clearHash = [this](const UCIOption&) {
+    if (!idleFor("Clear Hash")) return false;
+    tt->clear();
+    return true;
+  };
+  auto saveHash = [this](const UCIOption&) {
+    if (!idleFor("Save Hash")) return false;
+    return tt->save(config.getOption("Hash File")->asString(), kZobristSeed);
+  };
+  auto loadHash = [this](const UCIOption&) {
+    if (!idleFor("Load Hash")) return false;
+    return tt->load(config.getOption("Hash File")->asString(), kZobristSeed);
+  };
+  auto resizeThreads = [this](const UCIOption& option) {
+    if (!idleFor("Threads")) return false;
+    threads.resize(static_cast<size_t>(option.asInt()));
+    return true;
+  };
+
+  config.addOption(UCIOption::spin("Hash", hash_size, 1, kMaxHashSize, resizeHash));
+  config.addOption(UCIOption::button("Clear Hash", clearHash));
+  config.addOption(UCIOption::string("Hash File", kDefaultHashFile));
+  config.addOption(UCIOption::button("Save Hash", saveHash));
+  config.addOption(UCIOption::button("Load Hash", loadHash));
+  config.addOption(UCIOption::spin("Threads", 1, 1, kMaxThreads, resizeThreads));
+  config.addOption(UCIOption::spin("MultiPV", 1, 1, kMaxMoves));
+  // Only tells the GUI that go ponder is supported, pondering needs no setup
+  config.addOption(UCIOption::check("Ponder", false));
+
+  // Selective search switches, for measuring each technique
+  auto toggle = [this](bool SearchParams::*param) {
+    return [this, param](const UCIOption& option) {
+      if (!idleFor(option.name())) return false;
+      SearchParams params = search.params();
+      params.*param = option.asBool();
+      search.setParams(params);
+      return true;
+    };
+  };
+  config.addOption(
+    UCIOption::check("Null Move Pruning", true, toggle(&SearchParams::null_move)));
+  config.addOption(UCIOption::check(
+    "Late Move Reductions", true, toggle(&SearchParams::late_move_reductions)));
+  config.addOption(UCIOption::check(
+    "Reverse Futility Pruning", true, toggle(&SearchParams::reverse_futility)));
+  config.addOption(UCIOption::check("Razoring", true, toggle(&SearchParams::razoring)));
+  config.addOption(UCIOption::check(
+    "QSearch Futility Pruning", true, toggle(&SearchParams::qsearch_futility)));
+  config.addOption(
+    UCIOption::check("Delta Pruning", true, toggle(&SearchParams::delta_pruning)));
+}
+
+bool Engine::idleFor(const std::string& command)
+{
+  if (search.searching()) {
+    uci_output.send("info string " + command + " ignored while searching");
+    return false;
+  }
+  search.wait();
+  return true;
+}
+
+bool Engine::setOption(const std::string& name, const std::string& value)
+{
+  return config.setOption(name, value);
+}
+
+bool Engine::newGame()
+{
+  if (!idleFor("ucinewgame")) return false;
+  tt->clear();
+  return true;
+}
+
+void Engine::go(const Position& position, SearchLimits limits)
+{
+  limits.multi_pv = static_cast<int>(config.getOption("MultiPV")->asInt());
+  search.start(position, limits);
+}
+
+void Engine::stop()
+{
+  search.stop();
+}
+
+void Engine::ponderhit()
+{
+  search.ponderhit();
+}
+
+void Engine::wait()
+{
+  search.wait();
+}
+
+size_t Engine::memoryUsage() const
+{
+  return tt->size() * sizeof(HashEntry) + search.memoryUsage();
+}
+
+BenchResult Engine::bench(int depth)
+{
+  BenchResult result;
+  auto start = SearchLimits::Clock::now();
+  Position position;
+  SearchLimits limits;
+  for (auto&& fen : kBenchFens) {
+    newGame();
+    position.setFen(fen);
+    limits.clear();
+    limits.start_time = SearchLimits::Clock::now();
+    limits.depth = depth;
+    go(position, limits);
+    wait();
+    result.nodes += nodes();
+  }
+  result.time = std::chrono::duration_cast<std::chrono::milliseconds>(
+    SearchLimits::Clock::now() - start);
+  return result;
+}
+
+} // namespace shepichess
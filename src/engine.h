@@ -0,0 +1,100 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "hash_table.h"
+#include "position.h"
+#include "search.h"
+#include "thread_pool.h"
+#include "uci_config.h"
+#include "uci_output.h"
+
+namespace shepichess {
+
+constexpr int64_t kDefaultHashSize = 16;
+constexpr int64_t kMaxHashSize = 65536;
+const inline std::string kDefaultHashFile {"shepichess.hash"};
+constexpr int64_t kMaxThreads = 1024;
+constexpr int kDefaultBenchDepth = 10;
+
+struct BenchResult {
+  uint64_t nodes = 0;
+  std::chrono::milliseconds time {0};
+};
+
+// One independent engine: its own hash table, search threads, options and
+// output. The UCI front end owns one, selfplay creates one per player.
+//
+// Engines keep no global mutable state, so any number of them can run in one
+// process, each on its own threads. They share the attack and zobrist tables,
+// which are built by the first engine and only read after that.
+//
+// Options that reconfigure the hash table, threads or search and ucinewgame are
+// refused (with an info string) while a search is running. Waiting for it could
+// block the caller until a stop it has yet to read.
+class Engine {
+public:
+  // pin_threads pins the search threads to cpus, which only helps when a single
+  // engine uses the whole machine
+  explicit Engine(
+    std::ostream& out, int64_t hash_size = kDefaultHashSize, bool pin_threads = true);
+  // Borrows its hash table from pool until it's destroyed, the pool must outlive
+  // the engine
+  Engine(std::ostream& out, HashTablePool& pool, bool pin_threads = false);
+  ~Engine();
+
+  Engine(const Engine&) = delete;
+  Engine(Engine&&) = delete;
+  Engine& operator=(const Engine&) = delete;
+  Engine& operator=(Engine&&) = delete;
+
+  [[nodiscard]] UCIConfig& options() { return config; }
+  [[nodiscard]] const UCIConfig& options() const { return config; }
+  // Returns false for unknown options or invalid values
+  bool setOption(const std::string& name, const std::string& value);
+  [[nodiscard]] UCIOutput& output() { return uci_output; }
+
+  // Returns false if refused because a search is running
+  bool newGame();
+  // Searches in the background, see Search::start
+  void go(const Position& position, SearchLimits limits);
+  void stop();
+  void ponderhit();
+  void wait();
+  [[nodiscard]] bool searching() { return search.searching(); }
+
+  // Searches a fixed set of positions to depth, each from a cleared hash table.
+  // With one thread the node count is deterministic, so it identifies changes to
+  // the search. Blocks until done.
+  BenchResult bench(int depth);
+
+  [[nodiscard]] Move bestMove() const { return search.bestMove(); }
+  [[nodiscard]] int score() const { return search.score(); }
+  [[nodiscard]] uint64_t nodes() const { return search.nodes(); }
+  // Bytes held by the hash table and search data, which grows on the first search
+  [[nodiscard]] size_t memoryUsage() const;
+
+private:
+  UCIConfig config;
+  HashTablePool* tt_pool;
+  std::unique_ptr<HashTable> tt;
+  ThreadPool threads;
+  UCIOutput uci_output;
+  Search search;
+
+  Engine(
+    std::ostream& out,
+    std::unique_ptr<HashTable> table,
+    HashTablePool* pool,
+    int64_t hash_size,
+    bool pin_threads);
+  void registerOptions(int64_t hash_size);
+  // Waits for a finished search, or refuses command while one is running
+  bool idleFor(const std::string& command);
+};
+
+} // namespace shepichess
@@ -0,0 +1,124 @@
+#include "eval.h"
+
+#include <array>
+
+namespace shepichess {
+
+namespace {
+
+using PieceSquareTable = std::array<int, 64>;
+
+// Piece square tables from white's point of view, laid out as seen on a
+// diagram (a8 first, h1 last)
+// clang-format off
+constexpr PieceSquareTable kPawnTable {
+   0,  0,  0,  0,  0,  0,  0,  0,
+  50, 50, 50, 50, 50, 50, 50, 50,
+  10, 10, 20, 30, 30, 20, 10, 10,
+   5,  5, 10, 25, 25, 10,  5,  5,
+   0,  0,  0, 20, 20,  0,  0,  0,
+   5, -5,-10,  0,  0,-10, -5,  5,
+   5, 10, 10,-20,-20, 10, 10,  5,
+   0,  0,  0,  0,  0,  0,  0,  0};
+constexpr PieceSquareTable kKnightTable {
+  -50,-40,-30,-30,-30,-30,-40,-50,
+  -40,-20,  0,  0,  0,  0,-20,-40,
+  -30,  0, 10, 15, 15, 10,  0,-30,
+  -30,  5, 15, 20, 20, 15,  5,-30,
+  -30,  0, 15, 20, 20, 15,  0,-30,
+  -30,  5, 10, 15, 15, 10,  5,-30,
+  -40,-20,  0,  5,  5,  0,-20,-40,
+  -50,-40,-30,-30,-30,-30,-40,-50};
+constexpr PieceSquareTable kBishopTable {
+  -20,-10,-10,-10,-10,-10,-10,-20,
+  -10,  0,  0,  0,  0,  0,  0,-10,
+  -10,  0,  5, 10, 10,  5,  0,-10,
+  -10,  5,  5, 10, 10,  5,  5,-10,
+  -10,  0, 10, 10, 10, 10,  0,-10,
+  -10, 10, 10, 10, 10, 10, 10,-10,
+  -10,  5,  0,  0,  0,  0,  5,-10,
+  -20,-10,-10,-10,-10,-10,-10,-20};
+constexpr PieceSquareTable kRookTable {
+   0,  0,  0,  0,  0,  0,  0,  0,
+   5, 10, 10, 10, 10, 10, 10,  5,
+  -5,  0,  0,  0,  0,  0,  0, -5,
+  -5,  0,  0,  0,  0,  0,  0, -5,
+  -5,  0,  0,  0,  0,  0,  0, -5,
+  -5,  0,  0,  0,  0,  0,  0, -5,
+  -5,  0,  0,  0,  0,  0,  0, -5,
+   0,  0,  0,  5,  5,  0,  0,  0};
+constexpr PieceSquareTable kQueenTable {
+  -20,-10,-10, -5, -5,-10,-10,-20,
+  -10,  0,  0,  0,  0,  0,  0,-10,
+  -10,  0,  5,  5,  5,  5,  0,-10,
+   -5,  0,  5,  5,  5,  5,  0, -5,
+    0,  0,  5,  5,  5,  5,  0, -5,
+  -10,  5,  5,  5,  5,  5,  0,-10,
+  -10,  0,  5,  0,  0,  0,  0,-10,
+  -20,-10,-10, -5, -5,-10,-10,-20};
+constexpr PieceSquareTable kKingMiddlegameTable {
+  -30,-40,-40,-50,-50,-40,-40,-30,
+  -30,-40,-40,-50,-50,-40,-40,-30,
+  -30,-40,-40,-50,-50,-40,-40,-30,
+  -30,-40,-40,-50,-50,-40,-40,-30,
+  -20,-30,-30,-40,-40,-30,-30,-20,
+  -10,-20,-20,-20,-20,-20,-20,-10,
+   20, 20,  0,  0,  0,  0, 20, 20,
+   20, 30, 10,  0,  0, 10, 30, 20};
+constexpr PieceSquareTable kKingEndgameTable {
+  -50,-40,-30,-20,-20,-30,-40,-50,
+  -30,-20,-10,  0,  0,-10,-20,-30,
+  -30,-10, 20, 30, 30, 20,-10,-30,
+  -30,-10, 30, 40, 40, 30,-10,-30,
+  -30,-10, 30, 40, 40, 30,-10,-30,
+  -30,-10, 20, 30, 30, 20,-10,-30,
+  -30,-30,  0,  0,  0,  0,-30,-30,
+  -50,-30,-30,-30,-30,-30,-30,-50};
+// clang-format on
+
+// Indexed by PieceType
+constexpr std::array<const PieceSquareTable*, kPieceTypeCount> kTables {
+  &kPawnTable, &kRookTable, &kKnightTable, &kBishopTable, &kQueenTable, nullptr};
+
+// Non-pawn material (per side) below which the king table switches to endgame
+constexpr int kEndgameMaterial = 1300;
+
+int tableIndex(int square, Color color)
+{
+  int rank = color == Color::White ? 7 - squareRank(square) : squareRank(square);
+  return rank * 8 + squareFile(square);
+}
+
+int evaluateSide(const Position& position, Color color, bool endgame)
+{
+  int score = position.state().material[index(color)];
+  for (int type = 0; type < kPieceTypeCount; type++) {
+    Bitboard pieces = position.piecesByType(color, static_cast<PieceType>(type));
+    const PieceSquareTable* table = kTables[type];
+    if (!table) {
+      table = endgame ? &kKingEndgameTable : &kKingMiddlegameTable;
+    }
+    for (; pieces; pieces = bitboards::poplsb(pieces)) {
+      score += (*table)[tableIndex(bitboards::bitscan(pieces), color)];
+    }
+  }
+  return score;
+}
+
+} // namespace
+
+int evaluate(const Position& position)
+{
+  const PositionState& state = position.state();
+  auto nonPawnMaterial = [&](Color color) {
+    int pawns = bitboards::popcount(position.piecesByType(color, PieceType::Pawn));
+    return state.material[index(color)] - pawns * kPieceValues[index(PieceType::Pawn)];
+  };
+  bool endgame = nonPawnMaterial(Color::White) <= kEndgameMaterial &&
+    nonPawnMaterial(Color::Black) <= kEndgameMaterial;
+  int score = evaluateSide(position, Color::White, endgame) -
+    evaluateSide(position, Color::Black, endgame);
+  return position.sideToMove() == Color::White ? score : -score;
+}
+
+} // namespace shepichess
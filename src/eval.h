@@ -0,0 +1,10 @@
+#pragma once
+
+#include "position.h"
+
+namespace shepichess {
+
+// Static evaluation in centipawns, from the side to move's point of view
+int evaluate(const Position& position);
+
+} // namespace shepichess
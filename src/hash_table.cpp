@@ -1,12 +1,59 @@
 #include "hash_table.h"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
 #include <execution>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <vector>
+
+#if !defined(_WIN32)
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+#include "logging.h"
+#include "mapped_file.h"
+#include "tracing.h"
 
 namespace shepichess {
 
 namespace {
 
+constexpr std::align_val_t kCacheLineAlignment {64};
+
+// Hash file layout: a HashFileHeader followed by the raw entries
+constexpr std::array<char, 8> kHashFileMagic {'S', 'H', 'E', 'P', 'I', 'T', 'T', '\0'};
+// Bump whenever the layout of HashEntry changes
+constexpr uint32_t kHashFileVersion = 1;
+// Written in native byte order, so files from other architectures are rejected
+constexpr uint32_t kHashFileByteOrder = 0x0102'0304;
+// Large tables are written and copied in chunks of this many bytes in parallel
+constexpr size_t kHashFileChunkSize = 16 * 1024 * 1024;
+
+struct HashFileHeader {
+  std::array<char, 8> magic;
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t entry_size;
+  uint64_t entry_count;
+  uint64_t key_seed;
+  std::array<uint64_t, 3> reserved;
+};
+static_assert(sizeof(HashFileHeader) == 64,
+              "Keep entries cache line aligned in the file");
+
+// Splits [0, size) into the start offsets of chunk_size chunks
+std::vector<size_t> chunkOffsets(size_t size, size_t chunk_size)
+{
+  std::vector<size_t> offsets((size + chunk_size - 1) / chunk_size);
+  for (size_t i = 0; i < offsets.size(); i++) offsets[i] = i * chunk_size;
+  return offsets;
+}
+
 size_t previousPowerOfTwo(size_t val)
 {
   size_t result = 1;
@@ -18,11 +65,12 @@ size_t previousPowerOfTwo(size_t val)
 
 } // namespace
 
-HashEntry::HashEntry(uint16_t depth, uint16_t eval, uint16_t best_move, HashKey key)
+HashEntry::HashEntry(
+  uint16_t depth, uint16_t eval, uint16_t best_move, HashKey key, uint16_t bound)
   : key(key)
 {
   data = static_cast<HashKey>(depth) | static_cast<HashKey>(eval) << 16 |
-    static_cast<HashKey>(best_move) << 32;
+    static_cast<HashKey>(best_move) << 32 | static_cast<HashKey>(bound) << 48;
   checksum = calculateChecksum();
 }
 
@@ -41,47 +89,233 @@ uint16_t HashEntry::bestMove() const
   return static_cast<uint16_t>(data >> 32);
 }
 
+uint16_t HashEntry::bound() const
+{
+  return static_cast<uint16_t>(data >> 48);
+}
+
 HashKey HashEntry::calculateChecksum()
 {
   return data ^ key;
 }
 
+// Falls back to the smallest table, so the object is never left without one
 HashTable::HashTable(size_t size)
 {
-  resize(size);
+  if (!resize(size)) resize(1);
 }
 
 void HashTable::clear()
 {
+  TraceZone zone("tt clear");
   std::scoped_lock clear_lock(lock);
-  std::fill(std::execution::par_unseq, table.begin(), table.end(), HashEntry {});
+  Storage& current = *table.load(std::memory_order_relaxed);
+  HashEntry* entries = current.entries.get();
+  std::fill(std::execution::par_unseq, entries, entries + current.size, HashEntry {});
 }
 
-void HashTable::resize(size_t new_size_mb)
+// Entries are left uninitialized by the allocation and zeroed in parallel, which
+// also spreads the first touch of each page over several threads.
+//
+// Searches may still be probing the old table, so it is only freed by reclaim and
+// a resize needs memory for both tables. A failed allocation keeps the old one.
+bool HashTable::resize(size_t new_size_mb)
 {
-  hash_size = previousPowerOfTwo(new_size_mb * 1024 * 1024 / sizeof(HashEntry));
+  TraceZone zone("tt resize", static_cast<int64_t>(new_size_mb));
+  auto storage = std::make_unique<Storage>();
+  storage->size = entriesFor(new_size_mb);
+  try {
+    size_t bytes = storage->size * sizeof(HashEntry);
+    void* memory = ::operator new[](bytes, kCacheLineAlignment);
+    storage->entries.reset(static_cast<HashEntry*>(memory));
+  } catch (const std::bad_alloc&) {
+    SPDLOG_ERROR("Failed to allocate a {}MB hash table", new_size_mb);
+    return false;
+  }
+  HashEntry* entries = storage->entries.get();
+  std::uninitialized_fill(
+    std::execution::par_unseq, entries, entries + storage->size, HashEntry {});
   std::scoped_lock resize_lock(lock);
-  table.resize(hash_size);
+  SPDLOG_DEBUG("Resizing hash table to {} entries", storage->size);
+  table.store(storage.get(), std::memory_order_release);
+  storages.push_back(std::move(storage));
+  return true;
+}
+
+void HashTable::reclaim()
+{
+  std::scoped_lock reclaim_lock(lock);
+  storages.erase(storages.begin(), storages.end() - 1);
+}
+
+void HashTable::AlignedDelete::operator()(HashEntry* entries) const
+{
+  ::operator delete[](entries, kCacheLineAlignment);
 }
 
 size_t HashTable::size() const
 {
-  return hash_size;
+  return table.load(std::memory_order_acquire)->size;
+}
+
+size_t HashTable::entriesFor(size_t size_mb)
+{
+  return previousPowerOfTwo(size_mb * 1024 * 1024 / sizeof(HashEntry));
+}
+
+// Chunks are written concurrently with pwrite where available
+bool HashTable::save(const std::string& path, uint64_t key_seed)
+{
+  TraceZone zone("tt save");
+  std::scoped_lock save_lock(lock);
+  const Storage& current = *table.load(std::memory_order_relaxed);
+  size_t hash_size = current.size;
+  HashFileHeader header {};
+  header.magic = kHashFileMagic;
+  header.version = kHashFileVersion;
+  header.byte_order = kHashFileByteOrder;
+  header.entry_size = sizeof(HashEntry);
+  header.entry_count = hash_size;
+  header.key_seed = key_seed;
+  const char* entries = reinterpret_cast<const char*>(current.entries.get());
+  size_t bytes = hash_size * sizeof(HashEntry);
+  SPDLOG_INFO("Saving hash table ({} entries) to \"{}\"", hash_size, path);
+
+#if defined(_WIN32)
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(entries, static_cast<std::streamsize>(bytes));
+  bool success = static_cast<bool>(file);
+#else
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    SPDLOG_ERROR("Failed to open hash file \"{}\" for writing", path);
+    return false;
+  }
+  std::atomic<bool> success =
+    writeFileAt(fd, reinterpret_cast<const char*>(&header), sizeof(header), 0);
+  std::vector<size_t> offsets = chunkOffsets(bytes, kHashFileChunkSize);
+  auto writeChunk = [&](size_t offset) {
+    size_t size = std::min(kHashFileChunkSize, bytes - offset);
+    auto file_offset = static_cast<int64_t>(sizeof(header) + offset);
+    if (!writeFileAt(fd, entries + offset, size, file_offset)) success = false;
+  };
+  std::for_each(std::execution::par, offsets.begin(), offsets.end(), writeChunk);
+  success = (::close(fd) == 0) && success;
+#endif
+  if (!success) SPDLOG_ERROR("Failed to write hash file \"{}\"", path);
+  return success;
+}
+
+bool HashTable::load(const std::string& path, uint64_t key_seed)
+{
+  TraceZone zone("tt load");
+  MappedFile file;
+  if (!file.open(path)) return false;
+  HashFileHeader header {};
+  if (file.size() < sizeof(header)) {
+    SPDLOG_ERROR("Hash file \"{}\" is too small", path);
+    return false;
+  }
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (header.magic != kHashFileMagic || header.byte_order != kHashFileByteOrder) {
+    SPDLOG_ERROR("\"{}\" is not a hash file", path);
+    return false;
+  }
+  if (header.version != kHashFileVersion || header.entry_size != sizeof(HashEntry)) {
+    SPDLOG_ERROR("Hash file \"{}\" has an incompatible entry format", path);
+    return false;
+  }
+  if (header.key_seed != key_seed) {
+    SPDLOG_ERROR("Hash file \"{}\" was made with different zobrist keys", path);
+    return false;
+  }
+  // Checked before multiplying, a corrupt count could overflow the byte count
+  size_t max_entries = (file.size() - sizeof(header)) / sizeof(HashEntry);
+  if (header.entry_count > max_entries ||
+      file.size() != sizeof(header) + header.entry_count * sizeof(HashEntry)) {
+    SPDLOG_ERROR("Hash file \"{}\" is truncated", path);
+    return false;
+  }
+  size_t bytes = header.entry_count * sizeof(HashEntry);
+
+  std::scoped_lock load_lock(lock);
+  Storage& current = *table.load(std::memory_order_relaxed);
+  size_t hash_size = current.size;
+  SPDLOG_INFO("Loading hash table ({} entries) from \"{}\"", header.entry_count, path);
+  const char* entries = file.data() + sizeof(header);
+  if (header.entry_count == hash_size) {
+    std::vector<size_t> offsets = chunkOffsets(bytes, kHashFileChunkSize);
+    char* destination = reinterpret_cast<char*>(current.entries.get());
+    auto copyChunk = [&](size_t offset) {
+      size_t size = std::min(kHashFileChunkSize, bytes - offset);
+      std::memcpy(destination + offset, entries + offset, size);
+    };
+    std::for_each(std::execution::par, offsets.begin(), offsets.end(), copyChunk);
+  } else {
+    HashEntry* destination = current.entries.get();
+    std::fill(
+      std::execution::par_unseq, destination, destination + hash_size, HashEntry {});
+    constexpr size_t kChunkEntries = kHashFileChunkSize / sizeof(HashEntry);
+    size_t count = header.entry_count;
+    std::vector<size_t> starts = chunkOffsets(count, kChunkEntries);
+    std::for_each(std::execution::par, starts.begin(), starts.end(), [&](size_t start) {
+      for (size_t i = start; i < std::min(start + kChunkEntries, count); i++) {
+        HashEntry entry;
+        std::memcpy(&entry, entries + i * sizeof(HashEntry), sizeof(HashEntry));
+        if (entry.key) stash(entry);
+      }
+    });
+  }
+  return true;
 }
 
 // stash and probe are racy, use checksum to check validity
 void HashTable::stash(HashEntry value)
 {
-  HashKey mask = hash_size - 1;
-  table[value.key & mask] = value;
+  const Storage& current = *table.load(std::memory_order_acquire);
+  current.entries[value.key & (current.size - 1)] = value;
 }
 
 std::optional<HashEntry> HashTable::probe(HashKey key) const
 {
-  HashKey mask = hash_size - 1;
-  HashEntry value = table[key & mask];
+  const Storage& current = *table.load(std::memory_order_acquire);
+  HashEntry value = current.entries[key & (current.size - 1)];
   bool found = (key == value.key && value.checksum == value.calculateChecksum());
   return found ? std::optional<HashEntry> {value} : std::nullopt;
 }
 
-} // namespace shepichess
\ No newline at end of file
+HashTablePool::HashTablePool(size_t table_size_mb) : table_size_mb(table_size_mb)
+{
+}
+
+std::unique_ptr<HashTable> HashTablePool::acquire()
+{
+  std::unique_ptr<HashTable> table;
+  {
+    std::scoped_lock acquire_lock(lock);
+    if (!tables.empty()) {
+      table = std::move(tables.back());
+      tables.pop_back();
+    }
+  }
+  // New tables are already zeroed
+  if (!table) return std::make_unique<HashTable>(table_size_mb);
+  table->clear();
+  return table;
+}
+
+void HashTablePool::release(std::unique_ptr<HashTable> table)
+{
+  if (!table || table->size() != HashTable::entriesFor(table_size_mb)) return;
+  std::scoped_lock release_lock(lock);
+  tables.push_back(std::move(table));
+}
+
+size_t HashTablePool::available()
+{
+  std::scoped_lock available_lock(lock);
+  return tables.size();
+}
+
+} // namespace shepichess
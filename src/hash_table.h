@@ -1,9 +1,12 @@
 #pragma once
 
 #include <array>
+#include <atomic>
 #include <cstdint>
+#include <memory>
 #include <mutex>
 #include <optional>
+#include <string>
 #include <vector>
 
 #include "move.h"
@@ -15,10 +18,12 @@ using HashKey = uint64_t;
 class HashEntry {
 public:
   HashEntry() = default;
-  HashEntry(uint16_t depth, uint16_t eval, uint16_t best_move, HashKey key);
+  HashEntry(
+    uint16_t depth, uint16_t eval, uint16_t best_move, HashKey key, uint16_t bound = 0);
   [[nodiscard]] uint16_t depth() const;
   [[nodiscard]] uint16_t eval() const;
   [[nodiscard]] uint16_t bestMove() const;
+  [[nodiscard]] uint16_t bound() const;
 
 private:
   friend class HashTable;
@@ -28,6 +33,13 @@ private:
   HashKey checksum = 0;
 };
 
+// Shared transposition table.
+//
+// stash and probe are lock free and may race with each other (entries carry a
+// checksum for that). The entries and their size are published together through
+// one atomic pointer, so resize can run during a search: probes see either the
+// old or the new table. Replaced tables stay allocated until reclaim, which the
+// owner calls once no search can still be probing them.
 class HashTable {
 public:
   HashTable(size_t size);
@@ -38,14 +50,58 @@ public:
   HashTable& operator=(HashTable&&) = delete;
 
   void clear();
-  void resize(size_t new_size_mb);
+  // Returns false (after logging) if the new table can't be allocated, the old
+  // one is kept then. Both tables are allocated until reclaim.
+  bool resize(size_t new_size_mb);
+  // Frees the tables replaced by resize, no search may be using the table
+  void reclaim();
   void stash(HashEntry value);
   [[nodiscard]] std::optional<HashEntry> probe(HashKey key) const;
   [[nodiscard]] size_t size() const;
+  // Number of entries of a table of size_mb megabytes
+  static size_t entriesFor(size_t size_mb);
+
+  // Writes the table to path. key_seed identifies the zobrist keys the entries
+  // were made with, files are only loaded back with the same seed.
+  bool save(const std::string& path, uint64_t key_seed);
+  // Fills the table from a file written by save. Tables of a different size are
+  // rehashed into the current one.
+  bool load(const std::string& path, uint64_t key_seed);
+
+private:
+  struct AlignedDelete {
+    void operator()(HashEntry* entries) const;
+  };
+  struct Storage {
+    std::unique_ptr<HashEntry[], AlignedDelete> entries;
+    size_t size = 0;
+  };
+  // The current table, owned by the last of storages
+  std::atomic<Storage*> table {nullptr};
+  // Replaced tables are kept until reclaim. Guarded by lock, like clear, resize,
+  // save and load.
+  std::vector<std::unique_ptr<Storage>> storages;
+  std::mutex lock;
+};
+
+// Hash tables lent to engines, so a host that creates and destroys many engines
+// reuses the allocations instead of paging in a new table for each one
+class HashTablePool {
+public:
+  explicit HashTablePool(size_t table_size_mb);
+
+  // A cleared table from the pool, or a new one when all are lent out
+  std::unique_ptr<HashTable> acquire();
+  // Takes a table back, it must not be used by a search any more. Tables that
+  // were resized since they were acquired are freed instead.
+  void release(std::unique_ptr<HashTable> table);
+  [[nodiscard]] size_t tableSize() const { return table_size_mb; }
+  // Tables waiting in the pool
+  [[nodiscard]] size_t available();
 
 private:
-  size_t hash_size = 0;
-  std::vector<HashEntry> table;
+  size_t table_size_mb;
+  std::vector<std::unique_ptr<HashTable>> tables;
   std::mutex lock;
 };
 
@@ -0,0 +1,94 @@
+#include "logging.h"
+
+#include <memory>
+#include <mutex>
+
+#include <spdlog/async.h>
+#include <spdlog/sinks/basic_file_sink.h>
+#include <spdlog/sinks/dist_sink.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+namespace shepichess {
+
+namespace {
+
+const std::string kLoggerName {"shepichess"};
+const std::string kLogPattern {"[%Y-%m-%d %H:%M:%S] [thread %t] [%^%l%$] [%s:%#] %v"};
+
+// The async logger has a fixed sink list, so sinks are swapped through a
+// thread-safe dist_sink instead.
+std::shared_ptr<spdlog::sinks::dist_sink_mt> logSinks;
+std::shared_ptr<spdlog::sinks::sink> stderrSink;
+
+} // namespace
+
+void initLogging()
+{
+  static std::once_flag init_flag;
+  std::call_once(init_flag, []() {
+    spdlog::init_thread_pool(kLogQueueSize, 1);
+    stderrSink = std::make_shared<spdlog::sinks::stderr_color_sink_mt>();
+    logSinks = std::make_shared<spdlog::sinks::dist_sink_mt>();
+    logSinks->add_sink(stderrSink);
+    // Overrun the oldest messages rather than blocking the caller when the
+    // background thread falls behind.
+    auto logger = std::make_shared<spdlog::async_logger>(
+      kLoggerName,
+      logSinks,
+      spdlog::thread_pool(),
+      spdlog::async_overflow_policy::overrun_oldest);
+    spdlog::set_default_logger(logger);
+    spdlog::set_level(kDefaultLogLevel);
+    spdlog::set_pattern(kLogPattern);
+    spdlog::flush_on(spdlog::level::err);
+  });
+}
+
+void setLogLevel(LogLevel level)
+{
+  initLogging();
+  spdlog::set_level(level);
+}
+
+bool setLogLevel(const std::string& level)
+{
+  LogLevel parsed = spdlog::level::from_str(level);
+  // from_str returns off for unrecognized names, so only accept it when requested
+  if (parsed == spdlog::level::off && level != "off") {
+    SPDLOG_ERROR("Unrecognized log level \"{}\"", level);
+    return false;
+  }
+  setLogLevel(parsed);
+  return true;
+}
+
+bool setLogFile(const std::string& path)
+{
+  initLogging();
+  std::shared_ptr<spdlog::sinks::sink> fileSink;
+  if (!path.empty()) {
+    try {
+      fileSink = std::make_shared<spdlog::sinks::basic_file_sink_mt>(path);
+    } catch (const spdlog::spdlog_ex& e) {
+      SPDLOG_ERROR("Failed to open log file \"{}\": {}", path, e.what());
+      return false;
+    }
+  }
+  spdlog::default_logger()->flush();
+  if (fileSink) {
+    logSinks->set_sinks({stderrSink, fileSink});
+  } else {
+    logSinks->set_sinks({stderrSink});
+  }
+  // dist_sink does not pass its formatter on to newly added sinks
+  spdlog::set_pattern(kLogPattern);
+  if (fileSink) SPDLOG_INFO("Logging to file \"{}\"", path);
+  return true;
+}
+
+void flushLogs()
+{
+  spdlog::default_logger()->flush();
+}
+
+} // namespace shepichess
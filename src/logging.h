@@ -1,26 +1,26 @@
 #pragma once
 
-#include <mutex>
+#include <cstddef>
+#include <string>
 
-#define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_INFO
-#include <spdlog/sinks/stdout_color_sinks.h>
+// Debug messages are compiled in so they can be enabled at runtime via "Log Level"
+#define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_DEBUG
 #include <spdlog/spdlog.h>
 
 namespace shepichess {
 
 using LogLevel = spdlog::level::level_enum;
-constexpr LogLevel kDefaultLogLevel = static_cast<LogLevel>(SPDLOG_ACTIVE_LEVEL);
+constexpr LogLevel kDefaultLogLevel = LogLevel::info;
+// Number of messages the async logger can hold before the oldest are overwritten
+constexpr std::size_t kLogQueueSize = 8192;
 
-inline void initLogging()
-{
-  static std::once_flag init_flag;
-  std::call_once(init_flag, []() {
-    static auto stderr_logger = spdlog::stderr_color_mt("shepichess_stderr_logger");
-    stderr_logger->set_level(kDefaultLogLevel);
-    spdlog::set_level(kDefaultLogLevel);
-    spdlog::set_default_logger(stderr_logger);
-    spdlog::set_pattern("[%Y-%m-%d %H:%M:%S] [thread %t] [%^%l%$] [%s:%#] %v");
-  });
-}
+// Installs a non-blocking default logger. Messages are formatted on a background
+// thread, so SPDLOG_* calls from the search never wait on stderr or disk.
+void initLogging();
+void setLogLevel(LogLevel level);
+bool setLogLevel(const std::string& level);
+// Mirrors the log into the given file, or stops file logging if path is empty
+bool setLogFile(const std::string& path);
+void flushLogs();
 
-} // namespace shepichess
\ No newline at end of file
+} // namespace shepichess
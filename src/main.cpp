@@ -1,7 +1,81 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bitboard.h"
+#include "logging.h"
+#include "pgn.h"
+#include "selfplay.h"
+#include "server.h"
+#include "tracing.h"
 #include "uci_application.h"
 
-int main()
+int main(int argc, char* argv[])
 {
+  // Output is flushed explicitly by UCIOutput, no need to sync with stdio
+  std::ios::sync_with_stdio(false);
+  std::string_view command = argc > 1 ? argv[1] : "";
+  // Set SHEPICHESS_TRACE to a file to trace from startup, it's written on quit
+  if (const char* trace = std::getenv("SHEPICHESS_TRACE"); trace && *trace) {
+    shepichess::initLogging();
+    shepichess::startTracing(trace);
+  }
+  if (command == "selfplay" || command == "datagen") {
+    shepichess::initLogging();
+    shepichess::setLogLevel(shepichess::LogLevel::warn);
+    shepichess::SelfPlayConfig config;
+    if (command == "datagen") config = shepichess::dataGenConfig();
+    if (!shepichess::parseSelfPlayArgs({argv + 2, argv + argc}, config)) return 1;
+    shepichess::SelfPlay selfplay(config, std::cout);
+    return selfplay.run() ? 0 : 1;
+  }
+  // "shepichess serve --socket path ..." serves analysis sessions until signalled
+  if (command == "serve") {
+    shepichess::initLogging();
+    shepichess::ServerConfig config;
+    if (!shepichess::parseServerArgs({argv + 2, argv + argc}, config)) return 1;
+    shepichess::AnalysisServer server(config);
+    return server.run() ? 0 : 1;
+  }
+  // "shepichess pgnindex games.pgn games.idx [threads]" indexes every position
+  if (command == "pgnindex" && argc > 3) {
+    shepichess::initLogging();
+    int threads = argc > 4 ? std::atoi(argv[4]) : 1;
+    shepichess::bitboards::init();
+    shepichess::PgnIndexStats stats;
+    auto start = std::chrono::steady_clock::now();
+    if (!shepichess::buildPgnIndex(argv[2], argv[3], threads, stats)) return 1;
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << stats.games << " games (" << stats.bad_games << " with errors), "
+              << stats.positions << " positions, "
+              << static_cast<uint64_t>(stats.games / elapsed.count()) << " games/s\n";
+    return 0;
+  }
+  // "shepichess pgnfind games.idx <fen>" lists the games a position occurs in
+  if (command == "pgnfind" && argc > 3) {
+    shepichess::initLogging();
+    shepichess::bitboards::init();
+    shepichess::PgnIndex index;
+    shepichess::Position position;
+    if (!index.open(argv[2]) || !position.setFen(argv[3])) return 1;
+    for (auto&& record : index.find(position.zobrist())) {
+      std::cout << "game " << record.game << " ply " << record.ply << " offset "
+                << index.gameOffset(record.game) << '\n';
+    }
+    return 0;
+  }
+  // "shepichess bench [depth]" runs the bench command and exits
+  if (command == "bench") {
+    std::string depth = argc > 2 ? argv[2] : "";
+    std::istringstream in {"bench " + depth + "\nquit\n"};
+    shepichess::UCIApp app(in, std::cout);
+    app.mainLoop();
+    return 0;
+  }
   shepichess::UCIApp app;
   app.mainLoop();
 }
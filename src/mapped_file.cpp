@@ -0,0 +1,154 @@
+#include "mapped_file.h"
+
+#include <utility>
+
+#if defined(_WIN32)
+#  define NOMINMAX
+#  define WIN32_LEAN_AND_MEAN
+#  include <windows.h>
+#else
+#  include <cerrno>
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+#include "logging.h"
+
+namespace shepichess {
+
+MappedFile::~MappedFile()
+{
+  close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+  *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+  if (this == &other) return *this;
+  close();
+  mapping = std::exchange(other.mapping, nullptr);
+  mapping_size = std::exchange(other.mapping_size, 0);
+  mapped_empty = std::exchange(other.mapped_empty, false);
+#if defined(_WIN32)
+  mapping_handle = std::exchange(other.mapping_handle, nullptr);
+#endif
+  return *this;
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::open(const std::string& path)
+{
+  close();
+  HANDLE file = CreateFileA(
+    path.c_str(),
+    GENERIC_READ,
+    FILE_SHARE_READ,
+    nullptr,
+    OPEN_EXISTING,
+    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+    nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    SPDLOG_ERROR("Failed to open \"{}\" for mapping", path);
+    return false;
+  }
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file, &file_size)) {
+    CloseHandle(file);
+    SPDLOG_ERROR("Failed to get size of \"{}\"", path);
+    return false;
+  }
+  if (file_size.QuadPart == 0) {
+    CloseHandle(file);
+    mapped_empty = true;
+    return true;
+  }
+  HANDLE handle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(file);
+  void* view = handle ? MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+  if (!view) {
+    if (handle) CloseHandle(handle);
+    SPDLOG_ERROR("Failed to map \"{}\"", path);
+    return false;
+  }
+  mapping_handle = handle;
+  mapping = static_cast<char*>(view);
+  mapping_size = static_cast<std::size_t>(file_size.QuadPart);
+  return true;
+}
+
+void MappedFile::close()
+{
+  if (mapping) UnmapViewOfFile(mapping);
+  if (mapping_handle) CloseHandle(mapping_handle);
+  mapping = nullptr;
+  mapping_handle = nullptr;
+  mapping_size = 0;
+  mapped_empty = false;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path)
+{
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    SPDLOG_ERROR("Failed to open \"{}\" for mapping", path);
+    return false;
+  }
+  struct stat file_stat {};
+  if (fstat(fd, &file_stat) != 0) {
+    ::close(fd);
+    SPDLOG_ERROR("Failed to get size of \"{}\"", path);
+    return false;
+  }
+  if (file_stat.st_size == 0) {
+    ::close(fd);
+    mapped_empty = true;
+    return true;
+  }
+  auto size = static_cast<std::size_t>(file_stat.st_size);
+  void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps the file alive, the descriptor isn't needed anymore
+  ::close(fd);
+  if (view == MAP_FAILED) {
+    SPDLOG_ERROR("Failed to map \"{}\"", path);
+    return false;
+  }
+  madvise(view, size, MADV_SEQUENTIAL);
+  mapping = static_cast<char*>(view);
+  mapping_size = size;
+  return true;
+}
+
+void MappedFile::close()
+{
+  if (mapping) munmap(mapping, mapping_size);
+  mapping = nullptr;
+  mapping_size = 0;
+  mapped_empty = false;
+}
+
+bool writeFileAt(int fd, const char* data, std::size_t size, int64_t offset)
+{
+  while (size > 0) {
+    ssize_t written = pwrite(fd, data, size, static_cast<off_t>(offset));
+    if (written < 0 && errno == EINTR) continue;
+    if (written <= 0) return false;
+    data += written;
+    size -= static_cast<std::size_t>(written);
+    offset += written;
+  }
+  return true;
+}
+
+#endif
+
+} // namespace shepichess
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace shepichess {
+
+// Read-only memory mapping of a whole file. The mapping is released when the
+// object is destroyed.
+class MappedFile {
+public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+
+  // Maps path, returns false (and logs why) if it can't be opened or mapped
+  bool open(const std::string& path);
+  void close();
+
+  [[nodiscard]] const char* data() const { return mapping; }
+  [[nodiscard]] std::size_t size() const { return mapping_size; }
+  [[nodiscard]] bool isOpen() const { return mapping != nullptr || mapped_empty; }
+
+private:
+  char* mapping = nullptr;
+  std::size_t mapping_size = 0;
+  // Empty files can't be mapped, but are still opened successfully
+  bool mapped_empty = false;
+#if defined(_WIN32)
+  void* mapping_handle = nullptr;
+#endif
+};
+
+#if !defined(_WIN32)
+// pwrite of the whole buffer, retrying partial and interrupted writes
+bool writeFileAt(int fd, const char* data, std::size_t size, int64_t offset);
+#endif
+
+} // namespace shepichess
@@ -0,0 +1,226 @@
+#include "mate_search.h"
+
+#include <algorithm>
+#include <array>
+
+#include "movegen.h"
+#include "tracing.h"
+
+namespace shepichess {
+
+namespace {
+
+constexpr uint32_t kInfiniteNumber = 1'000'000'000;
+constexpr uint64_t kMateCheckInterval = 4096;
+
+// Sums of unsolved numbers stay below kInfiniteNumber, so they are never
+// mistaken for a solved node
+uint32_t addNumbers(uint32_t a, uint32_t b)
+{
+  if (a == kInfiniteNumber || b == kInfiniteNumber) return kInfiniteNumber;
+  uint64_t sum = uint64_t {a} + b;
+  return static_cast<uint32_t>(std::min<uint64_t>(sum, kInfiniteNumber - 1));
+}
+
+bool givesCheck(Position& position, Move move)
+{
+  position.makeMove(move);
+  bool check = position.inCheck();
+  position.unmakeMove();
+  return check;
+}
+
+} // namespace
+
+MateSearch::MateSearch(size_t table_size)
+  : table(std::max<size_t>(table_size * 1024 * 1024 / sizeof(Entry), 1))
+{
+}
+
+void MateSearch::clear()
+{
+  std::fill(table.begin(), table.end(), Entry {});
+  node_count = 0;
+}
+
+MateResult MateSearch::solve(Position& position, int moves, const StopCheck& stop)
+{
+  TraceZone zone("mate search", moves);
+  MateResult result;
+  int depth = 2 * std::clamp(moves, 1, kMaxMateMoves) - 1;
+  stop_check = &stop;
+  stopped = false;
+  Numbers root = search(position, kInfiniteNumber, kInfiniteNumber, depth);
+  if (stopped) return result;
+  if (root.dn == 0) {
+    result.status = MateStatus::NoMate;
+    return result;
+  }
+
+  // Follows the stored best moves, proofs only ever get shorter along the line
+  result.status = MateStatus::Mate;
+  result.plies = root.plies;
+  for (const Entry* entry = proof(position.zobrist(), depth);
+       entry && !entry->best.isNull();
+       entry = proof(position.zobrist(), depth)) {
+    result.pv.push_back(entry->best);
+    position.makeMove(entry->best);
+    depth--;
+  }
+  for (size_t i = 0; i < result.pv.size(); i++) position.unmakeMove();
+  // The root's proof was overwritten, there is no move to play
+  if (result.pv.empty()) return MateResult {};
+  return result;
+}
+
+// Attacker nodes (an odd number of plies left) take the minimum proof number
+// and the sum of disproof numbers of their children, defender nodes the
+// reverse. A child is searched with thresholds that make it return as soon as
+// another child becomes more promising.
+MateSearch::Numbers MateSearch::search(
+  Position& position, uint32_t pn_limit, uint32_t dn_limit, int depth)
+{
+  if (++node_count % kMateCheckInterval == 0 && (*stop_check)(node_count)) {
+    stopped = true;
+  }
+  bool attacker = depth % 2 == 1;
+  HashKey key = position.zobrist();
+  constexpr Numbers kProven {0, kInfiniteNumber, 0};
+  constexpr Numbers kDisproven {kInfiniteNumber, 0, 0};
+
+  MoveList moves;
+  generateLegalMoves(position, moves);
+  // Only checks can mate on the attacker's last move
+  if (attacker && depth == 1) {
+    MoveList checks;
+    for (Move move : moves) {
+      if (givesCheck(position, move)) checks.push(move);
+    }
+    moves = checks;
+  }
+  if (moves.empty()) {
+    Numbers result = !attacker && position.inCheck() ? kProven : kDisproven;
+    store(key, depth, result, Move {});
+    return result;
+  }
+  if (depth == 0) {
+    store(key, depth, kDisproven, Move {});
+    return kDisproven;
+  }
+
+  // Repetitions are treated as escapes for the defender
+  constexpr Numbers kRepetition {kInfiniteNumber, 0, 0, true};
+  std::array<Numbers, kMaxMoves> children;
+  for (int i = 0; i < moves.size(); i++) {
+    position.makeMove(moves[i]);
+    children[i] =
+      position.isDraw() ? kRepetition : probe(position.zobrist(), depth - 1);
+    position.unmakeMove();
+  }
+
+  Numbers result {};
+  int best = 0;
+  while (true) {
+    // The child to expand and the runner up's number
+    uint32_t second = kInfiniteNumber;
+    best = 0;
+    result = attacker ? Numbers {kInfiniteNumber, 0, 0}
+                      : Numbers {0, kInfiniteNumber, 0};
+    for (int i = 0; i < moves.size(); i++) {
+      const Numbers& child = children[i];
+      uint32_t number = attacker ? child.pn : child.dn;
+      uint32_t best_number = attacker ? children[best].pn : children[best].dn;
+      if (i == 0 || number < best_number) {
+        if (i > 0) second = best_number;
+        best = i;
+      } else {
+        second = std::min(second, number);
+      }
+      if (attacker) {
+        result.pn = std::min(result.pn, child.pn);
+        result.dn = addNumbers(result.dn, child.dn);
+      } else {
+        result.pn = addNumbers(result.pn, child.pn);
+        result.dn = std::min(result.dn, child.dn);
+      }
+    }
+    if (result.pn >= pn_limit || result.dn >= dn_limit || stopped) break;
+
+    Numbers& child = children[best];
+    uint32_t child_pn_limit, child_dn_limit;
+    if (attacker) {
+      child_pn_limit = std::min(pn_limit, addNumbers(second, 1));
+      child_dn_limit = addNumbers(dn_limit - result.dn, child.dn);
+    } else {
+      child_pn_limit = addNumbers(pn_limit - result.pn, child.pn);
+      child_dn_limit = std::min(dn_limit, addNumbers(second, 1));
+    }
+    position.makeMove(moves[best]);
+    child = search(position, child_pn_limit, child_dn_limit, depth - 1);
+    position.unmakeMove();
+  }
+
+  // The attacker takes the shortest proof, the defender delays mate the longest
+  Move best_move;
+  if (result.pn == 0) {
+    for (int i = 0; i < moves.size(); i++) {
+      const Numbers& child = children[i];
+      if (child.pn != 0) continue;
+      bool better = best_move.isNull() ||
+        (attacker ? child.plies < result.plies : child.plies > result.plies);
+      if (better) {
+        best_move = moves[i];
+        result.plies = child.plies;
+      }
+    }
+    result.plies++;
+  }
+  // Every attacker move must fail without a repetition, one defender escape
+  // without a repetition is enough
+  if (result.dn == 0) {
+    result.path_dependent = !attacker;
+    for (int i = 0; i < moves.size(); i++) {
+      if (children[i].dn != 0) continue;
+      if (attacker && children[i].path_dependent) result.path_dependent = true;
+      if (!attacker && !children[i].path_dependent) result.path_dependent = false;
+    }
+  }
+  if (!stopped && !result.path_dependent) store(key, depth, result, best_move);
+  return result;
+}
+
+MateSearch::Numbers MateSearch::probe(HashKey key, int depth) const
+{
+  const Entry& entry = table[key % table.size()];
+  if (entry.key == key) {
+    if (entry.pn == 0 && entry.plies <= depth) {
+      return {0, kInfiniteNumber, entry.plies};
+    }
+    if (entry.dn == 0 && entry.depth >= depth) return {kInfiniteNumber, 0, 0};
+    if (entry.depth == depth && entry.pn != 0 && entry.dn != 0) {
+      return {entry.pn, entry.dn, 0};
+    }
+  }
+  return {1, 1, 0};
+}
+
+// Solved entries are only replaced by other solved ones, so the proof lines the
+// PV is rebuilt from survive. Empty slots have a zero key.
+void MateSearch::store(HashKey key, int depth, Numbers numbers, Move best)
+{
+  Entry& entry = table[key % table.size()];
+  bool solved = numbers.pn == 0 || numbers.dn == 0;
+  bool entry_solved = entry.key != 0 && (entry.pn == 0 || entry.dn == 0);
+  if (entry_solved && !solved) return;
+  entry = Entry {
+    key, numbers.pn, numbers.dn, static_cast<int16_t>(depth), numbers.plies, best};
+}
+
+const MateSearch::Entry* MateSearch::proof(HashKey key, int depth) const
+{
+  const Entry& entry = table[key % table.size()];
+  if (entry.key != key || entry.pn != 0 || entry.plies > depth) return nullptr;
+  return &entry;
+}
+
+} // namespace shepichess
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "hash_table.h"
+#include "move.h"
+#include "position.h"
+
+namespace shepichess {
+
+constexpr size_t kDefaultMateTableSize = 16;
+// Longest mate, in moves, the solver looks for
+constexpr int kMaxMateMoves = 64;
+
+enum class MateStatus { Mate, NoMate, Stopped };
+
+struct MateResult {
+  MateStatus status = MateStatus::Stopped;
+  // Length of the mate in plies when status is Mate
+  int plies = 0;
+  // The mating line when status is Mate, the defender resists the longest. It is
+  // rebuilt from the table, so it may stop short of the mate.
+  std::vector<Move> pv;
+};
+
+// Depth-first proof-number search (df-pn) for forced mates, as used by go mate.
+//
+// The side to move is the attacker. A node's proof number estimates how many
+// leaves must still be proven for the attacker to mate, its disproof number how
+// many must be disproven for the defender to escape. The search follows the
+// most proving path while both stay below thresholds, so it goes deep quickly
+// along forcing lines and only keeps state in its table, not on the stack.
+//
+// Table entries are tagged with the plies left when they were stored: a proof
+// also holds with more plies left, a disproof with fewer. Disproofs that rely on
+// a repetition aren't stored, the same position reached by another path may not
+// repeat.
+class MateSearch {
+public:
+  // Called every few thousand nodes with the node count, returns true to stop
+  using StopCheck = std::function<bool(uint64_t nodes)>;
+
+  explicit MateSearch(size_t table_size = kDefaultMateTableSize);
+
+  // Empties the table and resets the node count
+  void clear();
+  // Proves or disproves that the side to move mates in at most moves moves.
+  // Results of earlier calls are kept, so solving for 1, 2, 3... moves finds the
+  // shortest mate at little extra cost.
+  MateResult solve(Position& position, int moves, const StopCheck& stop);
+  [[nodiscard]] uint64_t nodes() const { return node_count; }
+  [[nodiscard]] size_t memoryUsage() const { return table.size() * sizeof(Entry); }
+
+private:
+  struct Numbers {
+    uint32_t pn;
+    uint32_t dn;
+    // Length of the proof when pn is 0
+    uint16_t plies;
+    // A disproof that relies on a repetition, it only holds for the current path
+    bool path_dependent = false;
+  };
+  struct Entry {
+    HashKey key;
+    uint32_t pn;
+    uint32_t dn;
+    int16_t depth;
+    uint16_t plies;
+    // The proving move for the attacker, the longest resistance for the defender
+    Move best;
+  };
+
+  std::vector<Entry> table;
+  uint64_t node_count = 0;
+  bool stopped = false;
+  const StopCheck* stop_check = nullptr;
+
+  Numbers search(
+    Position& position, uint32_t pn_limit, uint32_t dn_limit, int depth);
+  [[nodiscard]] Numbers probe(HashKey key, int depth) const;
+  void store(HashKey key, int depth, Numbers numbers, Move best);
+  [[nodiscard]] const Entry* proof(HashKey key, int depth) const;
+};
+
+} // namespace shepichess
@@ -0,0 +1,30 @@
+#include "move.h"
+
+namespace shepichess {
+
+std::string squareName(int square)
+{
+  char file = static_cast<char>('a' + squareFile(square));
+  char rank = static_cast<char>('1' + squareRank(square));
+  return {file, rank};
+}
+
+int parseSquare(std::string_view name)
+{
+  if (name.size() != 2) return kNoSquare;
+  int file = name[0] - 'a', rank = name[1] - '1';
+  if (file < 0 || file > 7 || rank < 0 || rank > 7) return kNoSquare;
+  return makeSquare(file, rank);
+}
+
+std::string Move::uci() const
+{
+  if (isNull()) return "0000";
+  std::string result = squareName(from()) + squareName(to());
+  if (isPromotion()) {
+    result += static_cast<char>(pieceToChar(makePiece(Color::Black, promotionType())));
+  }
+  return result;
+}
+
+} // namespace shepichess
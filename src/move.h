@@ -1,8 +1,96 @@
 #pragma once
 
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "piece.h"
+
 namespace shepichess {
 
+// Squares are numbered from h1 = 0 to a8 = 63, matching bitboards::fromSquare
+constexpr int kNoSquare = 64;
+
+constexpr int makeSquare(int file, int rank)
+{
+  return rank * 8 + (7 - file);
+}
+
+constexpr int squareFile(int square)
+{
+  return 7 - (square & 7);
+}
+
+constexpr int squareRank(int square)
+{
+  return square >> 3;
+}
+
+std::string squareName(int square);
+// Returns kNoSquare if the name is not a valid square
+int parseSquare(std::string_view name);
+
+enum class MoveFlag : uint16_t {
+  Quiet = 0,
+  DoublePawnPush = 1,
+  KingCastle = 2,
+  QueenCastle = 3,
+  Capture = 4,
+  EnPassant = 5,
+  KnightPromotion = 8,
+  BishopPromotion = 9,
+  RookPromotion = 10,
+  QueenPromotion = 11,
+  KnightPromotionCapture = 12,
+  BishopPromotionCapture = 13,
+  RookPromotionCapture = 14,
+  QueenPromotionCapture = 15
+};
+
+// Moves are packed into 16 bits (6 from, 6 to, 4 flag) so they fit a HashEntry.
+// The default constructed move is the null move.
 class Move {
+public:
+  constexpr Move() = default;
+  constexpr Move(int from, int to, MoveFlag flag = MoveFlag::Quiet)
+    : move_data(static_cast<uint16_t>(from | to << 6 | static_cast<int>(flag) << 12))
+  {
+  }
+  static constexpr Move fromData(uint16_t data)
+  {
+    Move move;
+    move.move_data = data;
+    return move;
+  }
+
+  [[nodiscard]] constexpr int from() const { return move_data & 0x3f; }
+  [[nodiscard]] constexpr int to() const { return (move_data >> 6) & 0x3f; }
+  [[nodiscard]] constexpr MoveFlag flag() const
+  {
+    return static_cast<MoveFlag>(move_data >> 12);
+  }
+  [[nodiscard]] constexpr uint16_t data() const { return move_data; }
+  [[nodiscard]] constexpr bool isNull() const { return move_data == 0; }
+  [[nodiscard]] constexpr bool isCapture() const { return (move_data >> 12) & 4; }
+  [[nodiscard]] constexpr bool isPromotion() const { return (move_data >> 12) & 8; }
+  [[nodiscard]] constexpr bool isCastle() const
+  {
+    return flag() == MoveFlag::KingCastle || flag() == MoveFlag::QueenCastle;
+  }
+  [[nodiscard]] constexpr PieceType promotionType() const
+  {
+    constexpr PieceType kPromotions[] = {
+      PieceType::Knight, PieceType::Bishop, PieceType::Rook, PieceType::Queen};
+    return isPromotion() ? kPromotions[(move_data >> 12) & 3] : PieceType::None;
+  }
+  // Long algebraic notation as used by UCI, e.g. "e2e4" or "e7e8q"
+  [[nodiscard]] std::string uci() const;
+
+  constexpr bool operator==(Move other) const { return move_data == other.move_data; }
+  constexpr bool operator!=(Move other) const { return move_data != other.move_data; }
+
+private:
+  uint16_t move_data = 0;
 };
 
 } // namespace shepichess
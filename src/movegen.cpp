@@ -0,0 +1,313 @@
+#include "movegen.h"
+
+#include <algorithm>
+
+namespace shepichess {
+
+namespace {
+
+constexpr Bitboard kRank3 = kRank1 << 16;
+constexpr Bitboard kRank6 = kRank1 << 40;
+
+void addPromotions(MoveList& moves, int from, int to, bool capture)
+{
+  int base = capture ? static_cast<int>(MoveFlag::KnightPromotionCapture)
+                     : static_cast<int>(MoveFlag::KnightPromotion);
+  // Queen promotions first, they are almost always best
+  for (int i = 3; i >= 0; i--) {
+    moves.push(Move {from, to, static_cast<MoveFlag>(base + i)});
+  }
+}
+
+// Adds a move to each target square, with from = target - offset
+void addShiftedMoves(MoveList& moves, Bitboard targets, int offset, MoveFlag flag)
+{
+  for (; targets; targets = bitboards::poplsb(targets)) {
+    int to = bitboards::bitscan(targets);
+    moves.push(Move {to - offset, to, flag});
+  }
+}
+
+template<MoveGenType type, Color us>
+void generatePawnMoves(const Position& position, MoveList& moves)
+{
+  using bitboards::shift;
+  constexpr bool kWhite = us == Color::White;
+  constexpr Direction kUp = kWhite ? Direction::North : Direction::South;
+  constexpr Direction kUpRight = kWhite ? Direction::NorthEast : Direction::SouthWest;
+  constexpr Direction kUpLeft = kWhite ? Direction::NorthWest : Direction::SouthEast;
+  constexpr int kUpOffset = kWhite ? 8 : -8;
+  constexpr int kUpRightOffset = kWhite ? 7 : -7;
+  constexpr int kUpLeftOffset = kWhite ? 9 : -9;
+  constexpr Bitboard kPromotionRank = kWhite ? kRank8 : kRank1;
+  constexpr Bitboard kDoublePushRank = kWhite ? kRank3 : kRank6;
+
+  Bitboard pawns = position.piecesByType(us, PieceType::Pawn);
+  Bitboard empty = ~position.occupied();
+  Bitboard enemies = position.piecesByColor(~us);
+
+  Bitboard push = shift<kUp>(pawns) & empty;
+  Bitboard right = shift<kUpRight>(pawns) & enemies;
+  Bitboard left = shift<kUpLeft>(pawns) & enemies;
+
+  // Promotions
+  for (Bitboard b = push & kPromotionRank; b; b = bitboards::poplsb(b)) {
+    int to = bitboards::bitscan(b);
+    addPromotions(moves, to - kUpOffset, to, false);
+  }
+  for (Bitboard b = right & kPromotionRank; b; b = bitboards::poplsb(b)) {
+    int to = bitboards::bitscan(b);
+    addPromotions(moves, to - kUpRightOffset, to, true);
+  }
+  for (Bitboard b = left & kPromotionRank; b; b = bitboards::poplsb(b)) {
+    int to = bitboards::bitscan(b);
+    addPromotions(moves, to - kUpLeftOffset, to, true);
+  }
+
+  // Captures
+  addShiftedMoves(moves, right & ~kPromotionRank, kUpRightOffset, MoveFlag::Capture);
+  addShiftedMoves(moves, left & ~kPromotionRank, kUpLeftOffset, MoveFlag::Capture);
+  int ep_square = position.state().enpassant_square;
+  if (ep_square != kNoSquare) {
+    Bitboard ep = bitboards::fromSquare(ep_square);
+    Bitboard right_ep = shift<kUpRight>(pawns) & ep;
+    Bitboard left_ep = shift<kUpLeft>(pawns) & ep;
+    addShiftedMoves(moves, right_ep, kUpRightOffset, MoveFlag::EnPassant);
+    addShiftedMoves(moves, left_ep, kUpLeftOffset, MoveFlag::EnPassant);
+  }
+
+  // Quiet pushes
+  if constexpr (type == MoveGenType::All) {
+    Bitboard double_push = shift<kUp>(push & kDoublePushRank) & empty;
+    addShiftedMoves(moves, push & ~kPromotionRank, kUpOffset, MoveFlag::Quiet);
+    addShiftedMoves(moves, double_push, 2 * kUpOffset, MoveFlag::DoublePawnPush);
+  }
+}
+
+template<MoveGenType type, typename AttackFn>
+void generatePieceMoves(
+  const Position& position, MoveList& moves, Bitboard pieces, AttackFn attacks)
+{
+  Color us = position.sideToMove();
+  Bitboard enemies = position.piecesByColor(~us);
+  Bitboard empty = ~position.occupied();
+  for (; pieces; pieces = bitboards::poplsb(pieces)) {
+    int from = bitboards::bitscan(pieces);
+    Bitboard targets = attacks(from);
+    for (Bitboard b = targets & enemies; b; b = bitboards::poplsb(b)) {
+      moves.push(Move {from, bitboards::bitscan(b), MoveFlag::Capture});
+    }
+    if constexpr (type == MoveGenType::All) {
+      for (Bitboard b = targets & empty; b; b = bitboards::poplsb(b)) {
+        moves.push(Move {from, bitboards::bitscan(b), MoveFlag::Quiet});
+      }
+    }
+  }
+}
+
+void generateCastling(const Position& position, MoveList& moves)
+{
+  Color us = position.sideToMove();
+  const PositionState& state = position.state();
+  bool kingside = us == Color::White ? state.white_kingside_castle
+                                     : state.black_kingside_castle;
+  bool queenside = us == Color::White ? state.white_queenside_castle
+                                      : state.black_queenside_castle;
+  if (!(kingside || queenside) || position.inCheck()) return;
+  // King starts on e1/e8, castling squares are relative to it
+  int king = us == Color::White ? 3 : 59;
+  Bitboard occupied = position.occupied();
+  auto empty = [&](int square) { return !bitboards::getbit(occupied, square); };
+  auto safe = [&](int square) { return !position.isSquareAttacked(square, ~us); };
+  bool kingside_clear = empty(king - 1) && empty(king - 2);
+  bool queenside_clear = empty(king + 1) && empty(king + 2) && empty(king + 3);
+  if (kingside && kingside_clear && safe(king - 1) && safe(king - 2)) {
+    moves.push(Move {king, king - 2, MoveFlag::KingCastle});
+  }
+  if (queenside && queenside_clear && safe(king + 1) && safe(king + 2)) {
+    moves.push(Move {king, king + 2, MoveFlag::QueenCastle});
+  }
+}
+
+} // namespace
+
+bool MoveList::contains(Move move) const
+{
+  return std::find(begin(), end(), move) != end();
+}
+
+template<MoveGenType type>
+void generateMoves(const Position& position, MoveList& moves)
+{
+  using namespace attack_maps;
+  Color us = position.sideToMove();
+  Bitboard occupied = position.occupied();
+  if (us == Color::White) {
+    generatePawnMoves<type, Color::White>(position, moves);
+  } else {
+    generatePawnMoves<type, Color::Black>(position, moves);
+  }
+  Bitboard knights = position.piecesByType(us, PieceType::Knight);
+  Bitboard bishops = position.piecesByType(us, PieceType::Bishop);
+  Bitboard rooks = position.piecesByType(us, PieceType::Rook);
+  Bitboard queens = position.piecesByType(us, PieceType::Queen);
+  Bitboard king = position.piecesByType(us, PieceType::King);
+  generatePieceMoves<type>(position, moves, knights, knightAttacks);
+  generatePieceMoves<type>(position, moves, bishops, [&](int square) {
+    return bishopAttacks(square, occupied);
+  });
+  generatePieceMoves<type>(position, moves, rooks, [&](int square) {
+    return rookAttacks(square, occupied);
+  });
+  generatePieceMoves<type>(position, moves, queens, [&](int square) {
+    return queenAttacks(square, occupied);
+  });
+  generatePieceMoves<type>(position, moves, king, kingAttacks);
+  if constexpr (type == MoveGenType::All) generateCastling(position, moves);
+}
+
+template void generateMoves<MoveGenType::All>(const Position&, MoveList&);
+template void generateMoves<MoveGenType::Captures>(const Position&, MoveList&);
+
+void generateLegalMoves(Position& position, MoveList& moves)
+{
+  MoveList pseudo_legal;
+  generateMoves<MoveGenType::All>(position, pseudo_legal);
+  moves.clear();
+  for (Move move : pseudo_legal) {
+    if (position.isLegal(move)) moves.push(move);
+  }
+}
+
+uint64_t perft(Position& position, int depth)
+{
+  MoveList moves;
+  generateLegalMoves(position, moves);
+  if (depth <= 1) return depth == 1 ? moves.size() : 1;
+  uint64_t nodes = 0;
+  for (Move move : moves) {
+    position.makeMove(move);
+    nodes += perft(position, depth - 1);
+    position.unmakeMove();
+  }
+  return nodes;
+}
+
+Move parseUCIMove(Position& position, std::string_view uci)
+{
+  MoveList moves;
+  generateLegalMoves(position, moves);
+  auto match = [&](Move move) { return move.uci() == uci; };
+  const Move* move = std::find_if(moves.begin(), moves.end(), match);
+  return move == moves.end() ? Move {} : *move;
+}
+
+std::string moveToSAN(Position& position, Move move)
+{
+  constexpr char kPieceLetters[] = "PRNBQK";
+  std::string san;
+  if (move.isCastle()) {
+    san = move.flag() == MoveFlag::KingCastle ? "O-O" : "O-O-O";
+  } else {
+    PieceType type = pieceType(position.pieceOn(move.from()));
+    std::string from = squareName(move.from());
+    if (type == PieceType::Pawn) {
+      if (move.isCapture()) san += from[0];
+    } else {
+      san += kPieceLetters[index(type)];
+      // Disambiguate by file, then rank, then both
+      MoveList moves;
+      generateLegalMoves(position, moves);
+      bool ambiguous = false, same_file = false, same_rank = false;
+      for (Move other : moves) {
+        if (other.to() != move.to() || other.from() == move.from() ||
+            position.pieceOn(other.from()) != position.pieceOn(move.from())) {
+          continue;
+        }
+        ambiguous = true;
+        same_file |= squareFile(other.from()) == squareFile(move.from());
+        same_rank |= squareRank(other.from()) == squareRank(move.from());
+      }
+      if (ambiguous && (!same_file || same_rank)) san += from[0];
+      if (ambiguous && same_file) san += from[1];
+    }
+    if (move.isCapture()) san += 'x';
+    san += squareName(move.to());
+    if (move.isPromotion()) {
+      san += '=';
+      san += kPieceLetters[index(move.promotionType())];
+    }
+  }
+
+  position.makeMove(move);
+  if (position.inCheck()) {
+    MoveList replies;
+    generateLegalMoves(position, replies);
+    san += replies.empty() ? '#' : '+';
+  }
+  position.unmakeMove();
+  return san;
+}
+
+Move parseSAN(Position& position, std::string_view san)
+{
+  constexpr std::string_view kPieceLetters = "PRNBQK";
+  while (!san.empty() && std::string_view("+#!?").find(san.back()) != san.npos) {
+    san.remove_suffix(1);
+  }
+  // Only moves matching the text are checked for legality
+  MoveList moves;
+  generateMoves<MoveGenType::All>(position, moves);
+  if (san == "O-O" || san == "O-O-O" || san == "0-0" || san == "0-0-0") {
+    MoveFlag flag = san.size() == 3 ? MoveFlag::KingCastle : MoveFlag::QueenCastle;
+    auto castle = [&position, flag](Move move) {
+      return move.isCastle() && move.flag() == flag && position.isLegal(move);
+    };
+    const Move* move = std::find_if(moves.begin(), moves.end(), castle);
+    return move == moves.end() ? Move {} : *move;
+  }
+
+  PieceType type = PieceType::Pawn;
+  if (!san.empty() && san[0] != 'P' && kPieceLetters.find(san[0]) != san.npos) {
+    type = static_cast<PieceType>(kPieceLetters.find(san[0]));
+    san.remove_prefix(1);
+  }
+  PieceType promotion = PieceType::None;
+  if (type == PieceType::Pawn && san.size() > 2) {
+    size_t letter = kPieceLetters.find(san.back());
+    if (letter != san.npos && letter != 0 && letter != index(PieceType::King)) {
+      promotion = static_cast<PieceType>(letter);
+      san.remove_suffix(san[san.size() - 2] == '=' ? 2 : 1);
+    }
+  }
+  if (san.size() < 2) return Move {};
+  int to = parseSquare(san.substr(san.size() - 2));
+  san.remove_suffix(2);
+  if (!san.empty() && (san.back() == 'x' || san.back() == ':')) san.remove_suffix(1);
+  int from_file = -1, from_rank = -1;
+  for (char c : san) {
+    if (c >= 'a' && c <= 'h') {
+      from_file = c - 'a';
+    } else if (c >= '1' && c <= '8') {
+      from_rank = c - '1';
+    } else {
+      return Move {};
+    }
+  }
+
+  Move found;
+  for (Move move : moves) {
+    if (move.to() != to || pieceType(position.pieceOn(move.from())) != type ||
+        (from_file >= 0 && squareFile(move.from()) != from_file) ||
+        (from_rank >= 0 && squareRank(move.from()) != from_rank) ||
+        (move.isPromotion() ? move.promotionType() : PieceType::None) != promotion ||
+        move.isCastle() || !position.isLegal(move)) {
+      continue;
+    }
+    if (!found.isNull()) return Move {};
+    found = move;
+  }
+  return found;
+}
+
+} // namespace shepichess
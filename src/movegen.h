@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "move.h"
+#include "position.h"
+
+namespace shepichess {
+
+constexpr int kMaxMoves = 256;
+
+// Fixed capacity move list, so generating moves never allocates
+class MoveList {
+public:
+  void push(Move move) { moves[count++] = move; }
+  void clear() { count = 0; }
+  [[nodiscard]] int size() const { return count; }
+  [[nodiscard]] bool empty() const { return count == 0; }
+  [[nodiscard]] bool contains(Move move) const;
+  Move& operator[](int i) { return moves[i]; }
+  Move operator[](int i) const { return moves[i]; }
+  Move* begin() { return moves.data(); }
+  Move* end() { return moves.data() + count; }
+  [[nodiscard]] const Move* begin() const { return moves.data(); }
+  [[nodiscard]] const Move* end() const { return moves.data() + count; }
+
+private:
+  std::array<Move, kMaxMoves> moves;
+  int count = 0;
+};
+
+// Captures also includes promotions, for use in quiescence search
+enum class MoveGenType { All, Captures };
+
+// Generates pseudo-legal moves, which may leave the king in check
+template<MoveGenType type>
+void generateMoves(const Position& position, MoveList& moves);
+
+void generateLegalMoves(Position& position, MoveList& moves);
+// Counts leaf nodes of the legal move tree, used to verify move generation
+uint64_t perft(Position& position, int depth);
+// Finds the legal move matching a UCI move string, or the null move if none does
+Move parseUCIMove(Position& position, std::string_view uci);
+// Standard algebraic notation for a legal move, e.g. "Nbd2", "exd5" or "O-O+"
+std::string moveToSAN(Position& position, Move move);
+// Finds the legal move a SAN string describes, or the null move if there is none
+// or more than one. Accepts what PGN files contain in practice: check and
+// annotation suffixes, promotions with or without '=' and castling with zeros.
+Move parseSAN(Position& position, std::string_view san);
+
+} // namespace shepichess
@@ -0,0 +1,351 @@
+#include "pgn.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <execution>
+#include <fstream>
+#include <limits>
+#include <thread>
+
+#include "logging.h"
+#include "movegen.h"
+#include "tracing.h"
+
+namespace shepichess {
+
+namespace {
+
+// Index file layout: a PgnIndexHeader, the game offsets, then the records
+constexpr std::array<char, 8> kPgnIndexMagic {'S', 'H', 'E', 'P', 'I', 'P', 'G', 'N'};
+// Bump whenever the layout of PositionRecord changes
+constexpr uint32_t kPgnIndexVersion = 1;
+constexpr uint32_t kPgnIndexByteOrder = 0x0102'0304;
+// Games are handed to threads in batches, so threads don't contend on the counter
+constexpr size_t kGameBatch = 64;
+
+struct PgnIndexHeader {
+  std::array<char, 8> magic;
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t key_seed;
+  uint64_t game_count;
+  uint64_t record_count;
+  std::array<uint64_t, 3> reserved;
+};
+static_assert(sizeof(PgnIndexHeader) == 64);
+
+bool isWhitespace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Runs work(thread) on threads threads and waits for them
+template<typename Work>
+void runOnThreads(int threads, Work&& work)
+{
+  std::vector<std::thread> workers;
+  for (int thread = 1; thread < threads; thread++) {
+    workers.emplace_back([&work, thread]() { work(thread); });
+  }
+  work(0);
+  for (auto&& worker : workers) worker.join();
+}
+
+// Whether the line starting at pos doesn't follow another tag line
+bool startsGame(std::string_view text, size_t pos)
+{
+  while (pos > 0) {
+    size_t end = pos - 1;
+    size_t start = end == 0 ? text.npos : text.rfind('\n', end - 1);
+    start = start == text.npos ? 0 : start + 1;
+    std::string_view line = text.substr(start, end - start);
+    auto first = std::find_if_not(line.begin(), line.end(), isWhitespace);
+    if (first != line.end()) return *first != '[';
+    pos = start;
+  }
+  return true;
+}
+
+// Skips a '(' variation, including nested ones and comments inside it
+size_t skipVariation(std::string_view text, size_t pos)
+{
+  int depth = 0;
+  for (; pos < text.size(); pos++) {
+    if (text[pos] == '{') {
+      pos = text.find('}', pos);
+      if (pos == text.npos) return text.size();
+    } else if (text[pos] == '(') {
+      depth++;
+    } else if (text[pos] == ')' && --depth == 0) {
+      return pos + 1;
+    }
+  }
+  return pos;
+}
+
+size_t lineEnd(std::string_view text, size_t pos)
+{
+  size_t end = text.find('\n', pos);
+  return end == text.npos ? text.size() : end;
+}
+
+} // namespace
+
+std::vector<size_t> splitPgnGames(std::string_view text, int threads)
+{
+  TraceZone zone("pgn split");
+  threads = std::max(threads, 1);
+  std::vector<std::vector<size_t>> starts(static_cast<size_t>(threads));
+  size_t chunk = text.size() / static_cast<size_t>(threads) + 1;
+  runOnThreads(threads, [&](int thread) {
+    size_t begin = static_cast<size_t>(thread) * chunk;
+    size_t end = std::min(begin + chunk, text.size());
+    // Lines starting in [begin, end) belong to this thread
+    size_t pos = begin == 0 ? 0 : lineEnd(text, begin - 1) + 1;
+    for (; pos < end; pos = lineEnd(text, pos) + 1) {
+      if (text[pos] == '[' && startsGame(text, pos)) starts[thread].push_back(pos);
+    }
+  });
+
+  std::vector<size_t> games;
+  for (auto&& thread_starts : starts) {
+    games.insert(games.end(), thread_starts.begin(), thread_starts.end());
+  }
+  if (games.empty() && !std::all_of(text.begin(), text.end(), isWhitespace)) {
+    games.push_back(0);
+  }
+  return games;
+}
+
+bool replayPgnGame(
+  std::string_view game,
+  Position& position,
+  const std::function<void(const Position&, int ply)>& visit)
+{
+  std::string_view fen = kStartFen;
+  size_t pos = 0;
+  while (true) {
+    while (pos < game.size() && isWhitespace(game[pos])) pos++;
+    if (pos == game.size() || game[pos] != '[') break;
+    size_t end = lineEnd(game, pos);
+    std::string_view tag = game.substr(pos + 1, end - pos - 1);
+    size_t open = tag.find('"'), close = tag.rfind('"');
+    if (tag.substr(0, 4) == "FEN " && open != tag.npos && close > open) {
+      fen = tag.substr(open + 1, close - open - 1);
+    }
+    pos = end;
+  }
+  if (!position.setFen(fen)) return false;
+
+  int ply = 0;
+  visit(position, ply);
+  while (pos < game.size()) {
+    char c = game[pos];
+    if (isWhitespace(c)) {
+      pos++;
+    } else if (c == '{') {
+      pos = game.find('}', pos);
+      pos = pos == game.npos ? game.size() : pos + 1;
+    } else if (c == ';' || (c == '%' && (pos == 0 || game[pos - 1] == '\n'))) {
+      pos = lineEnd(game, pos);
+    } else if (c == '(') {
+      pos = skipVariation(game, pos);
+    } else if (c == '[') {
+      break;
+    } else {
+      size_t end = pos;
+      while (end < game.size() && !isWhitespace(game[end]) &&
+             std::strchr("{}();[", game[end]) == nullptr) {
+        end++;
+      }
+      std::string_view token = game.substr(pos, end - pos);
+      pos = end;
+      if (token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*") break;
+      if (token[0] == '$') continue;
+      // Move numbers, "12." or "12...", may be attached to the move
+      size_t number = 0;
+      while (number < token.size() && token[number] >= '0' && token[number] <= '9') {
+        number++;
+      }
+      while (number < token.size() && token[number] == '.') number++;
+      token.remove_prefix(number);
+      if (token.empty()) continue;
+
+      Move move = parseSAN(position, token);
+      if (move.isNull()) {
+        SPDLOG_DEBUG("PGN: illegal move \"{}\" in {}", token, position.fen());
+        return false;
+      }
+      position.makeMove(move);
+      visit(position, ++ply);
+    }
+  }
+  return true;
+}
+
+std::vector<PositionRecord> indexPgn(
+  std::string_view text,
+  int threads,
+  std::vector<uint64_t>& game_offsets,
+  PgnIndexStats& stats)
+{
+  threads = std::max(threads, 1);
+  std::vector<size_t> starts = splitPgnGames(text, threads);
+  stats = PgnIndexStats {};
+  game_offsets.assign(starts.begin(), starts.end());
+  if (starts.size() > std::numeric_limits<uint32_t>::max()) {
+    SPDLOG_ERROR("PGN has too many games to index: {}", starts.size());
+    game_offsets.clear();
+    return {};
+  }
+
+  std::vector<std::vector<PositionRecord>> thread_records(static_cast<size_t>(threads));
+  std::atomic<size_t> next_game {0};
+  std::atomic<uint64_t> bad_games {0};
+  runOnThreads(threads, [&](int thread) {
+    TraceZone zone("pgn replay");
+    std::vector<PositionRecord>& records = thread_records[thread];
+    Position position;
+    uint32_t game = 0;
+    std::function<void(const Position&, int)> record;
+    record = [&records, &game](const Position& current, int ply) {
+      auto clamped = static_cast<uint16_t>(std::min(ply, 0xffff));
+      records.push_back(PositionRecord {current.zobrist(), game, clamped, 0});
+    };
+    for (size_t first = next_game.fetch_add(kGameBatch); first < starts.size();
+         first = next_game.fetch_add(kGameBatch)) {
+      for (size_t i = first; i < std::min(first + kGameBatch, starts.size()); i++) {
+        size_t end = i + 1 < starts.size() ? starts[i + 1] : text.size();
+        game = static_cast<uint32_t>(i);
+        if (!replayPgnGame(text.substr(starts[i], end - starts[i]), position, record)) {
+          bad_games++;
+        }
+      }
+    }
+  });
+
+  TraceZone zone("pgn sort");
+  size_t total = 0;
+  for (auto&& records : thread_records) total += records.size();
+  std::vector<PositionRecord> records;
+  records.reserve(total);
+  for (auto&& thread : thread_records) {
+    records.insert(records.end(), thread.begin(), thread.end());
+    std::vector<PositionRecord>().swap(thread);
+  }
+  auto byKey = [](const PositionRecord& a, const PositionRecord& b) {
+    if (a.key != b.key) return a.key < b.key;
+    return a.game != b.game ? a.game < b.game : a.ply < b.ply;
+  };
+  std::sort(std::execution::par, records.begin(), records.end(), byKey);
+
+  stats.games = starts.size();
+  stats.positions = records.size();
+  stats.bad_games = bad_games;
+  return records;
+}
+
+bool buildPgnIndex(
+  const std::string& pgn_path,
+  const std::string& index_path,
+  int threads,
+  PgnIndexStats& stats)
+{
+  MappedFile pgn;
+  if (!pgn.open(pgn_path)) return false;
+  std::vector<uint64_t> game_offsets;
+  std::vector<PositionRecord> records =
+    indexPgn({pgn.data(), pgn.size()}, threads, game_offsets, stats);
+
+  PgnIndexHeader header {};
+  header.magic = kPgnIndexMagic;
+  header.version = kPgnIndexVersion;
+  header.byte_order = kPgnIndexByteOrder;
+  header.key_seed = kZobristSeed;
+  header.game_count = game_offsets.size();
+  header.record_count = records.size();
+  std::ofstream file(index_path, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(
+    reinterpret_cast<const char*>(game_offsets.data()),
+    static_cast<std::streamsize>(game_offsets.size() * sizeof(uint64_t)));
+  file.write(
+    reinterpret_cast<const char*>(records.data()),
+    static_cast<std::streamsize>(records.size() * sizeof(PositionRecord)));
+  if (!file) {
+    SPDLOG_ERROR("Failed to write PGN index \"{}\"", index_path);
+    return false;
+  }
+  SPDLOG_INFO(
+    "Indexed {} positions of {} games from \"{}\"",
+    stats.positions,
+    stats.games,
+    pgn_path);
+  return true;
+}
+
+bool PgnIndex::open(const std::string& path)
+{
+  close();
+  if (!file.open(path)) return false;
+  PgnIndexHeader header {};
+  if (file.size() < sizeof(header)) {
+    SPDLOG_ERROR("PGN index \"{}\" is too small", path);
+    close();
+    return false;
+  }
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (header.magic != kPgnIndexMagic || header.byte_order != kPgnIndexByteOrder ||
+      header.version != kPgnIndexVersion) {
+    SPDLOG_ERROR("\"{}\" is not a PGN index", path);
+    close();
+    return false;
+  }
+  if (header.key_seed != kZobristSeed) {
+    SPDLOG_ERROR("PGN index \"{}\" was made with different zobrist keys", path);
+    close();
+    return false;
+  }
+  uint64_t size = sizeof(header) + header.game_count * sizeof(uint64_t) +
+                  header.record_count * sizeof(PositionRecord);
+  if (file.size() != size) {
+    SPDLOG_ERROR("PGN index \"{}\" is truncated", path);
+    close();
+    return false;
+  }
+  offsets = reinterpret_cast<const uint64_t*>(file.data() + sizeof(header));
+  records = reinterpret_cast<const PositionRecord*>(offsets + header.game_count);
+  game_count = header.game_count;
+  record_count = header.record_count;
+  return true;
+}
+
+void PgnIndex::close()
+{
+  file.close();
+  offsets = nullptr;
+  records = nullptr;
+  game_count = record_count = 0;
+}
+
+std::vector<PositionRecord> PgnIndex::find(HashKey key) const
+{
+  auto keyLess = [](const PositionRecord& record, HashKey value) {
+    return record.key < value;
+  };
+  auto lessKey = [](HashKey value, const PositionRecord& record) {
+    return value < record.key;
+  };
+  const PositionRecord* end = records + record_count;
+  const PositionRecord* first = std::lower_bound(records, end, key, keyLess);
+  return {first, std::upper_bound(first, end, key, lessKey)};
+}
+
+uint64_t PgnIndex::gameOffset(uint32_t game) const
+{
+  return game < game_count ? offsets[game] : 0;
+}
+
+} // namespace shepichess
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "hash_table.h"
+#include "mapped_file.h"
+#include "position.h"
+
+namespace shepichess {
+
+// Offsets of the games in a PGN text. A game starts at a tag line ('[' at the
+// start of a line) that doesn't follow another tag line. Text without tags is a
+// single game. The text is scanned in parallel on threads.
+std::vector<size_t> splitPgnGames(std::string_view text, int threads = 1);
+
+// Replays the moves of one game from its FEN tag (or the start position),
+// calling visit with the position before the first move and after every move.
+// Comments, variations, NAGs and move numbers are skipped. Returns false at the
+// first illegal or unreadable move, the positions before it are still visited.
+bool replayPgnGame(
+  std::string_view game,
+  Position& position,
+  const std::function<void(const Position&, int ply)>& visit);
+
+// Occurrence of a position in a game, the index is sorted by key, game and ply
+struct PositionRecord {
+  HashKey key;
+  uint32_t game;
+  uint16_t ply;
+  uint16_t reserved;
+};
+static_assert(sizeof(PositionRecord) == 16);
+
+struct PgnIndexStats {
+  uint64_t games = 0;
+  uint64_t positions = 0;
+  // Games that stopped at an illegal move or bad FEN, their earlier positions are
+  // still indexed
+  uint64_t bad_games = 0;
+};
+
+// Replays every game of text on threads and returns their positions sorted by
+// key. game_offsets receives where each game (numbered from 0) starts.
+std::vector<PositionRecord> indexPgn(
+  std::string_view text,
+  int threads,
+  std::vector<uint64_t>& game_offsets,
+  PgnIndexStats& stats);
+
+// Memory maps pgn_path, indexes it and writes the index to index_path. The
+// records are sorted in memory, so it needs 16 bytes of memory per position.
+bool buildPgnIndex(
+  const std::string& pgn_path,
+  const std::string& index_path,
+  int threads,
+  PgnIndexStats& stats);
+
+// Memory mapped index written by buildPgnIndex, found with a binary search
+class PgnIndex {
+public:
+  // Returns false (after logging) if path isn't a valid index
+  bool open(const std::string& path);
+  void close();
+
+  // Every occurrence of the position in the indexed games
+  [[nodiscard]] std::vector<PositionRecord> find(HashKey key) const;
+  // Byte offset of a game in the indexed PGN file
+  [[nodiscard]] uint64_t gameOffset(uint32_t game) const;
+  [[nodiscard]] uint64_t games() const { return game_count; }
+  [[nodiscard]] uint64_t positions() const { return record_count; }
+
+private:
+  MappedFile file;
+  const uint64_t* offsets = nullptr;
+  const PositionRecord* records = nullptr;
+  uint64_t game_count = 0;
+  uint64_t record_count = 0;
+};
+
+} // namespace shepichess
@@ -0,0 +1,91 @@
+#pragma once
+
+namespace shepichess {
+
+enum class Color { White, Black };
+
+enum class PieceType { Pawn = 0, Rook, Knight, Bishop, Queen, King, None = 7 };
+
+// Pieces are laid out so that color = piece >> 3 and type = piece & 7
+enum class Piece {
+  WhitePawn = 0,
+  WhiteRook,
+  WhiteKnight,
+  WhiteBishop,
+  WhiteQueen,
+  WhiteKing,
+  None = 7,
+  BlackPawn = 8,
+  BlackRook,
+  BlackKnight,
+  BlackBishop,
+  BlackQueen,
+  BlackKing
+};
+
+constexpr int kColorCount = 2;
+constexpr int kPieceTypeCount = 6;
+constexpr int kPieceCount = 16;
+
+constexpr Color operator~(Color color)
+{
+  return color == Color::White ? Color::Black : Color::White;
+}
+
+constexpr int index(Color color)
+{
+  return static_cast<int>(color);
+}
+
+constexpr int index(PieceType type)
+{
+  return static_cast<int>(type);
+}
+
+constexpr int index(Piece piece)
+{
+  return static_cast<int>(piece);
+}
+
+constexpr Piece makePiece(Color color, PieceType type)
+{
+  return static_cast<Piece>(index(color) << 3 | index(type));
+}
+
+constexpr Color pieceColor(Piece piece)
+{
+  return static_cast<Color>(index(piece) >> 3);
+}
+
+constexpr PieceType pieceType(Piece piece)
+{
+  return static_cast<PieceType>(index(piece) & 7);
+}
+
+// FEN letters, uppercase for white. Returns Piece::None for unknown characters.
+constexpr Piece pieceFromChar(char c)
+{
+  switch (c) {
+  case 'P': return Piece::WhitePawn;
+  case 'R': return Piece::WhiteRook;
+  case 'N': return Piece::WhiteKnight;
+  case 'B': return Piece::WhiteBishop;
+  case 'Q': return Piece::WhiteQueen;
+  case 'K': return Piece::WhiteKing;
+  case 'p': return Piece::BlackPawn;
+  case 'r': return Piece::BlackRook;
+  case 'n': return Piece::BlackKnight;
+  case 'b': return Piece::BlackBishop;
+  case 'q': return Piece::BlackQueen;
+  case 'k': return Piece::BlackKing;
+  default: return Piece::None;
+  }
+}
+
+constexpr char pieceToChar(Piece piece)
+{
+  constexpr char kPieceChars[] = "PRNBQK.?prnbqk";
+  return piece == Piece::None ? '.' : kPieceChars[index(piece)];
+}
+
+} // namespace shepichess
@@ -0,0 +1,687 @@
+#include "position.h"
+
+#include <algorithm>
+#include <mutex>
+#include <random>
+#include <sstream>
+
+#include "logging.h"
+
+namespace shepichess {
+
+std::array<HashKey, 768> Position::zobrist_pieces;
+std::array<HashKey, 4> Position::zobrist_castling;
+std::array<HashKey, 8> Position::zobrist_enpassant;
+HashKey Position::zobrist_side_to_move;
+std::array<HashKey, Position::kCuckooSize> Position::cuckoo_keys;
+std::array<Move, Position::kCuckooSize> Position::cuckoo_moves;
+
+namespace {
+
+// Castling squares for white, black squares are 56 higher
+constexpr int kKingStart = 3;
+constexpr int kKingsideRookStart = 0;
+constexpr int kQueensideRookStart = 7;
+constexpr int kBlackOffset = 56;
+
+// Squares attacked by pawns of the given color
+Bitboard pawnAttacks(Bitboard pawns, Color color)
+{
+  using bitboards::shift;
+  if (color == Color::White) {
+    return shift<Direction::NorthEast>(pawns) | shift<Direction::NorthWest>(pawns);
+  }
+  return shift<Direction::SouthEast>(pawns) | shift<Direction::SouthWest>(pawns);
+}
+
+// Each key has two slots in the cuckoo tables
+size_t cuckooHash1(HashKey key)
+{
+  return key & 0x1fff;
+}
+
+size_t cuckooHash2(HashKey key)
+{
+  return (key >> 16) & 0x1fff;
+}
+
+// Whether the king of color is attacked on a board that isn't set up yet
+bool kingAttacked(const std::array<Piece, 64>& board, Color color)
+{
+  using namespace attack_maps;
+  Bitboard occupied = 0;
+  std::array<Bitboard, kPieceTypeCount> enemies {};
+  int king = 0;
+  for (int square = 0; square < 64; square++) {
+    Piece piece = board[square];
+    if (piece == Piece::None) continue;
+    occupied |= bitboards::fromSquare(square);
+    if (pieceColor(piece) != color) {
+      enemies[index(pieceType(piece))] |= bitboards::fromSquare(square);
+    } else if (pieceType(piece) == PieceType::King) {
+      king = square;
+    }
+  }
+  auto enemy = [&enemies](PieceType type) { return enemies[index(type)]; };
+  Bitboard queens = enemy(PieceType::Queen);
+  return (pawnAttacks(bitboards::fromSquare(king), color) & enemy(PieceType::Pawn)) |
+    (knightAttacks(king) & enemy(PieceType::Knight)) |
+    (kingAttacks(king) & enemy(PieceType::King)) |
+    (rookAttacks(king, occupied) & (enemy(PieceType::Rook) | queens)) |
+    (bishopAttacks(king, occupied) & (enemy(PieceType::Bishop) | queens));
+}
+
+Bitboard pieceAttacks(PieceType type, int square)
+{
+  using namespace attack_maps;
+  switch (type) {
+  case PieceType::Knight: return knightAttacks(square);
+  case PieceType::Bishop: return bishopAttacks(square, 0);
+  case PieceType::Rook: return rookAttacks(square, 0);
+  case PieceType::Queen: return queenAttacks(square, 0);
+  case PieceType::King: return kingAttacks(square);
+  default: return 0;
+  }
+}
+
+} // namespace
+
+Position::Position()
+{
+  init();
+  setStartPosition();
+}
+
+void Position::init()
+{
+  static std::once_flag zobrist_init_flag;
+  std::call_once(zobrist_init_flag, []() {
+    std::mt19937_64 rng {kZobristSeed};
+    for (auto&& key : zobrist_pieces) key = rng();
+    for (auto&& key : zobrist_castling) key = rng();
+    for (auto&& key : zobrist_enpassant) key = rng();
+    zobrist_side_to_move = rng();
+    initCuckoo();
+  });
+}
+
+void Position::initCuckoo()
+{
+  bitboards::init();
+  int count = 0;
+  for (Color color : {Color::White, Color::Black}) {
+    for (int type = index(PieceType::Rook); type < kPieceTypeCount; type++) {
+      Piece piece = makePiece(color, static_cast<PieceType>(type));
+      for (int from = 0; from < 64; from++) {
+        for (int to = from + 1; to < 64; to++) {
+          if (!bitboards::getbit(pieceAttacks(pieceType(piece), from), to)) continue;
+          Move move {from, to};
+          HashKey key =
+            zobristPiece(piece, from) ^ zobristPiece(piece, to) ^ zobrist_side_to_move;
+          // Cuckoo insertion, the displaced entry moves to its other slot
+          size_t slot = cuckooHash1(key);
+          while (true) {
+            std::swap(cuckoo_keys[slot], key);
+            std::swap(cuckoo_moves[slot], move);
+            if (move.isNull()) break;
+            slot = slot == cuckooHash1(key) ? cuckooHash2(key) : cuckooHash1(key);
+          }
+          count++;
+        }
+      }
+    }
+  }
+  SPDLOG_DEBUG("Generated {} cuckoo table entries", count);
+}
+
+void Position::clear()
+{
+  move_number = 1;
+  side_to_move = Color::White;
+  pieces.fill(Piece::None);
+  pieces_by_color.fill(0);
+  pieces_by_type.fill(0);
+  game_ply = 0;
+  oldest_ply = 0;
+}
+
+bool Position::setFen(std::string_view fen)
+{
+  std::istringstream iss {std::string(fen)};
+  std::string board, color, castling, enpassant;
+  int move_count50 = 0, fen_move_number = 1;
+  iss >> board >> color >> castling >> enpassant;
+  if (!iss || (color != "w" && color != "b")) {
+    SPDLOG_ERROR("Failed to parse FEN \"{}\"", fen);
+    return false;
+  }
+  // The move counters are optional
+  if (!(iss >> move_count50 >> fen_move_number)) {
+    move_count50 = 0;
+    fen_move_number = 1;
+  }
+
+  std::array<Piece, 64> parsed_pieces {};
+  parsed_pieces.fill(Piece::None);
+  int rank = 7, file = 0;
+  for (char c : board) {
+    if (c == '/') {
+      if (file != 8 || rank == 0) break;
+      rank--;
+      file = 0;
+    } else if (c >= '1' && c <= '8' && file + (c - '0') <= 8) {
+      file += c - '0';
+    } else if (pieceFromChar(c) != Piece::None && file < 8) {
+      parsed_pieces[makeSquare(file++, rank)] = pieceFromChar(c);
+    } else {
+      rank = -1;
+      break;
+    }
+  }
+  if (rank != 0 || file != 8) {
+    SPDLOG_ERROR("Failed to parse FEN board \"{}\"", board);
+    return false;
+  }
+  // Check detection and move generation rely on exactly one king per side
+  for (Piece king : {Piece::WhiteKing, Piece::BlackKing}) {
+    if (std::count(parsed_pieces.begin(), parsed_pieces.end(), king) != 1) {
+      SPDLOG_ERROR("FEN \"{}\" doesn't have one king per side", fen);
+      return false;
+    }
+  }
+  // The side that just moved can't have left its king in check
+  Color them = color == "w" ? Color::Black : Color::White;
+  if (kingAttacked(parsed_pieces, them)) {
+    SPDLOG_ERROR("FEN \"{}\" has the side not to move in check", fen);
+    return false;
+  }
+
+  clear();
+  for (int square = 0; square < 64; square++) {
+    if (parsed_pieces[square] != Piece::None) putPiece(parsed_pieces[square], square);
+  }
+  side_to_move = color == "w" ? Color::White : Color::Black;
+  move_number = std::max(fen_move_number, 1);
+
+  // Castling rights without the king and rook on their squares are dropped
+  auto castleRight = [&castling, &parsed_pieces](char right, Color color, int rook) {
+    int offset = color == Color::White ? 0 : kBlackOffset;
+    return castling.find(right) != std::string::npos &&
+           parsed_pieces[offset + kKingStart] == makePiece(color, PieceType::King) &&
+           parsed_pieces[offset + rook] == makePiece(color, PieceType::Rook);
+  };
+  PositionState state {};
+  state.white_kingside_castle = castleRight('K', Color::White, kKingsideRookStart);
+  state.white_queenside_castle = castleRight('Q', Color::White, kQueensideRookStart);
+  state.black_kingside_castle = castleRight('k', Color::Black, kKingsideRookStart);
+  state.black_queenside_castle = castleRight('q', Color::Black, kQueensideRookStart);
+  state.move_count50 = static_cast<uint16_t>(move_count50);
+  int ep_square = parseSquare(enpassant);
+  bool ep_valid = canCaptureEnPassant(ep_square, side_to_move);
+  state.enpassant_square = static_cast<uint16_t>(ep_valid ? ep_square : kNoSquare);
+  state.captured = Piece::None;
+  state.move = Move {};
+  for (int square = 0; square < 64; square++) {
+    Piece piece = pieces[square];
+    if (piece == Piece::None) continue;
+    state.material[index(pieceColor(piece))] += kPieceValues[index(pieceType(piece))];
+  }
+  states[0] = state;
+  states[0].zobrist = computeZobrist();
+  updateAttacks(states[0]);
+  Bitboard king = piecesByType(side_to_move, PieceType::King);
+  states[0].checkers =
+    attackersTo(bitboards::bitscan(king), occupied()) & piecesByColor(~side_to_move);
+  return true;
+}
+
+void Position::setStartPosition()
+{
+  setFen(kStartFen);
+}
+
+std::string Position::fen() const
+{
+  std::string result;
+  for (int rank = 7; rank >= 0; rank--) {
+    int empty = 0;
+    for (int file = 0; file < 8; file++) {
+      Piece piece = pieces[makeSquare(file, rank)];
+      if (piece == Piece::None) {
+        empty++;
+        continue;
+      }
+      if (empty) result += static_cast<char>('0' + empty);
+      empty = 0;
+      result += pieceToChar(piece);
+    }
+    if (empty) result += static_cast<char>('0' + empty);
+    if (rank) result += '/';
+  }
+  const PositionState& current = state();
+  result += side_to_move == Color::White ? " w " : " b ";
+  std::string castling;
+  if (current.white_kingside_castle) castling += 'K';
+  if (current.white_queenside_castle) castling += 'Q';
+  if (current.black_kingside_castle) castling += 'k';
+  if (current.black_queenside_castle) castling += 'q';
+  result += castling.empty() ? "-" : castling;
+  result += ' ';
+  bool has_enpassant = current.enpassant_square != kNoSquare;
+  result += has_enpassant ? squareName(current.enpassant_square) : "-";
+  result += ' ' + std::to_string(current.move_count50);
+  result += ' ' + std::to_string(move_number);
+  return result;
+}
+
+void Position::makeMove(Move move)
+{
+  // Built in place in the next history slot
+  PositionState& next = states[(game_ply + 1) & (kHistorySize - 1)];
+  next = state();
+  Color us = side_to_move, them = ~us;
+  int from = move.from(), to = move.to();
+  Piece piece = pieces[from];
+  HashKey key = next.zobrist ^ zobrist_side_to_move;
+  // Checks given by this move, from the check squares and blockers of the
+  // position before it. Only the moved piece can give a direct check, and only a
+  // blocker of the enemy king leaving the line can uncover one.
+  Bitboard direct = next.check_squares[index(pieceType(piece))];
+  next.checkers = direct & bitboards::fromSquare(to);
+  bool discovered = next.king_blockers[index(them)] & bitboards::fromSquare(from);
+
+  next.captured = Piece::None;
+  next.move = move;
+  next.move_count50++;
+  next.plies_from_null++;
+  if (next.enpassant_square != kNoSquare) {
+    key ^= zobrist_enpassant[squareFile(next.enpassant_square)];
+    next.enpassant_square = kNoSquare;
+  }
+
+  if (move.isCapture()) {
+    int capture_square = to;
+    if (move.flag() == MoveFlag::EnPassant) {
+      capture_square = us == Color::White ? to - 8 : to + 8;
+    }
+    Piece captured = pieces[capture_square];
+    key ^= zobristPiece(captured, capture_square);
+    next.material[index(them)] -= kPieceValues[index(pieceType(captured))];
+    next.captured = captured;
+    next.move_count50 = 0;
+    removePiece(capture_square);
+  }
+
+  key ^= zobristPiece(piece, from) ^ zobristPiece(piece, to);
+  movePiece(from, to);
+
+  if (pieceType(piece) == PieceType::Pawn) {
+    next.move_count50 = 0;
+    if (move.isPromotion()) {
+      Piece promoted = makePiece(us, move.promotionType());
+      key ^= zobristPiece(piece, to) ^ zobristPiece(promoted, to);
+      next.material[index(us)] += kPieceValues[index(move.promotionType())] -
+        kPieceValues[index(PieceType::Pawn)];
+      removePiece(to);
+      putPiece(promoted, to);
+    } else if (move.flag() == MoveFlag::DoublePawnPush) {
+      int ep_square = (from + to) / 2;
+      if (canCaptureEnPassant(ep_square, them)) {
+        next.enpassant_square = static_cast<uint16_t>(ep_square);
+        key ^= zobrist_enpassant[squareFile(ep_square)];
+      }
+    }
+  } else if (move.isCastle()) {
+    int offset = us == Color::White ? 0 : kBlackOffset;
+    bool kingside = move.flag() == MoveFlag::KingCastle;
+    int rook_from = offset + (kingside ? kKingsideRookStart : kQueensideRookStart);
+    int rook_to = offset + (kingside ? kKingStart - 1 : kKingStart + 1);
+    Piece rook = pieces[rook_from];
+    key ^= zobristPiece(rook, rook_from) ^ zobristPiece(rook, rook_to);
+    movePiece(rook_from, rook_to);
+  }
+
+  // Update castling rights if a king or rook moved or a rook was captured
+  std::array<bool*, 4> rights {
+    &next.white_kingside_castle,
+    &next.white_queenside_castle,
+    &next.black_kingside_castle,
+    &next.black_queenside_castle};
+  constexpr std::array<int, 4> kRookSquares {
+    kKingsideRookStart,
+    kQueensideRookStart,
+    kKingsideRookStart + kBlackOffset,
+    kQueensideRookStart + kBlackOffset};
+  for (int i = 0; i < 4; i++) {
+    int king_square = kKingStart + (i < 2 ? 0 : kBlackOffset);
+    bool touched =
+      from == king_square || from == kRookSquares[i] || to == kRookSquares[i];
+    if (*rights[i] && touched) {
+      *rights[i] = false;
+      key ^= zobrist_castling[i];
+    }
+  }
+
+  next.zobrist = key;
+  if (us == Color::Black) move_number++;
+  side_to_move = them;
+
+  // The pieces that move or disappear in castling, promotions and en passant
+  // don't match the check squares, look those checks up in full
+  if (move.isCastle() || move.isPromotion() || move.flag() == MoveFlag::EnPassant) {
+    Bitboard king = piecesByType(them, PieceType::King);
+    next.checkers = king
+      ? attackersTo(bitboards::bitscan(king), occupied()) & piecesByColor(us)
+      : 0;
+  } else if (discovered) {
+    using namespace attack_maps;
+    int their_king = kingSquare(them);
+    Bitboard queens = piecesByType(us, PieceType::Queen);
+    Bitboard rooks = queens | piecesByType(us, PieceType::Rook);
+    Bitboard bishops = queens | piecesByType(us, PieceType::Bishop);
+    next.checkers |= (rookAttacks(their_king, occupied()) & rooks) |
+      (bishopAttacks(their_king, occupied()) & bishops);
+  }
+  updateAttacks(next);
+
+  game_ply++;
+  oldest_ply = std::max(oldest_ply, game_ply - kHistorySize + 1);
+}
+
+void Position::unmakeMove()
+{
+  Move move = state().move;
+  Piece captured = state().captured;
+  game_ply--;
+  side_to_move = ~side_to_move;
+  Color us = side_to_move;
+  if (us == Color::Black) move_number--;
+
+  int from = move.from(), to = move.to();
+  if (move.isPromotion()) {
+    removePiece(to);
+    putPiece(makePiece(us, PieceType::Pawn), to);
+  } else if (move.isCastle()) {
+    int offset = us == Color::White ? 0 : kBlackOffset;
+    bool kingside = move.flag() == MoveFlag::KingCastle;
+    int rook_from = offset + (kingside ? kKingsideRookStart : kQueensideRookStart);
+    int rook_to = offset + (kingside ? kKingStart - 1 : kKingStart + 1);
+    movePiece(rook_to, rook_from);
+  }
+  movePiece(to, from);
+
+  if (captured != Piece::None) {
+    int capture_square = to;
+    if (move.flag() == MoveFlag::EnPassant) {
+      capture_square = us == Color::White ? to - 8 : to + 8;
+    }
+    putPiece(captured, capture_square);
+  }
+}
+
+void Position::makeNullMove()
+{
+  PositionState next = state();
+  HashKey key = next.zobrist ^ zobrist_side_to_move;
+  if (next.enpassant_square != kNoSquare) {
+    key ^= zobrist_enpassant[squareFile(next.enpassant_square)];
+    next.enpassant_square = kNoSquare;
+  }
+  next.captured = Piece::None;
+  next.move = Move {};
+  next.move_count50++;
+  next.plies_from_null = 0;
+  next.zobrist = key;
+  if (side_to_move == Color::Black) move_number++;
+  side_to_move = ~side_to_move;
+  // The board doesn't change, only the check squares are for the other side
+  next.checkers = 0;
+  updateAttacks(next);
+  game_ply++;
+  oldest_ply = std::max(oldest_ply, game_ply - kHistorySize + 1);
+  states[game_ply & (kHistorySize - 1)] = next;
+}
+
+void Position::unmakeNullMove()
+{
+  game_ply--;
+  side_to_move = ~side_to_move;
+  if (side_to_move == Color::Black) move_number--;
+}
+
+Bitboard Position::occupied() const
+{
+  return pieces_by_color[0] | pieces_by_color[1];
+}
+
+Bitboard Position::piecesByColor(Color color) const
+{
+  return pieces_by_color[index(color)];
+}
+
+Bitboard Position::piecesByType(Piece piece) const
+{
+  return pieces_by_type[index(piece)];
+}
+
+Bitboard Position::piecesByType(Color color, PieceType type) const
+{
+  return pieces_by_type[index(makePiece(color, type))];
+}
+
+int Position::kingSquare(Color color) const
+{
+  return bitboards::bitscan(piecesByType(color, PieceType::King));
+}
+
+Bitboard Position::attackersTo(int square, Bitboard occupancy) const
+{
+  using namespace attack_maps;
+  Bitboard target = bitboards::fromSquare(square);
+  Bitboard queens = pieces_by_type[index(Piece::WhiteQueen)] |
+    pieces_by_type[index(Piece::BlackQueen)];
+  Bitboard rooks = queens | pieces_by_type[index(Piece::WhiteRook)] |
+    pieces_by_type[index(Piece::BlackRook)];
+  Bitboard bishops = queens | pieces_by_type[index(Piece::WhiteBishop)] |
+    pieces_by_type[index(Piece::BlackBishop)];
+  Bitboard knights = pieces_by_type[index(Piece::WhiteKnight)] |
+    pieces_by_type[index(Piece::BlackKnight)];
+  Bitboard kings = pieces_by_type[index(Piece::WhiteKing)] |
+    pieces_by_type[index(Piece::BlackKing)];
+  // A pawn attacks the target if a pawn of the other color on the target would
+  // attack it
+  return (pawnAttacks(target, Color::Black) & pieces_by_type[index(Piece::WhitePawn)]) |
+    (pawnAttacks(target, Color::White) & pieces_by_type[index(Piece::BlackPawn)]) |
+    (knightAttacks(square) & knights) | (kingAttacks(square) & kings) |
+    (rookAttacks(square, occupancy) & rooks) |
+    (bishopAttacks(square, occupancy) & bishops);
+}
+
+bool Position::isSquareAttacked(int square, Color by) const
+{
+  return attackersTo(square, occupied()) & piecesByColor(by);
+}
+
+// Only king moves and en passant (which removes two pieces from the king's
+// lines) need an attack lookup. Other moves are legal if they resolve any check
+// and either aren't pinned or stay on the line of the pin.
+bool Position::isLegal(Move move) const
+{
+  using bitboards::fromSquare;
+  const PositionState& current = state();
+  Color us = side_to_move;
+  int from = move.from(), to = move.to(), king = kingSquare(us);
+  if (move.flag() == MoveFlag::EnPassant) {
+    int captured = us == Color::White ? to - 8 : to + 8;
+    Bitboard occupancy =
+      (occupied() ^ fromSquare(from) ^ fromSquare(captured)) | fromSquare(to);
+    Bitboard attackers = piecesByColor(~us) & ~fromSquare(captured);
+    return !(attackersTo(king, occupancy) & attackers);
+  }
+  if (from == king) {
+    // Castling squares are checked by the move generator
+    if (move.isCastle()) return true;
+    // The king can't step back along the line of a slider checking it
+    return !(attackersTo(to, occupied() ^ fromSquare(from)) & piecesByColor(~us));
+  }
+  if (Bitboard checkers = current.checkers) {
+    if (bitboards::poplsb(checkers)) return false;
+    int checker = bitboards::bitscan(checkers);
+    if (!((attack_maps::between(king, checker) | checkers) & fromSquare(to))) {
+      return false;
+    }
+  }
+  return !(current.king_blockers[index(us)] & fromSquare(from)) ||
+    (attack_maps::line(from, king) & fromSquare(to));
+}
+
+Bitboard Position::sliderBlockers(int square, Color attackers) const
+{
+  using namespace attack_maps;
+  Bitboard queens = piecesByType(attackers, PieceType::Queen);
+  Bitboard rooks = queens | piecesByType(attackers, PieceType::Rook);
+  Bitboard bishops = queens | piecesByType(attackers, PieceType::Bishop);
+  Bitboard snipers = (rookRays(square) & rooks) | (bishopRays(square) & bishops);
+  if (!snipers) return 0;
+  Bitboard occupancy = occupied() ^ snipers;
+  Bitboard blockers = 0;
+  for (; snipers; snipers = bitboards::poplsb(snipers)) {
+    Bitboard between = attack_maps::between(square, bitboards::bitscan(snipers));
+    Bitboard pieces_between = between & occupancy;
+    if (pieces_between && !bitboards::poplsb(pieces_between)) {
+      blockers |= pieces_between;
+    }
+  }
+  return blockers;
+}
+
+void Position::updateAttacks(PositionState& state) const
+{
+  using namespace attack_maps;
+  Color us = side_to_move, them = ~us;
+  Bitboard our_king = piecesByType(us, PieceType::King);
+  Bitboard their_king = piecesByType(them, PieceType::King);
+  // Positions set up without kings have nothing to check
+  if (!our_king || !their_king) {
+    state.king_blockers = {};
+    state.check_squares = {};
+    return;
+  }
+  int square = bitboards::bitscan(their_king);
+  Bitboard occupancy = occupied();
+  state.king_blockers[index(us)] = sliderBlockers(bitboards::bitscan(our_king), them);
+  state.king_blockers[index(them)] = sliderBlockers(square, us);
+  state.check_squares[index(PieceType::Pawn)] = pawnAttacks(their_king, them);
+  state.check_squares[index(PieceType::Knight)] = knightAttacks(square);
+  state.check_squares[index(PieceType::Bishop)] = bishopAttacks(square, occupancy);
+  state.check_squares[index(PieceType::Rook)] = rookAttacks(square, occupancy);
+  state.check_squares[index(PieceType::Queen)] =
+    state.check_squares[index(PieceType::Bishop)] |
+    state.check_squares[index(PieceType::Rook)];
+  state.check_squares[index(PieceType::King)] = 0;
+}
+
+bool Position::isDraw() const
+{
+  const PositionState& current = state();
+  if (current.move_count50 >= 100) return true;
+  // Only positions with the same side to move since the last irreversible (or
+  // null) move can repeat
+  int end = std::min<int>(
+    {current.move_count50, current.plies_from_null, undoablePlies()});
+  for (int i = 2; i <= end; i += 2) {
+    if (stateAt(i).zobrist == current.zobrist) return true;
+  }
+  return false;
+}
+
+// The positions since the last irreversible move are scanned for one that
+// differs from the current one by a single reversible move, found by looking up
+// the key difference in the cuckoo tables. Only positions with the other side to
+// move and an even number of plies back (so the same side made the move) can be
+// reached by one move.
+bool Position::hasUpcomingRepetition(int ply) const
+{
+  const PositionState& current = state();
+  int end = std::min<int>(
+    {current.move_count50, current.plies_from_null, undoablePlies()});
+  if (end < 3) return false;
+  HashKey key = current.zobrist;
+  // Tracks whether the moves in between cancel out, this is 0 when the pieces
+  // the other side moved are back where they were
+  HashKey other = key ^ stateAt(1).zobrist ^ zobrist_side_to_move;
+  for (int i = 3; i <= end; i += 2) {
+    other ^= stateAt(i - 1).zobrist ^ stateAt(i).zobrist ^ zobrist_side_to_move;
+    if (other != 0) continue;
+    HashKey move_key = key ^ stateAt(i).zobrist;
+    size_t slot = cuckooHash1(move_key);
+    if (cuckoo_keys[slot] != move_key) {
+      slot = cuckooHash2(move_key);
+      if (cuckoo_keys[slot] != move_key) continue;
+    }
+    Move move = cuckoo_moves[slot];
+    if (attack_maps::between(move.from(), move.to()) & occupied()) continue;
+    if (ply > i) return true;
+  }
+  return false;
+}
+
+void Position::putPiece(Piece piece, int square)
+{
+  Bitboard bit = bitboards::fromSquare(square);
+  pieces[square] = piece;
+  pieces_by_color[index(pieceColor(piece))] |= bit;
+  pieces_by_type[index(piece)] |= bit;
+}
+
+void Position::removePiece(int square)
+{
+  Piece piece = pieces[square];
+  Bitboard bit = bitboards::fromSquare(square);
+  pieces[square] = Piece::None;
+  pieces_by_color[index(pieceColor(piece))] &= ~bit;
+  pieces_by_type[index(piece)] &= ~bit;
+}
+
+void Position::movePiece(int from, int to)
+{
+  Piece piece = pieces[from];
+  removePiece(from);
+  putPiece(piece, to);
+}
+
+HashKey Position::computeZobrist() const
+{
+  const PositionState& current = state();
+  HashKey key = 0;
+  for (int square = 0; square < 64; square++) {
+    if (pieces[square] != Piece::None) key ^= zobristPiece(pieces[square], square);
+  }
+  if (current.white_kingside_castle) key ^= zobrist_castling[0];
+  if (current.white_queenside_castle) key ^= zobrist_castling[1];
+  if (current.black_kingside_castle) key ^= zobrist_castling[2];
+  if (current.black_queenside_castle) key ^= zobrist_castling[3];
+  if (current.enpassant_square != kNoSquare) {
+    key ^= zobrist_enpassant[squareFile(current.enpassant_square)];
+  }
+  if (side_to_move == Color::Black) key ^= zobrist_side_to_move;
+  return key;
+}
+
+// The en passant square is only recorded (and hashed) if there is a pawn that
+// could capture on it, so transpositions hash equal
+bool Position::canCaptureEnPassant(int square, Color by) const
+{
+  if (square == kNoSquare) return false;
+  Bitboard attackers = pawnAttacks(bitboards::fromSquare(square), ~by);
+  return attackers & piecesByType(by, PieceType::Pawn);
+}
+
+HashKey Position::zobristPiece(Piece piece, int square)
+{
+  int piece_index =
+    index(pieceColor(piece)) * kPieceTypeCount + index(pieceType(piece));
+  return zobrist_pieces[piece_index * 64 + square];
+}
+
+} // namespace shepichess
@@ -1,30 +1,23 @@
 #pragma once
 
 #include <array>
-#include <vector>
+#include <string>
+#include <string_view>
 
 #include "bitboard.h"
 #include "hash_table.h"
 #include "move.h"
+#include "piece.h"
 
 namespace shepichess {
 
-enum class Piece {
-  WhitePawn = 0,
-  WhiteRook,
-  WhiteKnight,
-  WhiteBishop,
-  WhiteQueen,
-  WhiteKing,
-  BlackPawn = 8,
-  BlackRook,
-  BlackKnight,
-  BlackBishop,
-  BlackQueen,
-  BlackKing
-};
-
-enum class Color { White, Black };
+const inline std::string kStartFen {
+  "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"};
+// Zobrist keys are generated from a fixed seed so hashes are stable across runs
+constexpr uint64_t kZobristSeed = 0x5348'4550'4943'4845ULL;
+// Plies of history kept by a Position, enough for the fifty move rule window and
+// a full search on top of it. Older states are overwritten, see undoablePlies.
+constexpr int kHistorySize = 256;
 
 struct PositionState {
   bool white_kingside_castle;
@@ -32,33 +25,118 @@ struct PositionState {
   bool black_kingside_castle;
   bool black_queenside_castle;
   uint16_t move_count50;
+  // Repetitions can't span a null move, see makeNullMove
+  uint16_t plies_from_null;
   uint16_t enpassant_square;
   std::array<uint16_t, 2> material;
   HashKey zobrist;
+  // The move leading to this state and the piece it captured, to unmake it
+  Piece captured;
+  Move move;
+  // Attack information, computed once by makeMove so move generation and the
+  // search don't recompute it for every move. Pieces giving check:
+  Bitboard checkers;
+  // Pieces of either color that are the only piece between each color's king and
+  // an enemy slider. Its own pieces are pinned, the enemy's give discovered check
+  // if they leave the line.
+  std::array<Bitboard, 2> king_blockers;
+  // Squares a piece of each type of the side to move would give check from
+  std::array<Bitboard, kPieceTypeCount> check_squares;
 };
 
 class Position {
 public:
-  Position() = default;
+  Position();
   ~Position() = default;
-  Position(const Position&) = delete;
-  Position(const Position&&) = delete;
-  Position& operator=(const Position&) = delete;
+  // Copies are only made explicitly, to give each search thread its own board
+  Position(const Position&) = default;
+  Position& operator=(const Position&) = default;
+  Position(Position&&) = delete;
   Position& operator=(Position&&) = delete;
 
+  // Generates the zobrist keys and cuckoo tables, safe to call more than once
+  static void init();
+
+  // Returns false (leaving the position unchanged) if the FEN can't be parsed
+  bool setFen(std::string_view fen);
+  void setStartPosition();
+  [[nodiscard]] std::string fen() const;
+
+  // Moves must be legal, see movegen.h
+  void makeMove(Move move);
+  void unmakeMove();
+  // Passes the turn, for null move pruning. Must not be made in check.
+  void makeNullMove();
+  void unmakeNullMove();
+
+  [[nodiscard]] Color sideToMove() const { return side_to_move; }
+  [[nodiscard]] Piece pieceOn(int square) const { return pieces[square]; }
+  [[nodiscard]] Bitboard occupied() const;
+  [[nodiscard]] Bitboard piecesByColor(Color color) const;
+  [[nodiscard]] Bitboard piecesByType(Piece piece) const;
+  [[nodiscard]] Bitboard piecesByType(Color color, PieceType type) const;
+  [[nodiscard]] int kingSquare(Color color) const;
+  [[nodiscard]] const PositionState& state() const { return stateAt(0); }
+  [[nodiscard]] HashKey zobrist() const { return stateAt(0).zobrist; }
+  [[nodiscard]] int moveNumber() const { return move_number; }
+  // Plies played since the position was set up
+  [[nodiscard]] int gamePly() const { return game_ply; }
+  // Number of moves that can still be unmade
+  [[nodiscard]] int undoablePlies() const { return game_ply - oldest_ply; }
+
+  [[nodiscard]] Bitboard attackersTo(int square, Bitboard occupancy) const;
+  [[nodiscard]] bool isSquareAttacked(int square, Color by) const;
+  [[nodiscard]] bool inCheck() const { return state().checkers; }
+  // Whether a pseudo-legal move from generateMoves leaves the king safe, without
+  // making it
+  [[nodiscard]] bool isLegal(Move move) const;
+  // Fifty move rule or repetition since the last irreversible move
+  [[nodiscard]] bool isDraw() const;
+  // Whether the side to move has a reversible move reaching a position seen
+  // since the last irreversible move, so it can force at least a draw. Only
+  // cycles that started less than ply plies ago (inside the search) count.
+  [[nodiscard]] bool hasUpcomingRepetition(int ply) const;
+
 private:
-  int move_number = 0;
+  int move_number = 1;
   Color side_to_move = Color::White;
   std::array<Piece, 64> pieces {};
   std::array<Bitboard, 2> pieces_by_color {};
   std::array<Bitboard, 16> pieces_by_type {};
-  std::vector<PositionState> states;
-  std::vector<Move> moves;
+  int game_ply = 0;
+  // Oldest ply whose state hasn't been overwritten yet
+  int oldest_ply = 0;
+  // Fixed size ring buffer indexed by game_ply, so making a move never allocates
+  alignas(64) std::array<PositionState, kHistorySize> states {};
   // Zobrist constants
   static std::array<HashKey, 768> zobrist_pieces;
   static std::array<HashKey, 4> zobrist_castling;
   static std::array<HashKey, 8> zobrist_enpassant;
   static HashKey zobrist_side_to_move;
+  // Cuckoo hash tables of the key difference made by every reversible move of a
+  // piece (other than a pawn) between two squares, for hasUpcomingRepetition
+  static constexpr size_t kCuckooSize = 8192;
+  static std::array<HashKey, kCuckooSize> cuckoo_keys;
+  static std::array<Move, kCuckooSize> cuckoo_moves;
+
+  [[nodiscard]] const PositionState& stateAt(int plies_ago) const
+  {
+    return states[(game_ply - plies_ago) & (kHistorySize - 1)];
+  }
+  void clear();
+  void putPiece(Piece piece, int square);
+  void removePiece(int square);
+  void movePiece(int from, int to);
+  [[nodiscard]] HashKey computeZobrist() const;
+  [[nodiscard]] bool canCaptureEnPassant(int square, Color by) const;
+  [[nodiscard]] Bitboard sliderBlockers(int square, Color attackers) const;
+  // Fills in the king blockers and check squares of state for the current board
+  void updateAttacks(PositionState& state) const;
+  static HashKey zobristPiece(Piece piece, int square);
+  static void initCuckoo();
 };
 
+// Value of each piece type in centipawns, indexed by PieceType
+constexpr std::array<int, kPieceTypeCount> kPieceValues {100, 500, 320, 330, 900, 0};
+
 } // namespace shepichess
@@ -0,0 +1,800 @@
+#include "search.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include "eval.h"
+#include "logging.h"
+#include "movegen.h"
+#include "tracing.h"
+
+namespace shepichess {
+
+namespace {
+
+using namespace std::chrono_literals;
+
+enum class Bound : uint16_t { None = 0, Upper, Lower, Exact };
+
+// Nodes between time/node limit checks on the main thread
+constexpr uint64_t kCheckInterval = 1024;
+// Milliseconds kept in reserve for GUI communication
+constexpr int64_t kMoveOverhead = 10;
+constexpr int kDefaultMovesToGo = 30;
+// Depth of the normal search that picks a move when go mate finds no mate
+constexpr int kMateFallbackDepth = 6;
+
+// Set while the thread runs an iteration's root alphaBeta call
+thread_local bool node_search = false;
+
+// Move ordering scores
+constexpr int kTTMoveScore = 1'000'000;
+constexpr int kCaptureScore = 100'000;
+constexpr int kKillerScore = 90'000;
+
+// Selective search, see SearchParams. Margins are in centipawns per ply of
+// remaining depth.
+constexpr int kNullMoveMinDepth = 3;
+constexpr int kReverseFutilityMaxDepth = 8;
+constexpr int kReverseFutilityMargin = 80;
+constexpr int kRazoringMaxDepth = 3;
+constexpr int kRazoringMargin = 250;
+constexpr int kLMRMinDepth = 3;
+// Quiet moves searched at full depth before reductions start
+constexpr int kLMRFullDepthMoves = 3;
+// History score worth one ply less reduction
+constexpr int kLMRHistoryDivisor = 1024;
+// A capture must be able to raise the standing pat score this close to alpha
+constexpr int kQSearchFutilityMargin = 200;
+// No capture (plus promotion) can gain more than this
+constexpr int kDeltaMargin = 1100;
+
+// Late move reductions by depth and move number, log(depth) * log(moves) / 2.25
+const auto kReductions = [] {
+  std::array<std::array<uint8_t, kMaxMoves>, kMaxPly + 1> table {};
+  for (int depth = 1; depth <= kMaxPly; depth++) {
+    for (int moves = 1; moves < kMaxMoves; moves++) {
+      double reduction = 0.75 + std::log(depth) * std::log(moves) / 2.25;
+      table[depth][moves] = static_cast<uint8_t>(reduction);
+    }
+  }
+  return table;
+}();
+
+// Mate scores are stored relative to the node rather than the root
+int scoreToTT(int score, int ply)
+{
+  if (score >= kMateBound) return score + ply;
+  if (score <= -kMateBound) return score - ply;
+  return score;
+}
+
+int scoreFromTT(int score, int ply)
+{
+  if (score >= kMateBound) return score - ply;
+  if (score <= -kMateBound) return score + ply;
+  return score;
+}
+
+std::string scoreString(int score)
+{
+  if (std::abs(score) < kMateBound) return "cp " + std::to_string(score);
+  int moves = (kMateScore - std::abs(score) + 1) / 2;
+  return "mate " + std::to_string(score > 0 ? moves : -moves);
+}
+
+bool contains(const std::vector<Move>& moves, Move move)
+{
+  return std::find(moves.begin(), moves.end(), move) != moves.end();
+}
+
+// Moves the highest scored remaining move to index i (selection sort, since
+// a cutoff usually happens after only a few moves)
+void pickMove(MoveList& moves, std::array<int, kMaxMoves>& scores, int i)
+{
+  int best = i;
+  for (int j = i + 1; j < moves.size(); j++) {
+    if (scores[j] > scores[best]) best = j;
+  }
+  std::swap(moves[i], moves[best]);
+  std::swap(scores[i], scores[best]);
+}
+
+struct RootMove {
+  explicit RootMove(Move move) : move(move) {}
+
+  Move move;
+  // Exact score from the current line, or -kInfinity if the move failed low
+  int score = -kInfinity;
+  int pv_length = 0;
+  std::array<Move, kMaxPly + 1> pv {};
+};
+
+// Everything the search keeps per ply. Each thread allocates a stack of these
+// once, so searching never allocates.
+struct alignas(64) PlyData {
+  MoveList moves;
+  std::array<int, kMaxMoves> scores;
+  std::array<Move, 2> killers;
+  int static_eval;
+  // Principal variation from this ply, pv[ply] to pv[pv_length - 1]
+  int pv_length;
+  std::array<Move, kMaxPly + 1> pv;
+};
+
+bool byScore(const RootMove& a, const RootMove& b)
+{
+  return a.score > b.score;
+}
+
+// Value gained by a capture or promotion
+int captureGain(const Position& position, Move move)
+{
+  int gain = 0;
+  if (move.flag() == MoveFlag::EnPassant) {
+    gain = kPieceValues[index(PieceType::Pawn)];
+  } else if (move.isCapture()) {
+    gain = kPieceValues[index(pieceType(position.pieceOn(move.to())))];
+  }
+  if (move.isPromotion()) {
+    gain += kPieceValues[index(move.promotionType())] - kPieceValues[0];
+  }
+  return gain;
+}
+
+// Zugzwang guard for null move pruning: with only pawns left passing is often
+// the best move, so the null move result can't be trusted
+bool hasNonPawnMaterial(const Position& position, Color color)
+{
+  Bitboard pawns_and_king = position.piecesByType(color, PieceType::Pawn) |
+    position.piecesByType(color, PieceType::King);
+  return position.piecesByColor(color) & ~pawns_and_king;
+}
+
+} // namespace
+
+// Created once per search thread. The position's state history and the ply
+// stack have a fixed size, so they never grow (or move) during a search.
+struct Search::ThreadData {
+  explicit ThreadData(size_t id) : id(id) {}
+
+  size_t id;
+  Position position;
+  std::atomic<uint64_t> nodes {0};
+  int sel_depth = 0;
+  Move best_move;
+  int best_score = 0;
+  std::vector<RootMove> root_moves;
+  // Line currently searched, root moves before it are excluded
+  size_t pv_index = 0;
+  std::array<PlyData, kMaxPly + 1> stack {};
+  std::array<std::array<int, 64>, 64> history {};
+
+  // Only the owning thread writes nodes, so a full atomic increment isn't needed
+  void countNode()
+  {
+    nodes.store(nodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+  void reset(const Position& root);
+  void scoreMoves(
+    const MoveList& moves,
+    std::array<int, kMaxMoves>& scores,
+    Move tt_move,
+    int ply) const;
+  void updatePV(int ply, Move move);
+  void updateRootMove(Move move, int score, bool exact);
+};
+
+void Search::ThreadData::reset(const Position& root)
+{
+  position = root;
+  nodes = 0;
+  sel_depth = 0;
+  best_move = Move {};
+  best_score = 0;
+  for (auto&& ply_data : stack) ply_data.killers.fill(Move {});
+  for (auto&& from_history : history) from_history.fill(0);
+}
+
+void Search::ThreadData::scoreMoves(
+  const MoveList& moves,
+  std::array<int, kMaxMoves>& scores,
+  Move tt_move,
+  int ply) const
+{
+  for (int i = 0; i < moves.size(); i++) {
+    Move move = moves[i];
+    if (move == tt_move) {
+      scores[i] = kTTMoveScore;
+    } else if (move.isCapture() || move.isPromotion()) {
+      // Most valuable victim, least valuable attacker
+      Piece victim = move.flag() == MoveFlag::EnPassant ? Piece::WhitePawn
+                                                         : position.pieceOn(move.to());
+      Piece attacker = position.pieceOn(move.from());
+      int victim_value =
+        victim == Piece::None ? 0 : kPieceValues[index(pieceType(victim))];
+      int promotion_value =
+        move.isPromotion() ? kPieceValues[index(move.promotionType())] : 0;
+      scores[i] = kCaptureScore + (victim_value + promotion_value) * 8 -
+        kPieceValues[index(pieceType(attacker))] / 10;
+    } else if (move == stack[ply].killers[0]) {
+      scores[i] = kKillerScore;
+    } else if (move == stack[ply].killers[1]) {
+      scores[i] = kKillerScore - 1;
+    } else {
+      scores[i] = std::min(history[move.from()][move.to()], kKillerScore - 2);
+    }
+  }
+}
+
+void Search::ThreadData::updatePV(int ply, Move move)
+{
+  PlyData& current = stack[ply];
+  const PlyData& child = stack[ply + 1];
+  current.pv[ply] = move;
+  for (int i = ply + 1; i < child.pv_length; i++) {
+    current.pv[i] = child.pv[i];
+  }
+  current.pv_length = std::max(child.pv_length, ply + 1);
+}
+
+void Search::ThreadData::updateRootMove(Move move, int score, bool exact)
+{
+  auto root_move = std::find_if(
+    root_moves.begin() + pv_index, root_moves.end(), [move](const RootMove& root) {
+      return root.move == move;
+    });
+  if (!exact) {
+    root_move->score = -kInfinity;
+    return;
+  }
+  const PlyData& child = stack[1];
+  root_move->score = score;
+  root_move->pv[0] = move;
+  auto child_pv = child.pv.begin();
+  std::copy(child_pv + 1, child_pv + child.pv_length, root_move->pv.begin() + 1);
+  root_move->pv_length = std::max(child.pv_length, 1);
+}
+
+bool inNodeSearch()
+{
+  return node_search;
+}
+
+void SearchLimits::clear()
+{
+  std::vector<Move> moves = std::move(search_moves);
+  moves.clear();
+  *this = SearchLimits {};
+  search_moves = std::move(moves);
+}
+
+Search::Search(ThreadPool& threads, HashTable& tt, UCIOutput& output)
+  : threads(threads), tt(tt), output(&output)
+{
+}
+
+Search::~Search()
+{
+  stop();
+  wait();
+}
+
+void Search::start(const Position& root, const SearchLimits& new_limits)
+{
+  threads.wait();
+  limits = new_limits;
+  // Thread data is only allocated when the number of threads changes
+  while (thread_data.size() < threads.size()) {
+    thread_data.push_back(std::make_unique<ThreadData>(thread_data.size()));
+  }
+  thread_data.resize(threads.size());
+  for (auto&& thread : thread_data) {
+    thread->reset(root);
+  }
+  root_color = root.sideToMove();
+  waiting_for_ponderhit = limits.ponder;
+  pondering = limits.ponder;
+  if (limits.ponder) {
+    time_limited = false;
+  } else {
+    setupTimeLimits(root_color, limits.start_time);
+  }
+  best_move = Move {};
+  best_score = 0;
+  stop_flag = false;
+  threads.start([this](size_t thread_index) { run(thread_index); });
+}
+
+void Search::stop()
+{
+  stop_flag = true;
+}
+
+void Search::wait()
+{
+  threads.wait();
+}
+
+bool Search::searching()
+{
+  return !stop_flag && threads.busy();
+}
+
+void Search::ponderhit()
+{
+  pondering = false;
+}
+
+void Search::setOutput(UCIOutput& new_output)
+{
+  threads.wait();
+  output = &new_output;
+}
+
+void Search::setParams(const SearchParams& params)
+{
+  threads.wait();
+  search_params = params;
+}
+
+std::chrono::microseconds Search::startLatency() const
+{
+  return std::chrono::microseconds {start_latency_us.load()};
+}
+
+Move Search::bestMove() const
+{
+  return best_move;
+}
+
+int Search::score() const
+{
+  return best_score;
+}
+
+uint64_t Search::nodes() const
+{
+  uint64_t total = 0;
+  for (auto&& thread : thread_data) {
+    total += thread->nodes.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+size_t Search::memoryUsage() const
+{
+  size_t bytes = mate_search ? mate_search->memoryUsage() : 0;
+  for (auto&& thread : thread_data) {
+    bytes += sizeof(ThreadData) + thread->root_moves.capacity() * sizeof(RootMove);
+  }
+  return bytes;
+}
+
+void Search::run(size_t thread_index)
+{
+  ThreadData& thread = *thread_data[thread_index];
+  if (thread_index == 0) {
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+      Clock::now() - limits.start_time);
+    start_latency_us = latency.count();
+    SPDLOG_DEBUG("Search started {}us after go was received", latency.count());
+  }
+  // The mate solver is single threaded, helper threads have nothing to do
+  if (limits.mate > 0) {
+    if (thread_index != 0) return;
+    mateSearch(thread);
+  } else {
+    iterativeDeepening(thread);
+  }
+  if (thread_index != 0) return;
+  // UCI doesn't allow bestmove before stop when searching infinitely, or before
+  // ponderhit or stop when pondering
+  while ((limits.infinite || pondering) && !stop_flag) {
+    std::this_thread::sleep_for(1ms);
+  }
+  stop_flag = true;
+  best_move = thread.best_move;
+  best_score = thread.best_score;
+  std::string line = "bestmove " + best_move.uci();
+  if (Move ponder_move = ponderMove(thread); !ponder_move.isNull()) {
+    line += " ponder " + ponder_move.uci();
+  }
+  output->sendBestMove(line);
+}
+
+// Deadlines count from the go command, or from ponderhit when pondering
+void Search::setupTimeLimits(Color us, Clock::time_point from)
+{
+  time_limited = false;
+  int64_t soft_limit = 0, hard_limit = 0;
+  if (limits.infinite) {
+    return;
+  } else if (limits.move_time > 0) {
+    soft_limit = hard_limit = limits.move_time - kMoveOverhead;
+  } else if (limits.time[index(us)] > 0) {
+    int64_t time = limits.time[index(us)], increment = limits.increment[index(us)];
+    int moves_to_go = limits.moves_to_go > 0 ? limits.moves_to_go : kDefaultMovesToGo;
+    hard_limit = std::min(time / 2 + increment, time - kMoveOverhead);
+    soft_limit = std::min(time / moves_to_go + increment * 3 / 4, hard_limit);
+  } else {
+    return;
+  }
+  time_limited = true;
+  soft_limit = std::max<int64_t>(soft_limit, 1);
+  hard_limit = std::max<int64_t>(hard_limit, 1);
+  soft_deadline = from + std::chrono::milliseconds {soft_limit};
+  hard_deadline = from + std::chrono::milliseconds {hard_limit};
+}
+
+// Called by the main thread, so the time limits are only ever touched by it
+// while searching
+void Search::checkPonderhit()
+{
+  if (!waiting_for_ponderhit || pondering) return;
+  waiting_for_ponderhit = false;
+  setupTimeLimits(root_color, Clock::now());
+}
+
+// The expected reply, from the PV or else the hash table
+Move Search::ponderMove(ThreadData& thread)
+{
+  if (best_move.isNull()) return Move {};
+  const RootMove& root_move = thread.root_moves[0];
+  if (root_move.move == best_move && root_move.pv_length > 1) return root_move.pv[1];
+  Position& position = thread.position;
+  position.makeMove(best_move);
+  Move ponder_move;
+  if (std::optional<HashEntry> entry = tt.probe(position.zobrist())) {
+    MoveList moves;
+    generateLegalMoves(position, moves);
+    Move tt_move = Move::fromData(entry->bestMove());
+    if (moves.contains(tt_move)) ponder_move = tt_move;
+  }
+  position.unmakeMove();
+  return ponder_move;
+}
+
+void Search::iterativeDeepening(ThreadData& thread)
+{
+  MoveList legal_moves;
+  generateLegalMoves(thread.position, legal_moves);
+  thread.root_moves.clear();
+  for (Move move : legal_moves) {
+    if (limits.search_moves.empty() || contains(limits.search_moves, move)) {
+      thread.root_moves.emplace_back(move);
+    }
+  }
+  if (thread.root_moves.empty()) return;
+  // Make sure there is a move to play even if the first iteration is interrupted
+  thread.best_move = thread.root_moves[0].move;
+  size_t multi_pv = std::min(
+    static_cast<size_t>(std::max(limits.multi_pv, 1)), thread.root_moves.size());
+
+  int max_depth = limits.depth > 0 ? std::min(limits.depth, kMaxPly - 1) : kMaxPly - 1;
+  for (int depth = 1; depth <= max_depth; depth++) {
+    // Helper threads skip some iterations so they don't all search the same tree
+    if (thread.id % 2 && depth > 1 && depth % 2) continue;
+    TraceZone zone("iteration", depth);
+    auto begin = thread.root_moves.begin();
+    for (thread.pv_index = 0; thread.pv_index < multi_pv; thread.pv_index++) {
+      thread.sel_depth = 0;
+      node_search = true;
+      alphaBeta(thread, -kInfinity, kInfinity, depth, 0);
+      node_search = false;
+      if (stop_flag) break;
+      // The best remaining move becomes this line, moves that failed low keep
+      // their order from the previous iteration
+      std::stable_sort(begin + thread.pv_index, thread.root_moves.end(), byScore);
+    }
+    if (stop_flag) break;
+    std::stable_sort(begin, begin + multi_pv, byScore);
+    thread.best_move = thread.root_moves[0].move;
+    thread.best_score = thread.root_moves[0].score;
+    if (thread.id != 0) continue;
+    reportIteration(thread, depth, multi_pv);
+    checkPonderhit();
+    if (time_limited && Clock::now() >= soft_deadline) break;
+  }
+}
+
+int Search::alphaBeta(ThreadData& thread, int alpha, int beta, int depth, int ply)
+{
+  thread.stack[ply].pv_length = ply;
+  if (depth <= 0) return quiescence(thread, alpha, beta, ply);
+  thread.countNode();
+  checkLimits(thread);
+  if (stop_flag.load(std::memory_order_relaxed)) return 0;
+
+  Position& position = thread.position;
+  bool root = ply == 0;
+  bool pv_node = beta - alpha > 1;
+  if (!root) {
+    if (position.isDraw()) return 0;
+    if (ply >= kMaxPly) return evaluate(position);
+    // A move back to an earlier position is available, so the score is at least
+    // a draw
+    if (alpha < 0 && position.hasUpcomingRepetition(ply)) {
+      alpha = 0;
+      if (alpha >= beta) return alpha;
+    }
+    // Mate distance pruning
+    alpha = std::max(alpha, -kMateScore + ply);
+    beta = std::min(beta, kMateScore - ply - 1);
+    if (alpha >= beta) return alpha;
+  }
+
+  HashKey key = position.zobrist();
+  Move tt_move;
+  if (std::optional<HashEntry> entry = tt.probe(key)) {
+    tt_move = Move::fromData(entry->bestMove());
+    if (!pv_node && entry->depth() >= depth) {
+      int score = scoreFromTT(static_cast<int16_t>(entry->eval()), ply);
+      auto bound = static_cast<Bound>(entry->bound());
+      if (
+        bound == Bound::Exact || (bound == Bound::Lower && score >= beta) ||
+        (bound == Bound::Upper && score <= alpha)) {
+        return score;
+      }
+    }
+  }
+
+  PlyData& ply_data = thread.stack[ply];
+  bool in_check = position.inCheck();
+  int static_eval = ply_data.static_eval = in_check ? -kInfinity : evaluate(position);
+  if (in_check) depth++;
+  Color us = position.sideToMove();
+
+  if (!pv_node && !in_check && std::abs(beta) < kMateBound) {
+    // Reverse futility: far enough above beta that no quiet line will drop back
+    if (
+      search_params.reverse_futility && depth <= kReverseFutilityMaxDepth &&
+      static_eval - kReverseFutilityMargin * depth >= beta) {
+      return static_eval;
+    }
+    // Razoring: far below alpha, only captures could still raise it
+    if (
+      search_params.razoring && depth <= kRazoringMaxDepth &&
+      static_eval + kRazoringMargin * depth <= alpha) {
+      int score = quiescence(thread, alpha, alpha + 1, ply);
+      if (score <= alpha) return score;
+    }
+    // Null move: if passing still fails high a real move will too. Not twice in a
+    // row, and not without pieces where zugzwang is likely.
+    if (
+      search_params.null_move && depth >= kNullMoveMinDepth && static_eval >= beta &&
+      !position.state().move.isNull() && hasNonPawnMaterial(position, us)) {
+      int reduction = 3 + depth / 6;
+      position.makeNullMove();
+      int null_depth = std::max(depth - 1 - reduction, 0);
+      int score = -alphaBeta(thread, -beta, -beta + 1, null_depth, ply + 1);
+      position.unmakeNullMove();
+      if (stop_flag.load(std::memory_order_relaxed)) return 0;
+      // Mates found after passing aren't proven
+      if (score >= beta) return score >= kMateBound ? beta : score;
+    }
+  }
+
+  MoveList& moves = ply_data.moves;
+  std::array<int, kMaxMoves>& scores = ply_data.scores;
+  moves.clear();
+  if (root) {
+    // Root moves are already ordered by the previous lines and iterations
+    for (size_t i = thread.pv_index; i < thread.root_moves.size(); i++) {
+      scores[moves.size()] = -static_cast<int>(i);
+      moves.push(thread.root_moves[i].move);
+    }
+  } else {
+    generateMoves<MoveGenType::All>(position, moves);
+    thread.scoreMoves(moves, scores, tt_move, ply);
+  }
+
+  int original_alpha = alpha, best_score = -kInfinity, legal_moves = 0;
+  Move best;
+  for (int i = 0; i < moves.size(); i++) {
+    pickMove(moves, scores, i);
+    Move move = moves[i];
+    bool quiet = !move.isCapture() && !move.isPromotion();
+    // Killers and the hash move score above any history
+    bool killer = scores[i] >= kKillerScore - 1;
+    if (!position.isLegal(move)) continue;
+    position.makeMove(move);
+    legal_moves++;
+    // Late move reductions: quiet moves ordered late are unlikely to be best, so
+    // they get a reduced null window search first. Moves with good history and
+    // moves in PV nodes are reduced less.
+    int reduction = 0;
+    if (
+      search_params.late_move_reductions && depth >= kLMRMinDepth &&
+      legal_moves > kLMRFullDepthMoves && quiet && !killer && !in_check &&
+      !position.inCheck()) {
+      reduction = kReductions[depth][std::min(legal_moves, kMaxMoves - 1)];
+      reduction -= pv_node;
+      reduction -= thread.history[move.from()][move.to()] / kLMRHistoryDivisor;
+      reduction = std::clamp(reduction, 0, depth - 2);
+    }
+    // Principal variation search, later moves are searched with a null window
+    int score = 0;
+    if (legal_moves == 1) {
+      score = -alphaBeta(thread, -beta, -alpha, depth - 1, ply + 1);
+    } else {
+      score = -alphaBeta(thread, -alpha - 1, -alpha, depth - 1 - reduction, ply + 1);
+      if (reduction && score > alpha) {
+        score = -alphaBeta(thread, -alpha - 1, -alpha, depth - 1, ply + 1);
+      }
+      if (score > alpha && score < beta) {
+        score = -alphaBeta(thread, -beta, -alpha, depth - 1, ply + 1);
+      }
+    }
+    position.unmakeMove();
+    if (stop_flag.load(std::memory_order_relaxed)) return 0;
+    if (root) thread.updateRootMove(move, score, legal_moves == 1 || score > alpha);
+
+    if (score <= best_score) continue;
+    best_score = score;
+    best = move;
+    if (score <= alpha) continue;
+    alpha = score;
+    thread.updatePV(ply, move);
+    if (alpha >= beta) {
+      if (quiet) {
+        if (ply_data.killers[0] != move) {
+          ply_data.killers[1] = ply_data.killers[0];
+          ply_data.killers[0] = move;
+        }
+        thread.history[move.from()][move.to()] += depth * depth;
+      }
+      break;
+    }
+  }
+
+  if (!legal_moves) return in_check ? -kMateScore + ply : 0;
+
+  // Later MultiPV lines exclude the best root moves, so their result isn't the
+  // real value of the root position
+  if (root && thread.pv_index > 0) return best_score;
+  Bound bound = best_score >= beta ? Bound::Lower
+    : alpha > original_alpha       ? Bound::Exact
+                                   : Bound::Upper;
+  tt.stash(HashEntry {
+    static_cast<uint16_t>(depth),
+    static_cast<uint16_t>(scoreToTT(best_score, ply)),
+    best.data(),
+    key,
+    static_cast<uint16_t>(bound)});
+  return best_score;
+}
+
+int Search::quiescence(ThreadData& thread, int alpha, int beta, int ply)
+{
+  PlyData& ply_data = thread.stack[ply];
+  ply_data.pv_length = ply;
+  thread.sel_depth = std::max(thread.sel_depth, ply);
+  thread.countNode();
+  checkLimits(thread);
+  if (stop_flag.load(std::memory_order_relaxed)) return 0;
+
+  Position& position = thread.position;
+  int stand_pat = ply_data.static_eval = evaluate(position);
+  int best_score = stand_pat;
+  if (ply >= kMaxPly || best_score >= beta) return best_score;
+  // Delta pruning: even the best possible capture can't reach alpha
+  if (search_params.delta_pruning && stand_pat + kDeltaMargin <= alpha) {
+    return stand_pat;
+  }
+  alpha = std::max(alpha, best_score);
+
+  MoveList& moves = ply_data.moves;
+  std::array<int, kMaxMoves>& scores = ply_data.scores;
+  moves.clear();
+  generateMoves<MoveGenType::Captures>(position, moves);
+  thread.scoreMoves(moves, scores, Move {}, ply);
+
+  for (int i = 0; i < moves.size(); i++) {
+    pickMove(moves, scores, i);
+    Move move = moves[i];
+    // Futility: this capture can't raise the score near alpha
+    if (
+      search_params.qsearch_futility && !move.isPromotion() &&
+      stand_pat + captureGain(position, move) + kQSearchFutilityMargin <= alpha) {
+      continue;
+    }
+    if (!position.isLegal(move)) continue;
+    position.makeMove(move);
+    int score = -quiescence(thread, -beta, -alpha, ply + 1);
+    position.unmakeMove();
+    if (stop_flag.load(std::memory_order_relaxed)) return 0;
+
+    if (score <= best_score) continue;
+    best_score = score;
+    if (score <= alpha) continue;
+    alpha = score;
+    thread.updatePV(ply, move);
+    if (alpha >= beta) break;
+  }
+  return best_score;
+}
+
+// Solves for mate in 1, 2... moves up to limits.mate, so the first mate found is
+// the shortest. The solver's table is kept between the iterations.
+//
+// Without a mate the move comes from a shallow normal search, which still
+// returns the first legal move when the limits have already stopped the search.
+void Search::mateSearch(ThreadData& thread)
+{
+  if (!mate_search) mate_search = std::make_unique<MateSearch>();
+  mate_search->clear();
+  MateSearch::StopCheck stop_check = [this, &thread](uint64_t nodes) {
+    thread.nodes.store(nodes, std::memory_order_relaxed);
+    checkPonderhit();
+    if (time_limited && Clock::now() >= hard_deadline) stop();
+    if (limits.nodes && nodes >= limits.nodes) stop();
+    return stop_flag.load();
+  };
+  int max_moves = std::min(limits.mate, kMaxMateMoves);
+  for (int moves = 1; moves <= max_moves && !stop_flag; moves++) {
+    MateResult result = mate_search->solve(thread.position, moves, stop_check);
+    thread.nodes.store(mate_search->nodes(), std::memory_order_relaxed);
+    // Stopped also covers a proof without a PV
+    if (result.status == MateStatus::Stopped) break;
+    if (result.status == MateStatus::NoMate) continue;
+
+    // The PV may be cut short, the mate's length comes from the proof
+    RootMove root_move {result.pv[0]};
+    root_move.pv_length = static_cast<int>(result.pv.size());
+    std::copy(result.pv.begin(), result.pv.end(), root_move.pv.begin());
+    root_move.score = kMateScore - result.plies;
+    thread.root_moves.assign(1, root_move);
+    thread.sel_depth = result.plies;
+    thread.best_move = root_move.move;
+    thread.best_score = root_move.score;
+    reportIteration(thread, result.plies, 1);
+    return;
+  }
+  if (!stop_flag) output->send("info string no mate in " + std::to_string(limits.mate));
+  // Only the main thread is running, nothing else reads the limits
+  limits.depth = kMateFallbackDepth;
+  iterativeDeepening(thread);
+}
+
+void Search::checkLimits(ThreadData& thread)
+{
+  if (thread.id != 0 || thread.nodes.load(std::memory_order_relaxed) % kCheckInterval) {
+    return;
+  }
+  checkPonderhit();
+  if (time_limited && Clock::now() >= hard_deadline) stop();
+  if (limits.nodes && nodes() >= limits.nodes) stop();
+}
+
+// All lines of an iteration are sent as one info block, so rate limiting never
+// drops only some of them
+void Search::reportIteration(const ThreadData& thread, int depth, size_t multi_pv)
+{
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+    Clock::now() - limits.start_time);
+  uint64_t total_nodes = nodes();
+  uint64_t nps = total_nodes * 1000 / std::max<uint64_t>(elapsed.count(), 1);
+  std::string block;
+  for (size_t i = 0; i < multi_pv; i++) {
+    const RootMove& root_move = thread.root_moves[i];
+    if (i > 0) block += '\n';
+    block += "info depth " + std::to_string(depth);
+    block += " seldepth " + std::to_string(std::max(thread.sel_depth, depth));
+    block += " multipv " + std::to_string(i + 1);
+    block += " score " + scoreString(root_move.score);
+    block += " nodes " + std::to_string(total_nodes);
+    block += " nps " + std::to_string(nps);
+    block += " time " + std::to_string(elapsed.count());
+    block += " pv";
+    for (int ply = 0; ply < root_move.pv_length; ply++) {
+      block += " " + root_move.pv[ply].uci();
+    }
+  }
+  output->sendInfo(block);
+}
+
+} // namespace shepichess
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "hash_table.h"
+#include "mate_search.h"
+#include "move.h"
+#include "position.h"
+#include "thread_pool.h"
+#include "uci_output.h"
+
+namespace shepichess {
+
+constexpr int kMaxPly = 128;
+constexpr int kInfinity = 32000;
+constexpr int kMateScore = 31000;
+// Scores beyond this are mate scores
+constexpr int kMateBound = kMateScore - kMaxPly;
+
+struct SearchLimits {
+  using Clock = std::chrono::steady_clock;
+
+  // When the go command was received, all time limits count from here
+  Clock::time_point start_time;
+  // Remaining time and increment in milliseconds, indexed by Color
+  std::array<int64_t, 2> time {};
+  std::array<int64_t, 2> increment {};
+  int moves_to_go = 0;
+  int depth = 0;
+  uint64_t nodes = 0;
+  int64_t move_time = 0;
+  // Searches for a mate in at most this many moves with the mate solver instead
+  int mate = 0;
+  bool infinite = false;
+  // Searching the expected reply, time limits only apply after ponderhit
+  bool ponder = false;
+  std::vector<Move> search_moves;
+  // Number of best root moves to search and report each iteration
+  int multi_pv = 1;
+
+  // Resets all limits, keeping the search_moves allocation
+  void clear();
+};
+
+// Whether the calling thread is inside the node search (below an iteration's
+// root alphaBeta call), which must never allocate. For tests.
+bool inNodeSearch();
+
+// Selective search techniques. Each can be switched off through the engine's
+// options, to measure its effect on nodes to depth with bench.
+struct SearchParams {
+  bool null_move = true;
+  bool late_move_reductions = true;
+  bool reverse_futility = true;
+  bool razoring = true;
+  bool qsearch_futility = true;
+  bool delta_pruning = true;
+};
+
+// Iterative deepening alpha-beta search, run on every thread of the pool (lazy
+// SMP). Threads only share the hash table, the main thread (index 0) reports
+// progress and the best move.
+//
+// With multi_pv > 1 each iteration searches the root once per line, excluding
+// the moves already picked for earlier lines. The root move list is kept sorted
+// by score, so every line and the next iteration reuse the ordering (and the
+// hash table) of the previous ones.
+class Search {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  Search(ThreadPool& threads, HashTable& tt, UCIOutput& output);
+  ~Search();
+
+  Search(const Search&) = delete;
+  Search(Search&&) = delete;
+  Search& operator=(const Search&) = delete;
+  Search& operator=(Search&&) = delete;
+
+  // Starts searching root in the background, waiting for any previous search
+  void start(const Position& root, const SearchLimits& limits);
+  void stop();
+  void wait();
+  // A search is running and hasn't been stopped. go infinite and go ponder only
+  // end on stop, so waiting for them would block the caller until then.
+  [[nodiscard]] bool searching();
+  // The expected move was played: the ponder search continues as a normal search,
+  // with the time limits counting from now
+  void ponderhit();
+  // Waits for the current search, later searches report to output
+  void setOutput(UCIOutput& output);
+  // Waits for the current search, the parameters apply from the next one
+  void setParams(const SearchParams& params);
+  [[nodiscard]] const SearchParams& params() const { return search_params; }
+
+  // Time from limits.start_time until the main thread started the last search
+  [[nodiscard]] std::chrono::microseconds startLatency() const;
+  // Best move found by the last search, once it has finished
+  [[nodiscard]] Move bestMove() const;
+  // Score of the best move in centipawns from the side to move's point of view
+  [[nodiscard]] int score() const;
+  [[nodiscard]] uint64_t nodes() const;
+  // Bytes allocated for the search threads' data and the mate solver, not
+  // counting the hash table
+  [[nodiscard]] size_t memoryUsage() const;
+
+private:
+  struct ThreadData;
+
+  ThreadPool& threads;
+  HashTable& tt;
+  UCIOutput* output;
+  SearchLimits limits;
+  SearchParams search_params;
+  std::vector<std::unique_ptr<ThreadData>> thread_data;
+  std::atomic<bool> stop_flag {false};
+  std::atomic<bool> pondering {false};
+  // Only used by the main thread while searching
+  bool waiting_for_ponderhit = false;
+  Color root_color = Color::White;
+  std::atomic<int64_t> start_latency_us {0};
+  Clock::time_point soft_deadline;
+  Clock::time_point hard_deadline;
+  bool time_limited = false;
+  Move best_move;
+  int best_score = 0;
+  // Allocated by the first go mate
+  std::unique_ptr<MateSearch> mate_search;
+
+  void run(size_t thread_index);
+  void setupTimeLimits(Color us, Clock::time_point from);
+  void checkPonderhit();
+  Move ponderMove(ThreadData& thread);
+  void iterativeDeepening(ThreadData& thread);
+  void mateSearch(ThreadData& thread);
+  int alphaBeta(ThreadData& thread, int alpha, int beta, int depth, int ply);
+  int quiescence(ThreadData& thread, int alpha, int beta, int ply);
+  void checkLimits(ThreadData& thread);
+  void reportIteration(const ThreadData& thread, int depth, size_t multi_pv);
+};
+
+} // namespace shepichess
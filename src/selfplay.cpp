@@ -0,0 +1,558 @@
+#include "selfplay.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <sstream>
+#include <streambuf>
+#include <string_view>
+#include <thread>
+
+#include <spdlog/fmt/fmt.h>
+
+#include "bitboard.h"
+#include "engine.h"
+#include "logging.h"
+#include "movegen.h"
+#include "position.h"
+
+namespace shepichess {
+
+namespace {
+
+// Games are reported in batches, thousands of lines of progress aren't useful
+constexpr int kReportInterval = 10;
+
+// Discards the engines' UCI output
+class NullBuffer : public std::streambuf {
+protected:
+  int overflow(int c) override { return c; }
+  std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+};
+
+template<typename T>
+bool parseNumber(std::string_view text, T& value)
+{
+  const char* end = text.data() + text.size();
+  auto [ptr, error] = std::from_chars(text.data(), end, value);
+  return error == std::errc() && ptr == end;
+}
+
+// "name=value", the name may contain spaces
+bool parseOption(std::string_view text, std::pair<std::string, std::string>& option)
+{
+  size_t split = text.find('=');
+  if (split == std::string_view::npos || split == 0) return false;
+  option = {std::string(text.substr(0, split)), std::string(text.substr(split + 1))};
+  return true;
+}
+
+// "base+increment" in seconds, or just "base"
+bool parseTimeControl(std::string_view text, SelfPlayConfig& config)
+{
+  double base = 0.0, increment = 0.0;
+  size_t split = text.find('+');
+  if (!parseNumber(text.substr(0, split), base)) return false;
+  if (split != std::string_view::npos &&
+      !parseNumber(text.substr(split + 1), increment)) {
+    return false;
+  }
+  config.base_time = static_cast<int64_t>(base * 1000);
+  config.increment = static_cast<int64_t>(increment * 1000);
+  return config.base_time > 0;
+}
+
+bool parseSPRT(std::string_view text, SelfPlayConfig& config)
+{
+  size_t split = text.find(',');
+  if (split == std::string_view::npos) return false;
+  config.sprt = parseNumber(text.substr(0, split), config.elo0) &&
+                parseNumber(text.substr(split + 1), config.elo1) &&
+                config.elo0 < config.elo1;
+  return config.sprt;
+}
+
+// Expected score for an Elo difference
+double eloToScore(double elo)
+{
+  return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0));
+}
+
+// Neither side can ever mate: no pawns or major pieces and at most one minor
+bool isInsufficientMaterial(const Position& position)
+{
+  Bitboard majors_and_pawns = 0, minors = 0;
+  for (Color color : {Color::White, Color::Black}) {
+    majors_and_pawns |= position.piecesByType(color, PieceType::Pawn) |
+                        position.piecesByType(color, PieceType::Rook) |
+                        position.piecesByType(color, PieceType::Queen);
+    minors |= position.piecesByType(color, PieceType::Knight) |
+              position.piecesByType(color, PieceType::Bishop);
+  }
+  return !majors_and_pawns && bitboards::popcount(minors) <= 1;
+}
+
+// Position::isDraw stops at the first repetition, a game needs the third
+bool isThreefoldRepetition(const std::vector<HashKey>& keys, int move_count50)
+{
+  int end = std::min<int>(move_count50, static_cast<int>(keys.size()) - 1);
+  int repetitions = 1;
+  for (int i = 2; i <= end; i += 2) {
+    if (keys[keys.size() - 1 - i] == keys.back()) repetitions++;
+  }
+  return repetitions >= 3;
+}
+
+const char* resultString(GameResult result)
+{
+  switch (result) {
+  case GameResult::WhiteWins:
+    return "1-0";
+  case GameResult::BlackWins:
+    return "0-1";
+  default:
+    return "1/2-1/2";
+  }
+}
+
+GameResult winFor(Color color)
+{
+  return color == Color::White ? GameResult::WhiteWins : GameResult::BlackWins;
+}
+
+} // namespace
+
+SelfPlayConfig dataGenConfig()
+{
+  SelfPlayConfig config;
+  config.games = 10000;
+  unsigned cores = std::max(1U, std::thread::hardware_concurrency());
+  config.concurrency = static_cast<int>(cores);
+  config.depth = 8;
+  config.random_plies = 8;
+  config.seed = std::random_device()();
+  config.data = "shepichess.data";
+  return config;
+}
+
+bool parseSelfPlayArgs(const std::vector<std::string>& args, SelfPlayConfig& config)
+{
+  for (size_t i = 0; i < args.size(); i++) {
+    const std::string& name = args[i];
+    if (i + 1 == args.size()) {
+      SPDLOG_ERROR("Missing value for selfplay argument {}", name);
+      return false;
+    }
+    std::string_view value = args[++i];
+    bool valid = true;
+    if (name == "--games") {
+      valid = parseNumber(value, config.games) && config.games > 0;
+    } else if (name == "--concurrency") {
+      valid = parseNumber(value, config.concurrency) && config.concurrency > 0;
+    } else if (name == "--depth") {
+      valid = parseNumber(value, config.depth) && config.depth >= 0 &&
+              config.depth < kMaxPly;
+    } else if (name == "--nodes") {
+      valid = parseNumber(value, config.nodes);
+    } else if (name == "--movetime") {
+      valid = parseNumber(value, config.move_time);
+    } else if (name == "--tc") {
+      valid = parseTimeControl(value, config);
+    } else if (name == "--hash") {
+      valid = parseNumber(value, config.hash_size) && config.hash_size > 0 &&
+              config.hash_size <= kMaxHashSize;
+    } else if (name == "--openings") {
+      config.openings = value;
+    } else if (name == "--pgn") {
+      config.pgn = value;
+    } else if (name == "--data") {
+      config.data = value;
+    } else if (name == "--random-plies") {
+      valid = parseNumber(value, config.random_plies) && config.random_plies >= 0;
+    } else if (name == "--seed") {
+      valid = parseNumber(value, config.seed);
+    } else if (name == "--option1" || name == "--option2") {
+      std::pair<std::string, std::string> option;
+      valid = parseOption(value, option);
+      config.options[name == "--option1" ? 0 : 1].push_back(std::move(option));
+    } else if (name == "--sprt") {
+      valid = parseSPRT(value, config);
+    } else if (name == "--alpha") {
+      valid = parseNumber(value, config.alpha) && config.alpha > 0 && config.alpha < 1;
+    } else if (name == "--beta") {
+      valid = parseNumber(value, config.beta) && config.beta > 0 && config.beta < 1;
+    } else {
+      SPDLOG_ERROR("Unknown selfplay argument {}", name);
+      return false;
+    }
+    if (!valid) {
+      SPDLOG_ERROR("Invalid value {} for selfplay argument {}", value, name);
+      return false;
+    }
+  }
+  if (!config.depth && !config.nodes && !config.move_time && !config.base_time) {
+    SPDLOG_ERROR("Selfplay needs --depth, --nodes, --movetime or --tc");
+    return false;
+  }
+  return true;
+}
+
+std::pair<double, double> sprtBounds(const SelfPlayConfig& config)
+{
+  return {
+    std::log(config.beta / (1 - config.alpha)),
+    std::log((1 - config.beta) / config.alpha)};
+}
+
+// Each game scores 1, 1/2 or 0, whose mean and variance are estimated from the
+// results so far. The LLR of two normal distributions with the same variance and
+// means s0 and s1 is n (s1 - s0) (2s - s0 - s1) / 2var.
+double sprtLLR(const MatchScore& score, double elo0, double elo1)
+{
+  if (!score.games()) return 0.0;
+  double games = score.games();
+  double wins = score.wins / games, draws = score.draws / games;
+  double losses = score.losses / games;
+  double mean = wins + draws / 2;
+  double variance = wins * std::pow(1 - mean, 2) + draws * std::pow(0.5 - mean, 2) +
+                    losses * std::pow(mean, 2);
+  // Only all draws (or all wins or losses) leave nothing to estimate the spread
+  if (variance <= 0.0) return 0.0;
+  double s0 = eloToScore(elo0), s1 = eloToScore(elo1);
+  return games * (s1 - s0) * (2 * mean - s0 - s1) / (2 * variance);
+}
+
+double eloDifference(const MatchScore& score)
+{
+  if (!score.games()) return 0.0;
+  double mean = (score.wins + score.draws / 2.0) / score.games();
+  mean = std::clamp(mean, 1e-3, 1 - 1e-3);
+  return -400.0 * std::log10(1 / mean - 1);
+}
+
+SelfPlay::SelfPlay(SelfPlayConfig config, std::ostream& out)
+  : config(std::move(config)), out(out)
+{
+  bitboards::init();
+}
+
+bool SelfPlay::loadOpenings()
+{
+  openings.clear();
+  if (config.openings.empty()) {
+    openings.push_back(kStartFen);
+    return true;
+  }
+  std::ifstream file(config.openings);
+  if (!file) {
+    SPDLOG_ERROR("Failed to open openings file {}", config.openings);
+    return false;
+  }
+  Position position;
+  std::string line;
+  while (std::getline(file, line)) {
+    // EPD has no move counters, anything after the first four fields is opcodes
+    std::istringstream fields(line);
+    std::string board, side, castling, enpassant;
+    if (!(fields >> board >> side >> castling >> enpassant)) continue;
+    std::string fen = board + ' ' + side + ' ' + castling + ' ' + enpassant + " 0 1";
+    if (!position.setFen(fen)) {
+      SPDLOG_WARN("Skipping invalid opening {}", line);
+      continue;
+    }
+    openings.push_back(fen);
+  }
+  if (openings.empty()) {
+    SPDLOG_ERROR("No openings in {}", config.openings);
+    return false;
+  }
+  return true;
+}
+
+bool SelfPlay::run()
+{
+  if (!loadOpenings()) return false;
+  if (!config.pgn.empty()) {
+    pgn.open(config.pgn, std::ios::app);
+    if (!pgn) {
+      SPDLOG_ERROR("Failed to open pgn file {}", config.pgn);
+      return false;
+    }
+  }
+  if (!config.data.empty() && !data_file.open(config.data)) return false;
+  // Check the options once up front on throwaway engines, rather than having
+  // every worker fail on them
+  for (auto&& options : config.options) {
+    NullBuffer buffer;
+    std::ostream discard(&buffer);
+    Engine engine(discard, 1, false);
+    for (auto&& [name, value] : options) {
+      if (!engine.setOption(name, value)) {
+        SPDLOG_ERROR("Invalid option {}={}", name, value);
+        return false;
+      }
+    }
+  }
+
+  config.games += config.games % 2;
+  next_game = 0;
+  stop_flag = false;
+  worker_failed = false;
+  match_score = {};
+  positions = 0;
+  start_time = Clock::now();
+  std::vector<std::thread> workers;
+  for (int i = 0; i < config.concurrency; i++) {
+    workers.emplace_back([this, i] { worker(config.seed + i); });
+  }
+  for (auto&& worker : workers) worker.join();
+  report(true);
+  if (pgn.is_open()) pgn.close();
+  data_file.close();
+  return !worker_failed;
+}
+
+void SelfPlay::worker(uint64_t seed)
+{
+  NullBuffer buffer;
+  std::ostream discard(&buffer);
+  // Engines are created once per worker and only cleared between games
+  Engine first(discard, config.hash_size, false);
+  Engine second(discard, config.hash_size, false);
+  std::array<Engine*, 2> engines {&first, &second};
+  for (int i = 0; i < 2; i++) {
+    for (auto&& [name, value] : config.options[i]) {
+      if (!engines[i]->setOption(name, value)) {
+        SPDLOG_ERROR("Invalid value {} for option {}", value, name);
+        worker_failed = true;
+        stop_flag = true;
+        return;
+      }
+    }
+  }
+
+  // Positions are buffered per thread and written without taking the lock
+  TrainingDataWriter writer(data_file);
+  std::mt19937_64 rng(seed);
+  int game;
+  while (!stop_flag && (game = next_game.fetch_add(1)) < config.games) {
+    const std::string& fen = openings[(game / 2) % openings.size()];
+    bool swapped = game % 2;
+    first.newGame();
+    second.newGame();
+    GameRecord record = swapped ? playGame({&second, &first}, fen, rng)
+                                : playGame({&first, &second}, fen, rng);
+    for (auto&& position : record.positions) writer.push(position);
+    finishGame(game, record, swapped);
+  }
+}
+
+GameRecord SelfPlay::playGame(
+  std::array<Engine*, 2> players, const std::string& fen, std::mt19937_64& rng)
+{
+  GameRecord record;
+  record.fen = fen;
+  Position position;
+  position.setFen(fen);
+  std::vector<HashKey> keys {position.zobrist()};
+  std::array<int64_t, 2> clocks {config.base_time, config.base_time};
+  int draw_plies = 0, resign_plies = 0;
+  bool white_ahead = false;
+  MoveList moves;
+
+  for (int ply = 0; ply < config.random_plies; ply++) {
+    moves.clear();
+    generateLegalMoves(position, moves);
+    if (moves.empty()) break;
+    std::uniform_int_distribution<int> pick(0, moves.size() - 1);
+    Move move = moves[pick(rng)];
+    record.moves.push_back(moveToSAN(position, move));
+    position.makeMove(move);
+    keys.push_back(position.zobrist());
+  }
+
+  SearchLimits limits;
+  while (true) {
+    Color us = position.sideToMove();
+    moves.clear();
+    generateLegalMoves(position, moves);
+    if (moves.empty()) {
+      record.result = position.inCheck() ? winFor(~us) : GameResult::Draw;
+      record.termination = position.inCheck() ? "checkmate" : "stalemate";
+      break;
+    }
+    if (position.state().move_count50 >= 100) {
+      record.termination = "fifty move rule";
+      break;
+    }
+    if (isThreefoldRepetition(keys, position.state().move_count50)) {
+      record.termination = "threefold repetition";
+      break;
+    }
+    if (isInsufficientMaterial(position)) {
+      record.termination = "insufficient material";
+      break;
+    }
+    if (static_cast<int>(record.moves.size()) >= config.max_plies) {
+      record.termination = "move limit";
+      break;
+    }
+
+    limits.clear();
+    limits.depth = config.depth;
+    limits.nodes = config.nodes;
+    limits.move_time = config.move_time;
+    if (config.base_time) {
+      limits.time = clocks;
+      limits.increment = {config.increment, config.increment};
+    }
+    limits.start_time = Clock::now();
+    Engine& engine = *players[index(us)];
+    engine.go(position, limits);
+    engine.wait();
+
+    if (config.base_time) {
+      auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        Clock::now() - limits.start_time);
+      clocks[index(us)] -= elapsed.count();
+      if (clocks[index(us)] < 0) {
+        record.result = winFor(~us);
+        record.termination = "time forfeit";
+        break;
+      }
+      clocks[index(us)] += config.increment;
+    }
+    Move move = engine.bestMove();
+    if (!moves.contains(move)) {
+      record.result = winFor(~us);
+      record.termination = "illegal move " + move.uci();
+      break;
+    }
+
+    // Scores of consecutive plies come from alternating engines, so counting
+    // plies in a row means both engines agree
+    int score = engine.score();
+    // Only quiet positions with a non-mate score are useful for eval tuning
+    if (data_file.isOpen() && !position.inCheck() && !move.isCapture() &&
+        !move.isPromotion() && std::abs(score) < kMateBound) {
+      int white_score = us == Color::White ? score : -score;
+      record.positions.push_back(PackedPosition::pack(position, white_score));
+    }
+    draw_plies = std::abs(score) <= config.draw_score ? draw_plies + 1 : 0;
+    bool white_winning = (us == Color::White) == (score > 0);
+    if (std::abs(score) < config.resign_score) {
+      resign_plies = 0;
+    } else {
+      bool agrees = resign_plies && white_winning == white_ahead;
+      resign_plies = agrees ? resign_plies + 1 : 1;
+      white_ahead = white_winning;
+    }
+
+    record.moves.push_back(moveToSAN(position, move));
+    position.makeMove(move);
+    keys.push_back(position.zobrist());
+
+    if (static_cast<int>(record.moves.size()) >= config.draw_start &&
+        draw_plies >= config.draw_plies) {
+      record.termination = "adjudication";
+      break;
+    }
+    if (resign_plies >= config.resign_plies) {
+      record.result = white_ahead ? GameResult::WhiteWins : GameResult::BlackWins;
+      record.termination = "adjudication";
+      break;
+    }
+  }
+
+  constexpr PackedPosition::Result kResults[] = {
+    PackedPosition::WhiteWins, PackedPosition::BlackWins, PackedPosition::Draw};
+  for (auto&& packed : record.positions) {
+    packed.result = kResults[static_cast<int>(record.result)];
+  }
+  return record;
+}
+
+void SelfPlay::finishGame(int game, const GameRecord& record, bool swapped)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  // Scores are kept for the second engine
+  GameResult second_wins = swapped ? GameResult::WhiteWins : GameResult::BlackWins;
+  if (record.result == GameResult::Draw) {
+    match_score.draws++;
+  } else if (record.result == second_wins) {
+    match_score.wins++;
+  } else {
+    match_score.losses++;
+  }
+  positions += record.positions.size();
+
+  if (pgn.is_open()) {
+    std::array<const char*, 2> names {"shepichess-1", "shepichess-2"};
+    if (swapped) std::swap(names[0], names[1]);
+    pgn << "[Event \"selfplay\"]\n[Site \"?\"]\n[Round \"" << game + 1 << "\"]\n"
+        << "[White \"" << names[0] << "\"]\n[Black \"" << names[1] << "\"]\n"
+        << "[Result \"" << resultString(record.result) << "\"]\n";
+    if (record.fen != kStartFen) {
+      pgn << "[FEN \"" << record.fen << "\"]\n[SetUp \"1\"]\n";
+    }
+    pgn << "[Termination \"" << record.termination << "\"]\n\n";
+    Position position;
+    position.setFen(record.fen);
+    int move_number = position.moveNumber();
+    bool white = position.sideToMove() == Color::White;
+    std::string line;
+    auto append = [&](const std::string& token) {
+      if (line.size() + token.size() >= 80) {
+        pgn << line << '\n';
+        line.clear();
+      }
+      line += line.empty() ? token : ' ' + token;
+    };
+    for (size_t i = 0; i < record.moves.size(); i++) {
+      if (white) {
+        append(std::to_string(move_number) + '.');
+      } else if (i == 0) {
+        append(std::to_string(move_number) + "...");
+      }
+      append(record.moves[i]);
+      move_number += !white;
+      white = !white;
+    }
+    append(resultString(record.result));
+    pgn << line << "\n\n";
+  }
+
+  if (match_score.games() % kReportInterval == 0) report(false);
+  if (config.sprt) {
+    double llr = sprtLLR(match_score, config.elo0, config.elo1);
+    auto [lower, upper] = sprtBounds(config);
+    if (llr <= lower || llr >= upper) stop_flag = true;
+  }
+}
+
+// Called with lock held, or after the workers have finished
+void SelfPlay::report(bool final)
+{
+  auto elapsed = std::chrono::duration<double>(Clock::now() - start_time);
+  double games_per_second = match_score.games() / std::max(elapsed.count(), 1e-3);
+  out << fmt::format(
+    "{} {}: +{} -{} ={}, elo {:.1f}, {:.2f} games/s",
+    final ? "Finished" : "Games",
+    match_score.games(),
+    match_score.wins,
+    match_score.losses,
+    match_score.draws,
+    eloDifference(match_score),
+    games_per_second);
+  if (data_file.isOpen()) out << fmt::format(", {} positions", positions);
+  if (config.sprt) {
+    double llr = sprtLLR(match_score, config.elo0, config.elo1);
+    auto [lower, upper] = sprtBounds(config);
+    out << fmt::format(", llr {:.2f} ({:.2f}, {:.2f})", llr, lower, upper);
+    if (final && llr >= upper) out << ", H1 accepted";
+    if (final && llr <= lower) out << ", H0 accepted";
+  }
+  out << std::endl;
+}
+
+} // namespace shepichess
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "training_data.h"
+
+namespace shepichess {
+
+class Engine;
+
+// Settings for a selfplay match between two engines that differ only in their
+// UCI options
+struct SelfPlayConfig {
+  // Rounded up to an even number, every opening is played with both colors
+  int games = 100;
+  int concurrency = 1;
+  // Per move limits, the search stops at whichever is reached first
+  int depth = 0;
+  uint64_t nodes = 0;
+  int64_t move_time = 0;
+  // Clock time and increment in milliseconds, running out of time loses
+  int64_t base_time = 0;
+  int64_t increment = 0;
+  // Hash table size of each engine in MB
+  int64_t hash_size = 4;
+  // EPD file with one opening per line, the start position if empty
+  std::string openings;
+  std::string pgn;
+  // Option name and value pairs for each engine
+  std::array<std::vector<std::pair<std::string, std::string>>, 2> options;
+  // Random moves played after the opening before the engines take over, so games
+  // from the same opening differ
+  int random_plies = 0;
+  uint64_t seed = 0;
+  // Training data file, quiet positions and the engine's score are written there
+  // labelled with the result of the game
+  std::string data;
+
+  bool sprt = false;
+  double elo0 = 0.0;
+  double elo1 = 5.0;
+  double alpha = 0.05;
+  double beta = 0.05;
+
+  // A game is drawn once both engines report a score within draw_score for
+  // draw_plies plies in a row after draw_start plies, and resigned once the
+  // scores agree that one side is resign_score behind for resign_plies plies
+  int draw_start = 80;
+  int draw_score = 10;
+  int draw_plies = 8;
+  int resign_score = 1000;
+  int resign_plies = 4;
+  int max_plies = 500;
+};
+
+// Defaults of the datagen command: fixed depth games with random openings on all
+// cores, written to a training data file
+SelfPlayConfig dataGenConfig();
+
+// Parses "--games 1000 --nodes 5000 --option1 Hash=8 --sprt 0,5 ...", returns
+// false (after logging the error) for unknown or invalid arguments
+bool parseSelfPlayArgs(const std::vector<std::string>& args, SelfPlayConfig& config);
+
+// Wins, losses and draws of the second engine against the first
+struct MatchScore {
+  int wins = 0;
+  int losses = 0;
+  int draws = 0;
+
+  [[nodiscard]] int games() const { return wins + losses + draws; }
+};
+
+// Log likelihood ratio bounds for accepting H0 and H1
+std::pair<double, double> sprtBounds(const SelfPlayConfig& config);
+// Log likelihood ratio of elo1 against elo0 (logistic Elo), using the normal
+// approximation of the trinomial score distribution
+double sprtLLR(const MatchScore& score, double elo0, double elo1);
+// Elo difference matching the score of the match
+double eloDifference(const MatchScore& score);
+
+enum class GameResult { WhiteWins, BlackWins, Draw };
+
+struct GameRecord {
+  std::string fen;
+  std::vector<std::string> moves;
+  GameResult result = GameResult::Draw;
+  std::string termination;
+  std::vector<PackedPosition> positions;
+};
+
+// Runs a match on config.concurrency threads. Each thread owns one engine per
+// side (with a single search thread each) and plays games from the shared
+// openings until all are played or the SPRT finishes. Progress is printed to
+// out, the games are written to config.pgn and training positions to
+// config.data.
+class SelfPlay {
+public:
+  SelfPlay(SelfPlayConfig config, std::ostream& out);
+  ~SelfPlay() = default;
+
+  SelfPlay(const SelfPlay&) = delete;
+  SelfPlay(SelfPlay&&) = delete;
+  SelfPlay& operator=(const SelfPlay&) = delete;
+  SelfPlay& operator=(SelfPlay&&) = delete;
+
+  // Returns false if the openings or an output file can't be opened, an option
+  // is invalid or a worker couldn't set up its engines
+  bool run();
+  [[nodiscard]] MatchScore score() const { return match_score; }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  SelfPlayConfig config;
+  std::ostream& out;
+  std::vector<std::string> openings;
+  std::ofstream pgn;
+  TrainingDataFile data_file;
+  uint64_t positions = 0;
+  std::atomic<int> next_game {0};
+  std::atomic<bool> stop_flag {false};
+  std::atomic<bool> worker_failed {false};
+  std::mutex lock;
+  MatchScore match_score;
+  Clock::time_point start_time;
+
+  bool loadOpenings();
+  void worker(uint64_t seed);
+  GameRecord playGame(
+    std::array<Engine*, 2> players, const std::string& fen, std::mt19937_64& rng);
+  // Records a game played by engine 0 as white (or black if swapped)
+  void finishGame(int game, const GameRecord& record, bool swapped);
+  void report(bool final);
+};
+
+} // namespace shepichess
@@ -0,0 +1,540 @@
+#include "server.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+
+#if !defined(_WIN32)
+#  include <csignal>
+#  include <poll.h>
+#  include <pthread.h>
+#  include <sys/socket.h>
+#  include <sys/stat.h>
+#  include <sys/time.h>
+#  include <sys/un.h>
+#  include <unistd.h>
+#endif
+
+#include "bitboard.h"
+#include "cpu.h"
+#include "logging.h"
+#include "movegen.h"
+#include "position.h"
+#include "search.h"
+#include "thread_pool.h"
+#include "tracing.h"
+#include "uci_application.h"
+#include "uci_config.h"
+#include "uci_output.h"
+#include "uci_tokenizer.h"
+
+namespace shepichess {
+
+namespace {
+
+template<typename T>
+bool parseNumber(std::string_view text, T& value)
+{
+  const char* end = text.data() + text.size();
+  auto [ptr, error] = std::from_chars(text.data(), end, value);
+  return error == std::errc() && ptr == end;
+}
+
+} // namespace
+
+bool parseServerArgs(const std::vector<std::string>& args, ServerConfig& config)
+{
+  for (size_t i = 0; i < args.size(); i++) {
+    const std::string& name = args[i];
+    if (i + 1 == args.size()) {
+      SPDLOG_ERROR("Missing value for server argument {}", name);
+      return false;
+    }
+    std::string_view value = args[++i];
+    bool valid = true;
+    if (name == "--socket") {
+      config.socket_path = value;
+    } else if (name == "--workers") {
+      valid = parseNumber(value, config.workers) && config.workers > 0;
+    } else if (name == "--sessions") {
+      valid = parseNumber(value, config.max_sessions) && config.max_sessions > 0;
+    } else if (name == "--hash") {
+      valid = parseNumber(value, config.hash_size) && config.hash_size > 0 &&
+              config.hash_size <= kMaxHashSize;
+    } else if (name == "--nodes") {
+      valid = parseNumber(value, config.max_nodes);
+    } else if (name == "--movetime") {
+      valid = parseNumber(value, config.max_time) && config.max_time >= 0;
+    } else {
+      SPDLOG_ERROR("Unknown server argument {}", name);
+      return false;
+    }
+    if (!valid) {
+      SPDLOG_ERROR("Invalid value {} for server argument {}", value, name);
+      return false;
+    }
+  }
+  if (config.socket_path.empty()) {
+    SPDLOG_ERROR("The server needs a --socket path to listen on");
+    return false;
+  }
+  return true;
+}
+
+#if defined(_WIN32)
+
+struct AnalysisServer::Session {};
+struct AnalysisServer::Worker {};
+
+AnalysisServer::AnalysisServer(ServerConfig config)
+  : config(std::move(config)), tt(static_cast<size_t>(this->config.hash_size))
+{
+}
+
+AnalysisServer::~AnalysisServer() = default;
+
+bool AnalysisServer::start()
+{
+  SPDLOG_ERROR("The analysis server needs Unix domain sockets");
+  return false;
+}
+
+void AnalysisServer::stop() {}
+
+bool AnalysisServer::run()
+{
+  return start();
+}
+
+#else
+
+namespace {
+
+#  if defined(MSG_NOSIGNAL)
+// A client that disconnects mid-search must not kill the server with SIGPIPE
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#  else
+constexpr int kSendFlags = 0;
+#  endif
+// Clients that stop reading would otherwise block a worker in send forever
+constexpr int kSendTimeoutSeconds = 10;
+constexpr int kListenBacklog = 64;
+
+// Buffered reads and writes on a connected socket. The get and put areas are
+// separate, so one thread can read while another writes.
+class SocketBuffer : public std::streambuf {
+public:
+  explicit SocketBuffer(int fd) : fd(fd)
+  {
+    setg(input.data(), input.data(), input.data());
+    setp(output.data(), output.data() + output.size());
+  }
+
+protected:
+  int_type underflow() override
+  {
+    ssize_t received = 0;
+    do {
+      received = ::recv(fd, input.data(), input.size(), 0);
+    } while (received < 0 && errno == EINTR);
+    if (received <= 0) return traits_type::eof();
+    setg(input.data(), input.data(), input.data() + received);
+    return traits_type::to_int_type(input[0]);
+  }
+
+  int_type overflow(int_type c) override
+  {
+    if (!sendOutput()) return traits_type::eof();
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      *pptr() = traits_type::to_char_type(c);
+      pbump(1);
+    }
+    return traits_type::not_eof(c);
+  }
+
+  int sync() override { return sendOutput() ? 0 : -1; }
+
+private:
+  int fd;
+  std::array<char, 4096> input;
+  std::array<char, 4096> output;
+
+  // The buffer is emptied even if sending fails, the client is gone by then
+  bool sendOutput()
+  {
+    const char* data = pbase();
+    bool sent_all = true;
+    while (data < pptr()) {
+      ssize_t sent = ::send(fd, data, static_cast<size_t>(pptr() - data), kSendFlags);
+      if (sent < 0 && errno == EINTR) continue;
+      if (sent <= 0) {
+        sent_all = false;
+        break;
+      }
+      data += sent;
+    }
+    setp(output.data(), output.data() + output.size());
+    return sent_all;
+  }
+};
+
+} // namespace
+
+struct AnalysisServer::Session {
+  Session(int fd, int id)
+    : fd(fd), id(id), buffer(fd), in(&buffer), out(&buffer), output(out)
+  {
+    config.addOption(UCIOption::spin("MultiPV", 1, 1, kMaxMoves));
+  }
+  ~Session() { ::close(fd); }
+
+  Session(const Session&) = delete;
+  Session(Session&&) = delete;
+  Session& operator=(const Session&) = delete;
+  Session& operator=(Session&&) = delete;
+
+  int fd;
+  int id;
+  SocketBuffer buffer;
+  // Only the session thread reads, everything written goes through output
+  std::istream in;
+  std::ostream out;
+  UCIOutput output;
+  UCIConfig config;
+  Position position;
+  // Only changed while no search for the session is queued or running
+  SearchLimits limits;
+  // Guarded by the server lock
+  bool searching = false;
+  bool stop_requested = false;
+  Worker* worker = nullptr;
+  std::thread thread;
+  std::atomic<bool> finished {false};
+};
+
+// Searches start with the session's output, the idle one is never written to
+struct AnalysisServer::Worker {
+  explicit Worker(HashTable& tt)
+    : threads(1, false), search(threads, tt, idle_output)
+  {
+  }
+
+  ThreadPool threads;
+  std::ostream discard {nullptr};
+  UCIOutput idle_output {discard};
+  Search search;
+  std::thread thread;
+};
+
+AnalysisServer::AnalysisServer(ServerConfig config)
+  : config(std::move(config)), tt(static_cast<size_t>(this->config.hash_size))
+{
+  bitboards::init();
+}
+
+AnalysisServer::~AnalysisServer()
+{
+  stop();
+}
+
+bool AnalysisServer::start()
+{
+  sockaddr_un address {};
+  address.sun_family = AF_UNIX;
+  const std::string& path = config.socket_path;
+  if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+    SPDLOG_ERROR("Invalid server socket path \"{}\"", path);
+    return false;
+  }
+  std::copy(path.begin(), path.end(), address.sun_path);
+  // A socket left behind by a server that didn't shut down cleanly
+  struct stat file_stat {};
+  if (::stat(path.c_str(), &file_stat) == 0 && S_ISSOCK(file_stat.st_mode)) {
+    ::unlink(path.c_str());
+  }
+
+  listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd < 0 ||
+      ::bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+      ::listen(listen_fd, kListenBacklog) != 0 || ::pipe(wake_pipe.data()) != 0) {
+    SPDLOG_ERROR("Failed to listen on \"{}\"", path);
+    if (listen_fd >= 0) ::close(listen_fd);
+    listen_fd = -1;
+    return false;
+  }
+
+  for (int i = 0; i < config.workers; i++) {
+    Worker& worker = *workers.emplace_back(std::make_unique<Worker>(tt));
+    worker.thread = std::thread([this, i, &worker]() {
+      setTraceThreadName("server worker " + std::to_string(i));
+      workerLoop(worker);
+    });
+  }
+  accept_thread = std::thread([this]() { acceptLoop(); });
+  SPDLOG_INFO(
+    "Listening on \"{}\" with {} workers and {} MB hash",
+    path,
+    config.workers,
+    config.hash_size);
+  return true;
+}
+
+void AnalysisServer::stop()
+{
+  if (listen_fd < 0) return;
+  char wake = 0;
+  while (::write(wake_pipe[1], &wake, 1) < 0 && errno == EINTR) {}
+  accept_thread.join();
+  reapSessions(true);
+  {
+    std::scoped_lock stop_lock(lock);
+    quit = true;
+  }
+  queue_cv.notify_all();
+  for (auto&& worker : workers) worker->thread.join();
+  workers.clear();
+  quit = false;
+
+  ::close(listen_fd);
+  ::close(wake_pipe[0]);
+  ::close(wake_pipe[1]);
+  listen_fd = -1;
+  wake_pipe = {-1, -1};
+  ::unlink(config.socket_path.c_str());
+  SPDLOG_INFO("Stopped listening on \"{}\"", config.socket_path);
+}
+
+// Signals are blocked before any thread starts so they all inherit the mask and
+// only sigwait receives them
+bool AnalysisServer::run()
+{
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+  if (!start()) return false;
+  int signal = 0;
+  sigwait(&signals, &signal);
+  SPDLOG_INFO("Received signal {}, shutting down", signal);
+  stop();
+  return true;
+}
+
+void AnalysisServer::acceptLoop()
+{
+  setTraceThreadName("server");
+  std::array<pollfd, 2> fds {{{listen_fd, POLLIN, 0}, {wake_pipe[0], POLLIN, 0}}};
+  int next_id = 1;
+  while (true) {
+    if (::poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR) continue;
+      SPDLOG_ERROR("Failed to wait for server connections");
+      return;
+    }
+    if (fds[1].revents) return;
+    // accept would keep failing and the loop spin
+    if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+      SPDLOG_ERROR("Server socket failed, no longer accepting connections");
+      return;
+    }
+    int fd = ::accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) continue;
+    timeval timeout {kSendTimeoutSeconds, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+#  if defined(SO_NOSIGPIPE)
+    int no_sigpipe = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &no_sigpipe, sizeof(no_sigpipe));
+#  endif
+    reapSessions(false);
+    if (sessions.size() >= static_cast<size_t>(config.max_sessions)) {
+      rejectSession(fd);
+      continue;
+    }
+    Session& session = *sessions.emplace_back(std::make_unique<Session>(fd, next_id++));
+    session.thread = std::thread([this, &session]() {
+      setTraceThreadName("session " + std::to_string(session.id));
+      sessionLoop(session);
+    });
+    SPDLOG_INFO("Session {} connected, {} open", session.id, sessions.size());
+  }
+}
+
+// The send timeout is set, a client that doesn't read can't block the accept loop
+void AnalysisServer::rejectSession(int fd)
+{
+  SPDLOG_WARN("Rejected a connection, {} sessions open", sessions.size());
+  std::string_view reply = "info string too many sessions, try again later\n";
+  ::send(fd, reply.data(), reply.size(), kSendFlags);
+  ::close(fd);
+}
+
+void AnalysisServer::sessionLoop(Session& session)
+{
+  std::string line;
+  while (true) {
+    // Replies are buffered, make sure the client has them before blocking
+    session.output.flush();
+    if (!std::getline(session.in, line)) break;
+    SPDLOG_INFO("Session {} INPUT: \"{}\"", session.id, line);
+    TraceZone zone("command", line);
+    UCITokenizer tokens {line};
+    std::string_view command = tokens.next();
+    std::string_view args = tokens.rest();
+
+    if (command == "quit") {
+      break;
+    } else if (command == "uci") {
+      std::string cpu {cpuLevelName(cpuLevel())};
+      session.output.send("id name " + kEngineName + " (" + cpu + ")");
+      session.output.send("id author " + kEngineAuthor);
+      for (auto&& option : session.config.getAvailableOptions()) {
+        session.output.send("option " + option.uciString());
+      }
+      session.output.send("uciok");
+    } else if (command == "isready") {
+      session.output.send("readyok");
+    } else if (command == "ucinewgame") {
+      // Other sessions are still using the shared hash table
+    } else if (command == "setoption") {
+      UCITokenizer option {args};
+      std::string_view name = option.next() == "name" ? option.until("value") : "";
+      std::string_view value = option.next() == "value" ? option.rest() : "";
+      waitForSearch(session);
+      if (!session.config.setOption(std::string(name), std::string(value))) {
+        SPDLOG_ERROR("Session {}: invalid option \"{}\"", session.id, args);
+      }
+    } else if (command == "position") {
+      waitForSearch(session);
+      // A command that fails to parse leaves the position as it was
+      Position position = session.position;
+      if (parsePosition(args, position)) {
+        session.position = position;
+      } else {
+        session.output.send(
+          "info string invalid position command, keeping the previous one");
+      }
+    } else if (command == "go") {
+      startSearch(session, args);
+    } else if (command == "stop") {
+      stopSearch(session);
+    } else {
+      SPDLOG_ERROR("Session {}: unrecognized command \"{}\"", session.id, line);
+    }
+  }
+  endSession(session);
+}
+
+void AnalysisServer::workerLoop(Worker& worker)
+{
+  std::unique_lock queue_lock(lock);
+  while (true) {
+    queue_cv.wait(queue_lock, [this]() { return quit || !queue.empty(); });
+    if (quit) return;
+    Session& session = *queue.front();
+    queue.pop_front();
+    session.limits.start_time = SearchLimits::Clock::now();
+    worker.search.setOutput(session.output);
+    worker.search.start(session.position, session.limits);
+    if (session.stop_requested) worker.search.stop();
+    session.worker = &worker;
+
+    queue_lock.unlock();
+    worker.search.wait();
+    queue_lock.lock();
+    session.worker = nullptr;
+    session.searching = false;
+    done_cv.notify_all();
+  }
+}
+
+// Requests can't search longer than the server allows, and infinite searches
+// end at the caps instead of waiting for stop
+void AnalysisServer::startSearch(Session& session, std::string_view args)
+{
+  waitForSearch(session);
+  SearchLimits& limits = session.limits;
+  parseGoLimits(args, session.position, limits);
+  limits.multi_pv = static_cast<int>(session.config.getOption("MultiPV")->asInt());
+  limits.ponder = false;
+  if (config.max_nodes && (!limits.nodes || limits.nodes > config.max_nodes)) {
+    limits.nodes = config.max_nodes;
+  }
+  if (config.max_time) {
+    int64_t& clock = limits.time[index(session.position.sideToMove())];
+    if (limits.move_time > 0 || clock <= 0) {
+      if (!limits.move_time || limits.move_time > config.max_time) {
+        limits.move_time = config.max_time;
+      }
+    } else {
+      // The time manager never uses more than the remaining clock
+      clock = std::min(clock, config.max_time);
+    }
+  }
+  if (config.max_nodes || config.max_time) limits.infinite = false;
+
+  {
+    std::scoped_lock queue_lock(lock);
+    session.searching = true;
+    session.stop_requested = false;
+    queue.push_back(&session);
+  }
+  queue_cv.notify_one();
+}
+
+// A queued search is still started, so the client gets the bestmove it expects
+void AnalysisServer::stopSearch(Session& session)
+{
+  std::scoped_lock stop_lock(lock);
+  session.stop_requested = true;
+  if (session.worker) session.worker->search.stop();
+}
+
+void AnalysisServer::waitForSearch(Session& session)
+{
+  std::unique_lock wait_lock(lock);
+  done_cv.wait(wait_lock, [&session]() { return !session.searching; });
+}
+
+// Nobody is left to read the bestmove, so a queued search is dropped
+void AnalysisServer::endSession(Session& session)
+{
+  {
+    std::unique_lock end_lock(lock);
+    auto queued = std::find(queue.begin(), queue.end(), &session);
+    if (queued != queue.end()) {
+      queue.erase(queued);
+      session.searching = false;
+    }
+    if (session.worker) session.worker->search.stop();
+    done_cv.wait(end_lock, [&session]() { return !session.searching; });
+  }
+  session.output.flush();
+  SPDLOG_INFO("Session {} disconnected", session.id);
+  // Marked first, so a client reconnecting right after the disconnect gets the slot
+  session.finished = true;
+  ::shutdown(session.fd, SHUT_RDWR);
+}
+
+// Sessions are joined and freed by the accept thread, or all at once on stop
+void AnalysisServer::reapSessions(bool all)
+{
+  for (auto it = sessions.begin(); it != sessions.end();) {
+    Session& session = **it;
+    if (all) ::shutdown(session.fd, SHUT_RDWR);
+    if (!all && !session.finished) {
+      ++it;
+      continue;
+    }
+    session.thread.join();
+    it = sessions.erase(it);
+  }
+}
+
+#endif
+
+} // namespace shepichess
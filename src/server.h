@@ -0,0 +1,102 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "hash_table.h"
+
+namespace shepichess {
+
+constexpr int64_t kDefaultServerHashSize = 256;
+constexpr int kDefaultServerSessions = 64;
+
+struct ServerConfig {
+  std::string socket_path;
+  // Searches running at once, further requests wait in a queue
+  int workers = 1;
+  // Connected sessions at once, further clients are turned away
+  int max_sessions = kDefaultServerSessions;
+  // Hash table shared by every session, in MB
+  int64_t hash_size = kDefaultServerHashSize;
+  // Caps on every request, 0 for none. Searches start counting time once a
+  // worker picks them up, so waiting in the queue doesn't use up the budget.
+  uint64_t max_nodes = 0;
+  int64_t max_time = 0;
+};
+
+// Parses "--socket /tmp/shepichess.sock --workers 4 --sessions 64 --hash 1024
+// --nodes 1000000 --movetime 5000", returns false (after logging the error) for
+// unknown or invalid arguments
+bool parseServerArgs(const std::vector<std::string>& args, ServerConfig& config);
+
+// Analysis server listening on a Unix domain socket, so a backend can keep one
+// process (and one warm hash table) for all its requests instead of starting an
+// engine for each.
+//
+// Every connection is a session speaking UCI: uci, isready, setoption (MultiPV
+// only), position, go, stop and quit. go queues the session's position and a
+// fixed pool of single threaded workers searches queued requests in order, all
+// sharing one hash table and the attack tables. ucinewgame is accepted but
+// doesn't clear the shared table, and go ponder searches normally. Clients
+// connecting while max_sessions are open get an error line and are disconnected.
+//
+// Only supported on POSIX systems, start fails elsewhere.
+class AnalysisServer {
+public:
+  explicit AnalysisServer(ServerConfig config);
+  ~AnalysisServer();
+
+  AnalysisServer(const AnalysisServer&) = delete;
+  AnalysisServer(AnalysisServer&&) = delete;
+  AnalysisServer& operator=(const AnalysisServer&) = delete;
+  AnalysisServer& operator=(AnalysisServer&&) = delete;
+
+  // Listens on the socket (replacing a stale one) and accepts sessions in the
+  // background. Returns false (after logging) if the socket can't be set up.
+  bool start();
+  // Closes the socket, disconnects every session and waits for them to end
+  void stop();
+  // Starts the server and blocks until SIGINT or SIGTERM
+  bool run();
+
+private:
+  struct Session;
+  struct Worker;
+
+  ServerConfig config;
+  HashTable tt;
+  std::vector<std::unique_ptr<Worker>> workers;
+  // Only used by the accept thread while it runs
+  std::list<std::unique_ptr<Session>> sessions;
+  std::deque<Session*> queue;
+  bool quit = false;
+  std::mutex lock;
+  // Signalled when a request is queued and when a search finishes
+  std::condition_variable queue_cv;
+  std::condition_variable done_cv;
+  int listen_fd = -1;
+  // Written to by stop to wake the accept thread
+  std::array<int, 2> wake_pipe {-1, -1};
+  std::thread accept_thread;
+
+  void acceptLoop();
+  void rejectSession(int fd);
+  void sessionLoop(Session& session);
+  void workerLoop(Worker& worker);
+  void startSearch(Session& session, std::string_view args);
+  void stopSearch(Session& session);
+  void waitForSearch(Session& session);
+  void endSession(Session& session);
+  void reapSessions(bool all);
+};
+
+} // namespace shepichess
@@ -0,0 +1,140 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <string>
+
+#if defined(__linux__)
+#  include <pthread.h>
+#  include <sched.h>
+#endif
+
+#include "logging.h"
+#include "tracing.h"
+
+namespace shepichess {
+
+namespace {
+
+// Pins the calling thread to the index-th cpu the process is allowed to run on
+void pinThread([[maybe_unused]] std::size_t index)
+{
+#if defined(__linux__)
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return;
+  int cpu_count = CPU_COUNT(&allowed);
+  if (cpu_count <= 1) return;
+  auto target = static_cast<int>(index % static_cast<std::size_t>(cpu_count));
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (!CPU_ISSET(cpu, &allowed) || target-- > 0) continue;
+    cpu_set_t pinned;
+    CPU_ZERO(&pinned);
+    CPU_SET(cpu, &pinned);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(pinned), &pinned) == 0) {
+      SPDLOG_DEBUG("Pinned search thread {} to cpu {}", index, cpu);
+    }
+    return;
+  }
+#endif
+}
+
+} // namespace
+
+ThreadPool::ThreadPool(std::size_t size, bool pin_threads) : pin_threads(pin_threads)
+{
+  resize(size);
+}
+
+ThreadPool::~ThreadPool()
+{
+  wait();
+  stopThreads();
+}
+
+void ThreadPool::resize(std::size_t new_size)
+{
+  new_size = std::max<std::size_t>(new_size, 1);
+  wait();
+  if (new_size == threads.size()) return;
+  stopThreads();
+  SPDLOG_DEBUG("Creating {} search threads", new_size);
+  for (std::size_t i = 0; i < new_size; i++) {
+    threads.emplace_back(&ThreadPool::workerLoop, this, i, generation);
+  }
+}
+
+void ThreadPool::start(Job new_job)
+{
+  wait();
+  {
+    std::scoped_lock start_lock(lock);
+    job = std::move(new_job);
+    running = threads.size();
+    generation++;
+    start_time = tracing() ? traceClock() : 0;
+  }
+  wake_cv.notify_all();
+}
+
+void ThreadPool::wait()
+{
+  std::unique_lock wait_lock(lock);
+  done_cv.wait(wait_lock, [this]() { return running == 0; });
+}
+
+bool ThreadPool::busy()
+{
+  std::scoped_lock busy_lock(lock);
+  return running != 0;
+}
+
+std::size_t ThreadPool::size() const
+{
+  return threads.size();
+}
+
+// seen_generation is captured at creation so a job started before the thread
+// first takes the lock is not missed
+void ThreadPool::workerLoop(std::size_t index, std::size_t seen_generation)
+{
+  if (pin_threads) pinThread(index);
+  setTraceThreadName("search thread " + std::to_string(index));
+  int64_t idle_since = tracing() ? traceClock() : 0;
+  std::unique_lock worker_lock(lock);
+  while (true) {
+    wake_cv.wait(worker_lock, [&]() { return quit || generation != seen_generation; });
+    if (quit) return;
+    seen_generation = generation;
+    int64_t woken_at = start_time;
+    worker_lock.unlock();
+    if (tracing()) {
+      // Wake up is the time from start until the thread runs
+      int64_t now = traceClock();
+      if (idle_since) traceEvent("sleep", idle_since, now);
+      if (woken_at) traceEvent("wake up", std::max(woken_at, idle_since), now);
+    }
+    {
+      TraceZone zone("job");
+      job(index);
+    }
+    idle_since = tracing() ? traceClock() : 0;
+    worker_lock.lock();
+    if (--running == 0) done_cv.notify_all();
+  }
+}
+
+void ThreadPool::stopThreads()
+{
+  {
+    std::scoped_lock stop_lock(lock);
+    quit = true;
+  }
+  wake_cv.notify_all();
+  for (auto&& thread : threads) {
+    thread.join();
+  }
+  threads.clear();
+  quit = false;
+}
+
+} // namespace shepichess
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace shepichess {
+
+// Fixed set of worker threads used by the search.
+//
+// Threads are created (and optionally pinned to a cpu where supported) when the
+// pool is constructed or resized, and sleep between jobs, so starting a search
+// only has to wake them.
+class ThreadPool {
+public:
+  using Job = std::function<void(std::size_t)>;
+
+  explicit ThreadPool(std::size_t size = 1, bool pin_threads = true);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool(ThreadPool&&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  ThreadPool& operator=(ThreadPool&&) = delete;
+
+  // Waits for any running job, then replaces the threads
+  void resize(std::size_t new_size);
+  // Runs job(thread_index) once on every thread, returns without waiting
+  void start(Job job);
+  // Blocks until every thread has finished the current job
+  void wait();
+  [[nodiscard]] bool busy();
+  [[nodiscard]] std::size_t size() const;
+
+private:
+  std::vector<std::thread> threads;
+  Job job;
+  std::size_t generation = 0;
+  std::size_t running = 0;
+  // When the current job was started, for tracing how long threads take to wake
+  int64_t start_time = 0;
+  bool quit = false;
+  bool pin_threads;
+  std::mutex lock;
+  std::condition_variable wake_cv;
+  std::condition_variable done_cv;
+
+  void workerLoop(std::size_t index, std::size_t seen_generation);
+  void stopThreads();
+};
+
+} // namespace shepichess
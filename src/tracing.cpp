@@ -0,0 +1,230 @@
+#include "tracing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <spdlog/fmt/fmt.h>
+
+#include "logging.h"
+
+namespace shepichess {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const Clock::time_point kEpoch = Clock::now();
+
+struct TraceEvent {
+  const char* name;
+  int64_t start;
+  int64_t end;
+  std::array<char, kTraceDetailSize> detail;
+};
+
+// Only the owning thread writes events. written is published with release, so
+// a reader sees every event before the count it loaded.
+struct ThreadBuffer {
+  std::array<TraceEvent, kTraceBufferSize> events;
+  std::atomic<uint64_t> written {0};
+  int id = 0;
+  // Guarded by the registry lock
+  std::string name;
+};
+
+// Buffers are kept after their thread exits so its events stay in the trace. A
+// thread only gets one once it records an event.
+struct Registry {
+  std::mutex lock;
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+  std::string path;
+  int64_t start = 0;
+};
+
+Registry& registry()
+{
+  static Registry instance;
+  return instance;
+}
+
+thread_local ThreadBuffer* thread_buffer = nullptr;
+thread_local std::string thread_name;
+
+ThreadBuffer* registerThread()
+{
+  Registry& traces = registry();
+  std::scoped_lock register_lock(traces.lock);
+  auto& buffer = traces.buffers.emplace_back(std::make_unique<ThreadBuffer>());
+  buffer->id = static_cast<int>(traces.buffers.size());
+  buffer->name = thread_name;
+  return thread_buffer = buffer.get();
+}
+
+void writeJsonString(std::ostream& out, std::string_view text)
+{
+  out << '"';
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      out << fmt::format("\\u{:04x}", static_cast<int>(c));
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+}
+
+} // namespace
+
+bool startTracing(const std::string& path)
+{
+  if (path.empty()) {
+    SPDLOG_ERROR("Tracing needs a file to write the trace to");
+    return false;
+  }
+  Registry& traces = registry();
+  {
+    std::scoped_lock start_lock(traces.lock);
+    traces.path = path;
+    traces.start = traceClock();
+  }
+  detail::trace_recording = true;
+  SPDLOG_INFO("Tracing to \"{}\"", path);
+  return true;
+}
+
+void stopTracing()
+{
+  detail::trace_recording = false;
+}
+
+std::string tracePath()
+{
+  Registry& traces = registry();
+  std::scoped_lock path_lock(traces.lock);
+  return traces.path;
+}
+
+// Events are copied out of the ring buffers while their threads may still be
+// writing. Anything the writer could have overwritten during the copy is
+// dropped by checking the count again afterwards.
+void writeTrace(std::ostream& out)
+{
+  Registry& traces = registry();
+  std::scoped_lock write_lock(traces.lock);
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  const char* separator = "\n";
+  std::vector<TraceEvent> events;
+  for (auto&& buffer : traces.buffers) {
+    out << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+        << buffer->id << ",\"args\":{\"name\":";
+    writeJsonString(out, buffer->name.empty() ? "thread" : buffer->name);
+    out << "}}";
+    separator = ",\n";
+
+    uint64_t end = buffer->written.load(std::memory_order_acquire);
+    uint64_t begin = end > kTraceBufferSize ? end - kTraceBufferSize : 0;
+    events.clear();
+    for (uint64_t i = begin; i < end; i++) {
+      events.push_back(buffer->events[i % kTraceBufferSize]);
+    }
+    // The writer may already be filling the slot after the last counted event,
+    // which holds the oldest event still in the ring. The fence keeps the copy
+    // from being reordered after the second load.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t written = buffer->written.load(std::memory_order_relaxed) + 1;
+    uint64_t overwritten = written > kTraceBufferSize ? written - kTraceBufferSize : 0;
+    for (uint64_t i = std::max(begin, overwritten); i < end; i++) {
+      const TraceEvent& event = events[i - begin];
+      if (event.start < traces.start) continue;
+      out << ",\n{\"name\":";
+      writeJsonString(out, event.name);
+      out << fmt::format(
+        ",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}",
+        buffer->id,
+        static_cast<double>(event.start) / 1000.0,
+        static_cast<double>(event.end - event.start) / 1000.0);
+      if (event.detail[0]) {
+        out << ",\"args\":{\"detail\":";
+        writeJsonString(out, event.detail.data());
+        out << '}';
+      }
+      out << '}';
+    }
+  }
+  out << "\n]}\n";
+}
+
+bool saveTrace(const std::string& path)
+{
+  std::ofstream file(path);
+  if (file) writeTrace(file);
+  if (!file) {
+    SPDLOG_ERROR("Failed to write trace to \"{}\"", path);
+    return false;
+  }
+  SPDLOG_INFO("Saved trace to \"{}\"", path);
+  return true;
+}
+
+bool saveTrace()
+{
+  if (!tracing()) {
+    SPDLOG_ERROR("Tracing isn't enabled, set a Trace File first");
+    return false;
+  }
+  return saveTrace(tracePath());
+}
+
+void setTraceThreadName(std::string name)
+{
+  thread_name = std::move(name);
+  if (!thread_buffer) return;
+  std::scoped_lock name_lock(registry().lock);
+  thread_buffer->name = thread_name;
+}
+
+int64_t traceClock()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - kEpoch)
+    .count();
+}
+
+void traceEvent(const char* name, int64_t start, int64_t end, std::string_view detail)
+{
+  if (!tracing()) return;
+  ThreadBuffer* buffer = thread_buffer ? thread_buffer : registerThread();
+  uint64_t index = buffer->written.load(std::memory_order_relaxed);
+  TraceEvent& event = buffer->events[index % kTraceBufferSize];
+  event.name = name;
+  event.start = start;
+  event.end = end;
+  size_t size = std::min(detail.size(), kTraceDetailSize - 1);
+  std::copy_n(detail.data(), size, event.detail.data());
+  event.detail[size] = '\0';
+  buffer->written.store(index + 1, std::memory_order_release);
+}
+
+void TraceZone::begin(std::string_view text)
+{
+  detail_size = std::min(text.size(), kTraceDetailSize - 1);
+  std::copy_n(text.data(), detail_size, detail.data());
+  start = traceClock();
+}
+
+void TraceZone::begin(int64_t value)
+{
+  char* last = detail.data() + detail.size();
+  auto [end, error] = std::to_chars(detail.data(), last, value);
+  detail_size = error == std::errc() ? static_cast<size_t>(end - detail.data()) : 0;
+  start = traceClock();
+}
+
+} // namespace shepichess
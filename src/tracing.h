@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace shepichess {
+
+// Timeline tracing of the UCI loop, search threads and other slow operations.
+//
+// Every thread records its zones into its own ring buffer, so recording never
+// takes a lock. While tracing is off a zone costs one relaxed load.
+
+// Events each thread keeps, older ones are overwritten
+constexpr std::size_t kTraceBufferSize = 4096;
+// Longer zone details are truncated
+constexpr std::size_t kTraceDetailSize = 24;
+
+namespace detail {
+inline std::atomic<bool> trace_recording {false};
+} // namespace detail
+
+// Starts recording (dropping earlier events), saveTrace or quitting write the
+// trace to path. Logs and returns false if path is empty.
+bool startTracing(const std::string& path);
+void stopTracing();
+[[nodiscard]] inline bool tracing()
+{
+  return detail::trace_recording.load(std::memory_order_relaxed);
+}
+// Path passed to startTracing, empty if tracing was never started
+[[nodiscard]] std::string tracePath();
+// Writes the events recorded since startTracing as Chrome trace JSON, which
+// chrome://tracing and ui.perfetto.dev open. Recording continues.
+void writeTrace(std::ostream& out);
+bool saveTrace(const std::string& path);
+// Saves to the path passed to startTracing if recording
+bool saveTrace();
+
+// Name the calling thread is shown with
+void setTraceThreadName(std::string name);
+// Nanoseconds since the process started
+[[nodiscard]] int64_t traceClock();
+// Records a zone on the calling thread, if tracing
+void traceEvent(
+  const char* name, int64_t start, int64_t end, std::string_view detail = {});
+
+// Records the time until it goes out of scope. name must outlive the trace,
+// detail is copied.
+class TraceZone {
+public:
+  explicit TraceZone(const char* name, std::string_view detail = {})
+    : name(tracing() ? name : nullptr)
+  {
+    if (this->name) begin(detail);
+  }
+  TraceZone(const char* name, int64_t value) : name(tracing() ? name : nullptr)
+  {
+    if (this->name) begin(value);
+  }
+  ~TraceZone()
+  {
+    if (name) traceEvent(name, start, traceClock(), {detail.data(), detail_size});
+  }
+
+  TraceZone(const TraceZone&) = delete;
+  TraceZone(TraceZone&&) = delete;
+  TraceZone& operator=(const TraceZone&) = delete;
+  TraceZone& operator=(TraceZone&&) = delete;
+
+private:
+  const char* name;
+  int64_t start = 0;
+  std::array<char, kTraceDetailSize> detail;
+  std::size_t detail_size = 0;
+
+  void begin(std::string_view text);
+  void begin(int64_t value);
+};
+
+} // namespace shepichess
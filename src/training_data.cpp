@@ -0,0 +1,199 @@
+#include "training_data.h"
+
+#include <algorithm>
+
+#if !defined(_WIN32)
+#  include <fcntl.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+#include "bitboard.h"
+#include "logging.h"
+#include "search.h"
+
+namespace shepichess {
+
+PackedPosition PackedPosition::pack(const Position& position, int white_score)
+{
+  PackedPosition packed {};
+  packed.occupancy = position.occupied();
+  int i = 0;
+  for (Bitboard occupied = packed.occupancy; occupied; i++) {
+    int square = bitboards::bitscan(occupied);
+    occupied = bitboards::poplsb(occupied);
+    auto piece = static_cast<uint8_t>(index(position.pieceOn(square)));
+    packed.pieces[i / 2] |= static_cast<uint8_t>(i % 2 ? piece << 4 : piece);
+  }
+  const PositionState& state = position.state();
+  packed.side_and_castling = static_cast<uint8_t>(
+    (position.sideToMove() == Color::Black) | state.white_kingside_castle << 1 |
+    state.white_queenside_castle << 2 | state.black_kingside_castle << 3 |
+    state.black_queenside_castle << 4);
+  packed.enpassant_square = static_cast<uint8_t>(state.enpassant_square);
+  packed.move_count50 = static_cast<uint8_t>(std::min<int>(state.move_count50, 255));
+  packed.result = Draw;
+  packed.move_number = static_cast<uint16_t>(position.moveNumber());
+  packed.score = static_cast<int16_t>(std::clamp(white_score, -kInfinity, kInfinity));
+  return packed;
+}
+
+std::string PackedPosition::fen() const
+{
+  std::array<Piece, 64> board;
+  board.fill(Piece::None);
+  int i = 0;
+  for (Bitboard occupied = occupancy; occupied && i < 32; i++) {
+    int square = bitboards::bitscan(occupied);
+    occupied = bitboards::poplsb(occupied);
+    board[square] = static_cast<Piece>(pieces[i / 2] >> (i % 2 * 4) & 0xf);
+  }
+
+  std::string result;
+  for (int rank = 7; rank >= 0; rank--) {
+    int empty = 0;
+    for (int file = 0; file < 8; file++) {
+      Piece piece = board[makeSquare(file, rank)];
+      if (piece == Piece::None) {
+        empty++;
+        continue;
+      }
+      if (empty) result += static_cast<char>('0' + empty);
+      empty = 0;
+      result += pieceToChar(piece);
+    }
+    if (empty) result += static_cast<char>('0' + empty);
+    if (rank) result += '/';
+  }
+  result += side_and_castling & 1 ? " b " : " w ";
+  std::string castling;
+  for (int right = 0; right < 4; right++) {
+    if (side_and_castling >> (right + 1) & 1) castling += "KQkq"[right];
+  }
+  result += castling.empty() ? "-" : castling;
+  result += ' ';
+  result += enpassant_square < kNoSquare ? squareName(enpassant_square) : "-";
+  result += ' ' + std::to_string(move_count50) + ' ' + std::to_string(move_number);
+  return result;
+}
+
+TrainingDataFile::~TrainingDataFile()
+{
+  close();
+}
+
+#if defined(_WIN32)
+
+bool TrainingDataFile::open(const std::string& path)
+{
+  close();
+  file.open(path, std::ios::binary | std::ios::app);
+  if (!file) {
+    SPDLOG_ERROR("Failed to open training data file \"{}\"", path);
+    return false;
+  }
+  bytes_written = 0;
+  return true;
+}
+
+void TrainingDataFile::close()
+{
+  if (file.is_open()) file.close();
+}
+
+bool TrainingDataFile::isOpen() const
+{
+  return file.is_open();
+}
+
+bool TrainingDataFile::write(const PackedPosition* positions, size_t count)
+{
+  std::scoped_lock write_lock(lock);
+  size_t bytes = count * sizeof(PackedPosition);
+  const char* data = reinterpret_cast<const char*>(positions);
+  file.write(data, static_cast<std::streamsize>(bytes));
+  if (!file) return false;
+  bytes_written += bytes;
+  return true;
+}
+
+#else
+
+bool TrainingDataFile::open(const std::string& path)
+{
+  close();
+  fd = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+  struct stat file_stat {};
+  if (fd < 0 || fstat(fd, &file_stat) != 0) {
+    close();
+    SPDLOG_ERROR("Failed to open training data file \"{}\"", path);
+    return false;
+  }
+  // Append whole records, dropping a partial one left by an interrupted run
+  uint64_t size = static_cast<uint64_t>(file_stat.st_size);
+  offset = size - size % sizeof(PackedPosition);
+  bytes_written = 0;
+  return true;
+}
+
+void TrainingDataFile::close()
+{
+  if (fd >= 0) ::close(fd);
+  fd = -1;
+}
+
+bool TrainingDataFile::isOpen() const
+{
+  return fd >= 0;
+}
+
+bool TrainingDataFile::write(const PackedPosition* positions, size_t count)
+{
+  size_t bytes = count * sizeof(PackedPosition);
+  uint64_t start = offset.fetch_add(bytes);
+  const char* data = reinterpret_cast<const char*>(positions);
+  if (!writeFileAt(fd, data, bytes, static_cast<int64_t>(start))) return false;
+  bytes_written += bytes;
+  return true;
+}
+
+#endif
+
+TrainingDataWriter::TrainingDataWriter(TrainingDataFile& file)
+  : file(file)
+{
+  buffer.reserve(kBufferSize);
+}
+
+TrainingDataWriter::~TrainingDataWriter()
+{
+  flush();
+}
+
+void TrainingDataWriter::push(const PackedPosition& position)
+{
+  buffer.push_back(position);
+  if (buffer.size() == kBufferSize) flush();
+}
+
+bool TrainingDataWriter::flush()
+{
+  if (buffer.empty()) return true;
+  bool success = file.write(buffer.data(), buffer.size());
+  if (!success) SPDLOG_ERROR("Failed to write {} training positions", buffer.size());
+  buffer.clear();
+  return success;
+}
+
+bool TrainingDataReader::open(const std::string& path)
+{
+  if (!file.open(path)) return false;
+  if (file.size() % sizeof(PackedPosition)) {
+    SPDLOG_ERROR("\"{}\" is not a training data file", path);
+    file.close();
+    return false;
+  }
+  return true;
+}
+
+} // namespace shepichess
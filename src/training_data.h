@@ -0,0 +1,121 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+#include "position.h"
+
+#if defined(_WIN32)
+#  include <fstream>
+#endif
+
+namespace shepichess {
+
+// A labelled training position packed into 32 bytes. Files are plain arrays of
+// these in native byte order with no header, so they can be concatenated and
+// shuffled freely.
+struct PackedPosition {
+  enum Result : uint8_t { BlackWins = 0, Draw = 1, WhiteWins = 2 };
+
+  // Occupied squares, and one 4 bit Piece per occupied square in square order
+  uint64_t occupancy;
+  std::array<uint8_t, 16> pieces;
+  // Bit 0 is set with black to move, bits 1-4 hold the castling rights (KQkq)
+  uint8_t side_and_castling;
+  uint8_t enpassant_square;
+  uint8_t move_count50;
+  uint8_t result;
+  uint16_t move_number;
+  // Search score in centipawns from white's point of view
+  int16_t score;
+
+  static PackedPosition pack(const Position& position, int white_score);
+  [[nodiscard]] std::string fen() const;
+  // Returns false if the packed data doesn't describe a valid position
+  bool unpack(Position& position) const { return position.setFen(fen()); }
+};
+static_assert(sizeof(PackedPosition) == 32, "Training files rely on 32 byte records");
+
+// A training data file that many threads append to at once. Writers reserve a
+// range of the file with an atomic offset and write it with pwrite, so they
+// never wait for each other.
+class TrainingDataFile {
+public:
+  TrainingDataFile() = default;
+  ~TrainingDataFile();
+
+  TrainingDataFile(const TrainingDataFile&) = delete;
+  TrainingDataFile(TrainingDataFile&&) = delete;
+  TrainingDataFile& operator=(const TrainingDataFile&) = delete;
+  TrainingDataFile& operator=(TrainingDataFile&&) = delete;
+
+  // Appends to path, returns false (and logs why) if it can't be opened
+  bool open(const std::string& path);
+  void close();
+  [[nodiscard]] bool isOpen() const;
+  // Safe to call from any thread, returns false if the write failed
+  bool write(const PackedPosition* positions, size_t count);
+  [[nodiscard]] uint64_t positionsWritten() const
+  {
+    return bytes_written.load() / sizeof(PackedPosition);
+  }
+
+private:
+  std::atomic<uint64_t> offset {0};
+  std::atomic<uint64_t> bytes_written {0};
+#if defined(_WIN32)
+  std::ofstream file;
+  std::mutex lock;
+#else
+  int fd = -1;
+#endif
+};
+
+// Buffers the positions of one thread and writes them to the file in large
+// batches. Not thread-safe, every thread needs its own writer.
+class TrainingDataWriter {
+public:
+  static constexpr size_t kBufferSize = 4096;
+
+  explicit TrainingDataWriter(TrainingDataFile& file);
+  ~TrainingDataWriter();
+
+  TrainingDataWriter(const TrainingDataWriter&) = delete;
+  TrainingDataWriter(TrainingDataWriter&&) = delete;
+  TrainingDataWriter& operator=(const TrainingDataWriter&) = delete;
+  TrainingDataWriter& operator=(TrainingDataWriter&&) = delete;
+
+  void push(const PackedPosition& position);
+  bool flush();
+
+private:
+  TrainingDataFile& file;
+  std::vector<PackedPosition> buffer;
+};
+
+// Streams a training data file back through a read-only memory mapping
+class TrainingDataReader {
+public:
+  // Returns false if the file can't be mapped or isn't a whole number of records
+  bool open(const std::string& path);
+  void close() { file.close(); }
+
+  [[nodiscard]] size_t size() const { return file.size() / sizeof(PackedPosition); }
+  [[nodiscard]] const PackedPosition& operator[](size_t i) const { return begin()[i]; }
+  [[nodiscard]] const PackedPosition* begin() const
+  {
+    return reinterpret_cast<const PackedPosition*>(file.data());
+  }
+  [[nodiscard]] const PackedPosition* end() const { return begin() + size(); }
+
+private:
+  MappedFile file;
+};
+
+} // namespace shepichess
@@ -1,40 +1,175 @@
 #include "uci_application.h"
 
 #include <iostream>
-#include <regex>
-#include <sstream>
 #include <string>
+#include <string_view>
 
 #include "bitboard.h"
+#include "cpu.h"
 #include "logging.h"
+#include "movegen.h"
+#include "tracing.h"
+#include "uci_tokenizer.h"
 
 namespace shepichess {
 
 struct UCIApp::UCICommand {
-  std::string command;
-  std::string args;
+  std::string_view command;
+  std::string_view args;
 };
 
+namespace {
+
+// Reads the startpos or fen part of a position command. Returns false (after
+// logging) if it's malformed, otherwise tokens is left at the first move.
+bool parsePositionRoot(
+  std::string_view args, UCITokenizer& tokens, std::string_view& fen)
+{
+  std::string_view kind = tokens.next();
+  if (kind == "startpos") {
+    fen = kStartFen;
+  } else if (kind == "fen") {
+    fen = tokens.until("moves");
+  } else {
+    SPDLOG_ERROR("UCI: position: expected startpos or fen in \"{}\"", args);
+    return false;
+  }
+  if (!tokens.done() && tokens.next() != "moves") {
+    SPDLOG_ERROR("UCI: position: expected moves in \"{}\"", args);
+    return false;
+  }
+  return true;
+}
+
+// A move of a position command, null (after logging) if it's illegal
+Move parsePositionMove(Position& position, std::string_view token)
+{
+  Move move = parseUCIMove(position, token);
+  if (move.isNull()) SPDLOG_ERROR("UCI: position: illegal move \"{}\"", token);
+  return move;
+}
+
+} // namespace
+
+bool parsePosition(std::string_view args, Position& position)
+{
+  UCITokenizer tokens {args};
+  std::string_view fen;
+  if (!parsePositionRoot(args, tokens, fen) || !position.setFen(fen)) return false;
+  for (std::string_view token = tokens.next(); !token.empty(); token = tokens.next()) {
+    Move move = parsePositionMove(position, token);
+    if (move.isNull()) return false;
+    position.makeMove(move);
+  }
+  return true;
+}
+
+void parseGoLimits(
+  std::string_view args, Position& position, SearchLimits& limits)
+{
+  // Time limits count from when go was received
+  limits.clear();
+  limits.start_time = SearchLimits::Clock::now();
+  UCITokenizer tokens {args};
+  while (!tokens.done()) {
+    std::string_view token = tokens.next();
+    bool parsed = true;
+    if (token == "wtime")
+      parsed = tokens.nextNumber(limits.time[index(Color::White)]);
+    else if (token == "btime")
+      parsed = tokens.nextNumber(limits.time[index(Color::Black)]);
+    else if (token == "winc")
+      parsed = tokens.nextNumber(limits.increment[index(Color::White)]);
+    else if (token == "binc")
+      parsed = tokens.nextNumber(limits.increment[index(Color::Black)]);
+    else if (token == "movestogo")
+      parsed = tokens.nextNumber(limits.moves_to_go);
+    else if (token == "depth")
+      parsed = tokens.nextNumber(limits.depth);
+    else if (token == "nodes")
+      parsed = tokens.nextNumber(limits.nodes);
+    else if (token == "movetime")
+      parsed = tokens.nextNumber(limits.move_time);
+    else if (token == "mate")
+      parsed = tokens.nextNumber(limits.mate);
+    else if (token == "infinite")
+      limits.infinite = true;
+    else if (token == "ponder")
+      limits.ponder = true;
+    else if (token == "searchmoves") {
+      for (Move move = parseUCIMove(position, tokens.peek()); !move.isNull();
+           move = parseUCIMove(position, tokens.peek())) {
+        limits.search_moves.push_back(move);
+        tokens.next();
+      }
+    } else {
+      SPDLOG_ERROR("UCI: go: unrecognized token \"{}\"", token);
+    }
+    if (!parsed) SPDLOG_ERROR("UCI: go: expected a number after \"{}\"", token);
+  }
+}
+
 UCIApp::UCIApp(std::istream& in, std::ostream& out)
-  : position(), config(), in(in), out(out)
+  : position(), engine(out), in(in)
 {
   initLogging();
+  setTraceThreadName("uci");
   bitboards::init();
+  registerOptions();
+  SPDLOG_INFO("Using {} instruction set", cpuLevelName(cpuLevel()));
+}
+
+// Engine options are registered by the engine, logging and tracing are
+// configured for the whole process
+void UCIApp::registerOptions()
+{
+  auto changeLogLevel = [](const UCIOption& option) {
+    return setLogLevel(option.asString());
+  };
+  auto changeLogFile = [](const UCIOption& option) {
+    return setLogFile(option.asString());
+  };
+  auto changeTraceFile = [](const UCIOption& option) {
+    if (!option.asString().empty()) return startTracing(option.asString());
+    stopTracing();
+    return true;
+  };
+
+  UCIConfig& config = engine.options();
+  config.addOption(UCIOption::combo(
+    "Log Level",
+    "info",
+    {"trace", "debug", "info", "warning", "error", "critical", "off"},
+    changeLogLevel));
+  config.addOption(UCIOption::string("Log File", "", changeLogFile));
+  // Tracing may already have been started from the command line
+  config.addOption(UCIOption::string(
+    "Trace File", tracing() ? tracePath() : "", changeTraceFile));
+  auto saveTraceFile = [](const UCIOption&) { return saveTrace(); };
+  config.addOption(UCIOption::button("Save Trace", saveTraceFile));
 }
 
 void UCIApp::mainLoop()
 {
   while (true) {
     auto&& [command, args] = getUCICommand();
+    TraceZone zone("command", line);
 
-    if (command == "quit")
+    if (command == "quit") {
+      engine.stop();
+      engine.wait();
+      engine.output().flush();
+      if (tracing()) saveTrace();
+      flushLogs();
       break;
-    else if (command == "uci")
+    } else if (command == "uci")
       respondUCI();
     else if (command == "isready")
       respondReady();
     else if (command == "debug")
       setDebugMode(args);
+    else if (command == "ucinewgame")
+      uciNewGame();
     else if (command == "setoption")
       setOption(args);
     else if (command == "position")
@@ -45,6 +180,8 @@ void UCIApp::mainLoop()
       stopCalculation();
     else if (command == "ponderhit")
       ponderhit();
+    else if (command == "bench")
+      bench(args);
     else {
       // Invalid UCI commands must be ignored, but we still want to log them.
       SPDLOG_ERROR("Invalid UCI command: command unrecognized");
@@ -52,28 +189,34 @@ void UCIApp::mainLoop()
   }
 }
 
+// The line buffer is reused between commands and the returned views point into
+// it, so reading a command doesn't allocate once the buffer has grown.
 UCIApp::UCICommand UCIApp::getUCICommand()
 {
-  std::string line, command, args;
-  std::getline(in, line);
+  // Replies are buffered, make sure the GUI has them before blocking on input
+  engine.output().flush();
+  if (!std::getline(in, line)) {
+    SPDLOG_INFO("INPUT: end of stream");
+    return UCICommand {"quit", ""};
+  }
   SPDLOG_INFO("INPUT: \"{}\"", line);
-  std::istringstream iss {line};
-  iss >> command >> std::ws;
-  std::getline(iss, args);
-  return UCICommand {command, args};
+  UCITokenizer tokens {line};
+  std::string_view command = tokens.next();
+  return UCICommand {command, tokens.rest()};
 }
 
 void UCIApp::sendUCICommand(const std::string& line)
 {
-  out << line << std::endl;
-  SPDLOG_INFO("OUTPUT: \"{}\"", line);
+  engine.output().send(line);
 }
 
 void UCIApp::respondUCI()
 {
-  sendUCICommand("id name " + kEngineName);
+  // The instruction set is picked at startup, report it to tell builds apart
+  std::string cpu {cpuLevelName(cpuLevel())};
+  sendUCICommand("id name " + kEngineName + " (" + cpu + ")");
   sendUCICommand("id author " + kEngineAuthor);
-  for (auto&& option : config.getAvailableOptions()) {
+  for (auto&& option : engine.options().getAvailableOptions()) {
     std::string uciString = option.uciString();
     sendUCICommand("option " + uciString);
     SPDLOG_DEBUG("Available Option: {}", uciString);
@@ -86,10 +229,12 @@ void UCIApp::respondReady()
   sendUCICommand("readyok");
 }
 
-// TODO: Probably just will clear hash tables?
-void UCIApp::uciNewGame() {}
+void UCIApp::uciNewGame()
+{
+  engine.newGame();
+}
 
-void UCIApp::setDebugMode(const std::string& args)
+void UCIApp::setDebugMode(std::string_view args)
 {
   if (args == "on") {
     SPDLOG_INFO("Setting UCIDebugMode to ON (was {})", uciDebugMode ? "ON" : "OFF");
@@ -102,33 +247,116 @@ void UCIApp::setDebugMode(const std::string& args)
   }
 }
 
-void UCIApp::setOption(const std::string& args)
+void UCIApp::setOption(std::string_view args)
 {
-  std::smatch nameMatch, valueMatch;
-  std::regex_search(args, nameMatch, std::regex(R"(name\s*(.*?[^\s])\s*(?:$|value))"));
-  std::regex_search(args, valueMatch, std::regex(R"(value\s*(.*?[^\s])\s*(?:$|name))"));
-  std::string name = nameMatch[1];
-  std::string value = valueMatch[1];
-  if (!name.size()) {
+  UCITokenizer tokens {args};
+  if (tokens.next() != "name") {
+    SPDLOG_ERROR("UCI: setoption: failed to parse option name from \"{}\"", args);
+    return;
+  }
+  std::string_view name = tokens.until("value");
+  tokens.next();
+  std::string_view value = tokens.rest();
+  if (name.empty()) {
     SPDLOG_ERROR("UCI: setoption: failed to parse option name from \"{}\"", args);
     return;
   }
   SPDLOG_DEBUG("UCI: setoption: name=\"{}\" value=\"{}\"", name, value);
-  config.setOption(name, value);
+  engine.setOption(std::string(name), std::string(value));
+}
+
+// GUIs resend the whole game before every move. If the new move list starts with
+// the moves already played from the same root, only the difference is applied
+// (taking moves back where the lists diverge) instead of replaying everything.
+// Positions only keep kHistorySize plies, longer takebacks replay from the root.
+//
+// A command that fails to parse leaves the position as it was before it.
+void UCIApp::setPosition(std::string_view args)
+{
+  if (!applyPosition(args)) restorePosition();
+}
+
+bool UCIApp::applyPosition(std::string_view args)
+{
+  UCITokenizer tokens {args};
+  std::string_view fen;
+  if (!parsePositionRoot(args, tokens, fen)) return false;
+
+  bool new_root = fen != root_fen;
+  size_t common_moves = 0;
+  if (new_root) {
+    if (!position.setFen(fen)) return false;
+  } else {
+    while (common_moves < played_moves.size() &&
+           tokens.peek() == played_moves[common_moves].uci()) {
+      tokens.next();
+      common_moves++;
+    }
+    size_t takebacks = played_moves.size() - common_moves;
+    if (takebacks > static_cast<size_t>(position.undoablePlies())) {
+      position.setFen(root_fen);
+      for (size_t i = 0; i < common_moves; i++) position.makeMove(played_moves[i]);
+    } else {
+      for (size_t i = 0; i < takebacks; i++) position.unmakeMove();
+    }
+  }
+  new_moves.clear();
+  for (std::string_view token = tokens.next(); !token.empty(); token = tokens.next()) {
+    Move move = parsePositionMove(position, token);
+    if (move.isNull()) return false;
+    position.makeMove(move);
+    new_moves.push_back(move);
+  }
+
+  if (new_root) root_fen.assign(fen);
+  played_moves.resize(common_moves);
+  played_moves.insert(played_moves.end(), new_moves.begin(), new_moves.end());
+  return true;
 }
 
-// TODO: depends on position.h
-void UCIApp::setPosition(const std::string& args) {}
+// Sets up the position from before a position command that failed to parse
+void UCIApp::restorePosition()
+{
+  position.setFen(root_fen);
+  for (Move move : played_moves) position.makeMove(move);
+  sendUCICommand("info string invalid position command, keeping the previous one");
+}
 
-// TODO: depends on search implementation
-void UCIApp::startCalculation(const std::string& args) {}
+void UCIApp::startCalculation(std::string_view args)
+{
+  parseGoLimits(args, position, limits);
+  engine.go(position, limits);
+}
 
-// TODO: depends on search implementation
-void UCIApp::stopCalculation() {}
+void UCIApp::stopCalculation()
+{
+  engine.stop();
+}
 
 void UCIApp::ponderhit()
 {
-  // TODO: Add when pondering support is added
+  engine.ponderhit();
+}
+
+// Not part of UCI: "bench [depth]" searches the bench positions and reports the
+// total nodes, in the format testing frameworks expect
+void UCIApp::bench(std::string_view args)
+{
+  UCITokenizer tokens {args};
+  int depth = kDefaultBenchDepth;
+  if (!tokens.done() && (!tokens.nextNumber(depth) || depth < 1 || depth >= kMaxPly)) {
+    SPDLOG_ERROR("Invalid bench depth: {}", args);
+    return;
+  }
+  if (engine.searching()) {
+    sendUCICommand("info string bench ignored while searching");
+    return;
+  }
+  engine.wait();
+  BenchResult result = engine.bench(depth);
+  uint64_t nps = result.nodes * 1000 / std::max<int64_t>(result.time.count(), 1);
+  sendUCICommand(
+    std::to_string(result.nodes) + " nodes " + std::to_string(nps) + " nps");
 }
 
 } // namespace shepichess
@@ -2,15 +2,26 @@
 
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <vector>
 
+#include "engine.h"
 #include "position.h"
-#include "uci_config.h"
+#include "search.h"
 
 namespace shepichess {
 
 const inline std::string kEngineName {"shepichess"};
 const inline std::string kEngineAuthor {"shepi13"};
 
+// Sets position from the arguments of a position command, playing every move
+// from the root. Returns false (after logging) if they are invalid.
+bool parsePosition(std::string_view args, Position& position);
+// Parses the arguments of a go command, limits are cleared first and count from
+// now. Invalid tokens are logged and skipped.
+void parseGoLimits(
+  std::string_view args, Position& position, SearchLimits& limits);
+
 class UCIApp {
 public:
   UCIApp(std::istream& = std::cin, std::ostream& = std::cout);
@@ -22,13 +33,23 @@ public:
   UCIApp& operator=(UCIApp&&) = delete;
 
   void mainLoop();
+  [[nodiscard]] const Position& getPosition() const { return position; }
 
 private:
   Position position;
-  UCIConfig config;
+  // FEN the current position was set up from, and the moves played since
+  std::string root_fen {kStartFen};
+  std::vector<Move> played_moves;
+  // Moves of the position command being applied, they are only added to
+  // played_moves once the whole command has parsed
+  std::vector<Move> new_moves;
+  Engine engine;
   bool uciDebugMode = false;
   std::istream& in;
-  std::ostream& out;
+  SearchLimits limits;
+  std::string line;
+
+  void registerOptions();
 
   // IO Handlers
   struct UCICommand;
@@ -39,12 +60,17 @@ private:
   void respondUCI();
   void respondReady();
   void uciNewGame();
-  void setDebugMode(const std::string& args);
-  void setOption(const std::string& args);
-  void setPosition(const std::string& args);
-  void startCalculation(const std::string& args);
+  void setDebugMode(std::string_view args);
+  void setOption(std::string_view args);
+  void setPosition(std::string_view args);
+  // Returns false if the command is invalid, root_fen and played_moves are only
+  // updated once it has parsed
+  bool applyPosition(std::string_view args);
+  void restorePosition();
+  void startCalculation(std::string_view args);
   void stopCalculation();
   void ponderhit();
+  void bench(std::string_view args);
 };
 
 } // namespace shepichess
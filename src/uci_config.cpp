@@ -1,10 +1,211 @@
 #include "uci_config.h"
 
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+
+#include "logging.h"
+
 namespace shepichess {
 
-bool UCIConfig::setOption(const std::string& name, const std::string& val)
+namespace {
+
+bool equalsIgnoreCase(const std::string& lhs, const std::string& rhs)
+{
+  return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](char a, char b) {
+    return std::tolower(static_cast<unsigned char>(a)) ==
+      std::tolower(static_cast<unsigned char>(b));
+  });
+}
+
+const char* typeName(UCIOptionType type)
+{
+  switch (type) {
+  case UCIOptionType::Check: return "check";
+  case UCIOptionType::Spin: return "spin";
+  case UCIOptionType::Combo: return "combo";
+  case UCIOptionType::Button: return "button";
+  case UCIOptionType::String: return "string";
+  }
+  return "";
+}
+
+template<typename Options>
+auto findByName(Options& options, const std::string& name)
 {
+  auto match = [&](const UCIOption& option) {
+    return equalsIgnoreCase(option.name(), name);
+  };
+  auto option = std::find_if(options.begin(), options.end(), match);
+  return option == options.end() ? nullptr : &*option;
+}
+
+} // namespace
+
+UCIOption::UCIOption(const std::string& name, UCIOptionType type, Callback on_change)
+  : option_name(name), option_type(type), on_change(std::move(on_change))
+{
+}
+
+UCIOption UCIOption::check(
+  const std::string& name, bool default_value, Callback on_change)
+{
+  UCIOption option {name, UCIOptionType::Check, std::move(on_change)};
+  option.default_value = option.value = default_value ? "true" : "false";
+  return option;
+}
+
+UCIOption UCIOption::spin(
+  const std::string& name,
+  int64_t default_value,
+  int64_t min,
+  int64_t max,
+  Callback on_change)
+{
+  UCIOption option {name, UCIOptionType::Spin, std::move(on_change)};
+  option.default_value = option.value = std::to_string(default_value);
+  option.min = min;
+  option.max = max;
+  return option;
+}
+
+UCIOption UCIOption::combo(
+  const std::string& name,
+  const std::string& default_value,
+  const std::vector<std::string>& vars,
+  Callback on_change)
+{
+  UCIOption option {name, UCIOptionType::Combo, std::move(on_change)};
+  option.default_value = option.value = default_value;
+  option.vars = vars;
+  return option;
+}
+
+UCIOption UCIOption::button(const std::string& name, Callback on_change)
+{
+  return UCIOption {name, UCIOptionType::Button, std::move(on_change)};
+}
+
+UCIOption UCIOption::string(
+  const std::string& name, const std::string& default_value, Callback on_change)
+{
+  UCIOption option {name, UCIOptionType::String, std::move(on_change)};
+  option.default_value = option.value = default_value;
+  return option;
+}
+
+std::string UCIOption::uciString() const
+{
+  std::string result = "name " + option_name + " type " + typeName(option_type);
+  if (option_type == UCIOptionType::Button) return result;
+  // UCI uses <empty> to advertise an empty default string
+  result += " default " + (default_value.empty() ? "<empty>" : default_value);
+  if (option_type == UCIOptionType::Spin) {
+    result += " min " + std::to_string(min) + " max " + std::to_string(max);
+  }
+  for (auto&& var : vars) {
+    result += " var " + var;
+  }
+  return result;
+}
+
+bool UCIOption::set(const std::string& new_value)
+{
+  std::string previous = value;
+  switch (option_type) {
+  case UCIOptionType::Check:
+    if (new_value != "true" && new_value != "false") return false;
+    value = new_value;
+    break;
+  case UCIOptionType::Spin: {
+    int64_t parsed = 0;
+    const char* end = new_value.data() + new_value.size();
+    auto [ptr, error] = std::from_chars(new_value.data(), end, parsed);
+    bool valid = error == std::errc() && ptr == end;
+    if (!valid || parsed < min || parsed > max) return false;
+    value = new_value;
+    break;
+  }
+  case UCIOptionType::Combo: {
+    auto match = [&](const std::string& var) {
+      return equalsIgnoreCase(var, new_value);
+    };
+    auto var = std::find_if(vars.begin(), vars.end(), match);
+    if (var == vars.end()) return false;
+    value = *var;
+    break;
+  }
+  case UCIOptionType::Button: break;
+  case UCIOptionType::String: value = new_value == "<empty>" ? "" : new_value; break;
+  }
+  if (on_change && !on_change(*this)) {
+    value = std::move(previous);
+    return false;
+  }
+  return true;
+}
+
+const std::string& UCIOption::name() const
+{
+  return option_name;
+}
+
+UCIOptionType UCIOption::type() const
+{
+  return option_type;
+}
+
+bool UCIOption::asBool() const
+{
+  return value == "true";
+}
+
+int64_t UCIOption::asInt() const
+{
+  int64_t result = 0;
+  std::from_chars(value.data(), value.data() + value.size(), result);
+  return result;
+}
+
+const std::string& UCIOption::asString() const
+{
+  return value;
+}
+
+void UCIConfig::addOption(UCIOption option)
+{
+  options.push_back(std::move(option));
+}
+
+bool UCIConfig::setOption(const std::string& name, const std::string& value)
+{
+  UCIOption* option = findOption(name);
+  if (!option) {
+    SPDLOG_ERROR("UCI: setoption: unknown option \"{}\"", name);
+    return false;
+  }
+  if (!option->set(value)) {
+    SPDLOG_ERROR("UCI: setoption: can't set option \"{}\" to \"{}\"", name, value);
+    return false;
+  }
+  SPDLOG_INFO(
+    "UCI: setoption: \"{}\" set to \"{}\"", option->name(), option->asString());
   return true;
 }
 
+const UCIOption* UCIConfig::getOption(const std::string& name) const
+{
+  return findByName(options, name);
+}
+
+const std::vector<UCIOption>& UCIConfig::getAvailableOptions() const
+{
+  return options;
+}
+
+UCIOption* UCIConfig::findOption(const std::string& name)
+{
+  return findByName(options, name);
+}
+
 } // namespace shepichess
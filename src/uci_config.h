@@ -1,22 +1,72 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
 #include <string>
 #include <vector>
 
 namespace shepichess {
 
+enum class UCIOptionType { Check, Spin, Combo, Button, String };
+
+// A single engine option as advertised in response to "uci".
+//
+// Values are validated against the option type (and bounds for spin options)
+// before being stored, after which the on_change callback is run. A callback
+// returning false rejects the change and the previous value is restored.
 class UCIOption {
 public:
-  inline std::string uciString() { return ""; }
+  using Callback = std::function<bool(const UCIOption&)>;
+
+  static UCIOption check(const std::string& name, bool default_value, Callback = {});
+  static UCIOption spin(
+    const std::string& name,
+    int64_t default_value,
+    int64_t min,
+    int64_t max,
+    Callback = {});
+  static UCIOption combo(
+    const std::string& name,
+    const std::string& default_value,
+    const std::vector<std::string>& vars,
+    Callback = {});
+  static UCIOption button(const std::string& name, Callback);
+  static UCIOption string(
+    const std::string& name, const std::string& default_value, Callback = {});
+
+  [[nodiscard]] std::string uciString() const;
+  bool set(const std::string& value);
+
+  [[nodiscard]] const std::string& name() const;
+  [[nodiscard]] UCIOptionType type() const;
+  [[nodiscard]] bool asBool() const;
+  [[nodiscard]] int64_t asInt() const;
+  [[nodiscard]] const std::string& asString() const;
+
+private:
+  UCIOption(const std::string& name, UCIOptionType type, Callback on_change);
+
+  std::string option_name;
+  UCIOptionType option_type;
+  std::string value;
+  std::string default_value;
+  int64_t min = 0;
+  int64_t max = 0;
+  std::vector<std::string> vars;
+  Callback on_change;
 };
 
 class UCIConfig {
 public:
-  bool setOption(const std::string&, const std::string&);
-  inline std::vector<UCIOption> getAvailableOptions()
-  {
-    return std::vector<UCIOption>();
-  }
+  void addOption(UCIOption option);
+  // Option names are case insensitive, returns false for unknown or invalid values
+  bool setOption(const std::string& name, const std::string& value);
+  [[nodiscard]] const UCIOption* getOption(const std::string& name) const;
+  [[nodiscard]] const std::vector<UCIOption>& getAvailableOptions() const;
+
+private:
+  std::vector<UCIOption> options;
+  UCIOption* findOption(const std::string& name);
 };
 
 } // namespace shepichess
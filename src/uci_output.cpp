@@ -0,0 +1,84 @@
+#include "uci_output.h"
+
+#include "logging.h"
+
+namespace shepichess {
+
+UCIOutput::UCIOutput(std::ostream& out, std::chrono::milliseconds info_interval)
+  : out(out), info_interval(info_interval), last_info(Clock::now() - info_interval)
+{
+}
+
+UCIOutput::~UCIOutput()
+{
+  {
+    std::scoped_lock output_lock(lock);
+    quit = true;
+  }
+  pending_cv.notify_one();
+  if (info_writer.joinable()) info_writer.join();
+}
+
+void UCIOutput::send(const std::string& line)
+{
+  std::scoped_lock output_lock(lock);
+  write(line);
+}
+
+void UCIOutput::sendInfo(const std::string& line)
+{
+  std::scoped_lock output_lock(lock);
+  pending_info = line;
+  Clock::time_point now = Clock::now();
+  if (now - last_info >= info_interval) {
+    writePendingInfo(now);
+    return;
+  }
+  if (!info_writer.joinable()) info_writer = std::thread([this]() { writeHeldInfo(); });
+  pending_cv.notify_one();
+}
+
+void UCIOutput::sendBestMove(const std::string& line)
+{
+  std::scoped_lock output_lock(lock);
+  if (pending_info) writePendingInfo(Clock::now());
+  write(line);
+  out.flush();
+}
+
+void UCIOutput::flush()
+{
+  std::scoped_lock output_lock(lock);
+  out.flush();
+}
+
+void UCIOutput::write(const std::string& line)
+{
+  out << line << '\n';
+  SPDLOG_INFO("OUTPUT: \"{}\"", line);
+}
+
+void UCIOutput::writePendingInfo(Clock::time_point now)
+{
+  write(*pending_info);
+  pending_info.reset();
+  last_info = now;
+}
+
+// Runs on info_writer until destruction
+void UCIOutput::writeHeldInfo()
+{
+  std::unique_lock writer_lock(lock);
+  while (!quit) {
+    if (!pending_info) {
+      pending_cv.wait(writer_lock);
+    } else if (Clock::time_point due = last_info + info_interval; Clock::now() < due) {
+      pending_cv.wait_until(writer_lock, due);
+    } else {
+      writePendingInfo(Clock::now());
+      out.flush();
+    }
+  }
+}
+
+} // namespace shepichess
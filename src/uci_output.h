@@ -0,0 +1,54 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+namespace shepichess {
+
+constexpr std::chrono::milliseconds kDefaultInfoInterval {100};
+
+// Thread-safe writer for everything the engine sends to the GUI.
+//
+// Lines are written without flushing. info lines are rate-limited: lines sent
+// within kDefaultInfoInterval of the last one are coalesced so that only the
+// newest is kept. A background thread, started with the first held line, writes
+// it once the interval has passed, so searching threads never write held lines.
+// bestmove flushes any pending info and then the stream.
+class UCIOutput {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit UCIOutput(std::ostream&, std::chrono::milliseconds = kDefaultInfoInterval);
+  ~UCIOutput();
+
+  UCIOutput(const UCIOutput&) = delete;
+  UCIOutput(UCIOutput&&) = delete;
+  UCIOutput& operator=(const UCIOutput&) = delete;
+  UCIOutput& operator=(UCIOutput&&) = delete;
+
+  void send(const std::string& line);
+  void sendInfo(const std::string& line);
+  void sendBestMove(const std::string& line);
+  void flush();
+
+private:
+  std::ostream& out;
+  std::chrono::milliseconds info_interval;
+  Clock::time_point last_info;
+  std::optional<std::string> pending_info;
+  std::mutex lock;
+  std::condition_variable pending_cv;
+  bool quit = false;
+  std::thread info_writer;
+
+  void write(const std::string& line);
+  void writePendingInfo(Clock::time_point now);
+  void writeHeldInfo();
+};
+
+} // namespace shepichess
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <charconv>
+#include <string_view>
+
+namespace shepichess {
+
+// Splits a UCI command into whitespace separated tokens without copying, the
+// returned views point into the input string.
+class UCITokenizer {
+public:
+  explicit UCITokenizer(std::string_view input) : remaining(input) { skipWhitespace(); }
+
+  // Returns the next token, or an empty view once all tokens are consumed
+  std::string_view next();
+  [[nodiscard]] std::string_view peek() const;
+  // Consumes tokens up to (but not including) keyword and returns them as a single
+  // view, including the whitespace between them
+  std::string_view until(std::string_view keyword);
+  // Everything not yet consumed, without surrounding whitespace
+  [[nodiscard]] std::string_view rest() const;
+  [[nodiscard]] bool done() const { return remaining.empty(); }
+
+  // Parses the next token as a number, returns false (without consuming it) if it
+  // is not one
+  template<typename T>
+  bool nextNumber(T& value);
+
+private:
+  std::string_view remaining;
+
+  static bool isWhitespace(char c)
+  {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+  }
+  void skipWhitespace();
+};
+
+// Implementations for template and inline functions
+
+inline std::string_view UCITokenizer::next()
+{
+  std::string_view token = peek();
+  remaining.remove_prefix(token.size());
+  skipWhitespace();
+  return token;
+}
+
+inline std::string_view UCITokenizer::peek() const
+{
+  size_t end = 0;
+  while (end < remaining.size() && !isWhitespace(remaining[end])) end++;
+  return remaining.substr(0, end);
+}
+
+inline std::string_view UCITokenizer::until(std::string_view keyword)
+{
+  std::string_view start = remaining;
+  size_t length = 0;
+  while (!done() && peek() != keyword) {
+    std::string_view token = next();
+    length = static_cast<size_t>(token.data() + token.size() - start.data());
+  }
+  return start.substr(0, length);
+}
+
+inline std::string_view UCITokenizer::rest() const
+{
+  std::string_view result = remaining;
+  while (!result.empty() && isWhitespace(result.back())) result.remove_suffix(1);
+  return result;
+}
+
+template<typename T>
+bool UCITokenizer::nextNumber(T& value)
+{
+  std::string_view token = peek();
+  const char* end = token.data() + token.size();
+  auto [ptr, error] = std::from_chars(token.data(), end, value);
+  if (token.empty() || error != std::errc() || ptr != end) return false;
+  next();
+  return true;
+}
+
+inline void UCITokenizer::skipWhitespace()
+{
+  while (!remaining.empty() && isWhitespace(remaining.front())) {
+    remaining.remove_prefix(1);
+  }
+}
+
+} // namespace shepichess
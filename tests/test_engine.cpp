@@ -0,0 +1,120 @@
+#include "engine.h"
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "position.h"
+
+using shepichess::Engine;
+using shepichess::HashTablePool;
+
+namespace {
+
+const std::string kFens[] = {
+  shepichess::kStartFen,
+  "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+  "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP2BPPP/R1BQK2R w KQ - 0 8",
+  "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+};
+constexpr int kDepth = 6;
+
+struct SearchResult {
+  std::string best_move;
+  uint64_t nodes = 0;
+
+  bool operator==(const SearchResult& other) const
+  {
+    return best_move == other.best_move && nodes == other.nodes;
+  }
+};
+
+SearchResult searchFen(Engine& engine, const std::string& fen)
+{
+  shepichess::Position position;
+  position.setFen(fen);
+  shepichess::SearchLimits limits;
+  limits.depth = kDepth;
+  limits.start_time = shepichess::SearchLimits::Clock::now();
+  engine.go(position, limits);
+  engine.wait();
+  return {engine.bestMove().uci(), engine.nodes()};
+}
+
+} // namespace
+
+TEST_CASE("Engines search independently in one process", "[engine]")
+{
+  std::stringstream out;
+  std::vector<SearchResult> expected;
+  {
+    Engine engine(out, 1, false);
+    for (auto&& fen : kFens) {
+      engine.newGame();
+      expected.push_back(searchFen(engine, fen));
+    }
+  }
+
+  // Single threaded searches are deterministic, so concurrent engines only match
+  // the sequential results if they don't share any search state
+  HashTablePool pool {1};
+  constexpr int kEngines = 8;
+  std::vector<std::stringstream> outputs(kEngines);
+  std::vector<std::unique_ptr<Engine>> engines;
+  for (auto&& output : outputs) {
+    engines.push_back(std::make_unique<Engine>(output, pool));
+  }
+  std::vector<SearchResult> results(kEngines * std::size(kFens));
+  std::vector<std::thread> workers;
+  for (int i = 0; i < kEngines; i++) {
+    workers.emplace_back([&, i]() {
+      for (size_t fen = 0; fen < std::size(kFens); fen++) {
+        engines[i]->newGame();
+        results[i * std::size(kFens) + fen] = searchFen(*engines[i], kFens[fen]);
+      }
+    });
+  }
+  for (auto&& worker : workers) worker.join();
+  for (size_t i = 0; i < results.size(); i++) {
+    REQUIRE(results[i] == expected[i % std::size(kFens)]);
+  }
+  size_t table_bytes =
+    shepichess::HashTable::entriesFor(1) * sizeof(shepichess::HashEntry);
+  REQUIRE(engines[0]->memoryUsage() > table_bytes);
+}
+
+TEST_CASE("Hash table pool reuses tables", "[engine]")
+{
+  HashTablePool pool {1};
+  std::stringstream out;
+  auto engine = std::make_unique<Engine>(out, pool);
+  REQUIRE(pool.available() == 0);
+  searchFen(*engine, kFens[1]);
+  engine.reset();
+  REQUIRE(pool.available() == 1);
+
+  // Tables come back cleared
+  std::unique_ptr<shepichess::HashTable> table = pool.acquire();
+  REQUIRE(pool.available() == 0);
+  shepichess::Position position;
+  position.setFen(kFens[1]);
+  REQUIRE_FALSE(table->probe(position.zobrist()));
+  table->stash(shepichess::HashEntry {1, 0, 0, position.zobrist()});
+  shepichess::HashTable* address = table.get();
+  pool.release(std::move(table));
+  table = pool.acquire();
+  REQUIRE(table.get() == address);
+  REQUIRE_FALSE(table->probe(position.zobrist()));
+  pool.release(std::move(table));
+
+  // A table resized through the Hash option isn't pooled again
+  engine = std::make_unique<Engine>(out, pool);
+  REQUIRE(pool.available() == 0);
+  REQUIRE(engine->setOption("Hash", "2"));
+  engine.reset();
+  REQUIRE(pool.available() == 0);
+}
@@ -1,6 +1,11 @@
 #include "hash_table.h"
 
+#include <atomic>
+#include <filesystem>
+#include <fstream>
 #include <optional>
+#include <string>
+#include <thread>
 
 #include <catch2/catch_test_macros.hpp>
 
@@ -27,6 +32,37 @@ TEST_CASE("HashTable resize")
   }
 }
 
+TEST_CASE("HashTable keeps its table when resizing fails")
+{
+  shepichess::HashTable tt(1);
+  shepichess::HashEntry entry {5, 100, 0x60, 0xff};
+  tt.stash(entry);
+  size_t size = tt.size();
+  REQUIRE_FALSE(tt.resize(size_t {1} << 40));
+  REQUIRE(tt.size() == size);
+  REQUIRE(tt.probe(0xff));
+}
+
+TEST_CASE("HashTable resizes while being probed")
+{
+  shepichess::HashTable tt(1);
+  std::atomic<bool> done {false};
+  // Catch assertions aren't thread safe, the prober only counts bad entries
+  int bad_entries = 0;
+  std::thread prober([&]() {
+    for (shepichess::HashKey key = 1; !done; key++) {
+      tt.stash(shepichess::HashEntry {1, 2, 3, key});
+      if (auto entry = tt.probe(key); entry && entry->eval() != 2) bad_entries++;
+    }
+  });
+  for (size_t size : {2, 1, 4, 1}) REQUIRE(tt.resize(size));
+  done = true;
+  prober.join();
+  REQUIRE(bad_entries == 0);
+  tt.reclaim();
+  REQUIRE(tt.size() == shepichess::HashTable::entriesFor(1));
+}
+
 TEST_CASE("HashTable probe/stash (no collision)")
 {
   shepichess::HashTable tt(1);
@@ -65,4 +101,76 @@ TEST_CASE("HashTable clear")
   tt.clear();
   result = tt.probe(0xff);
   REQUIRE(result == std::nullopt);
-}
\ No newline at end of file
+}
+namespace {
+
+std::string tempHashFile(const std::string& name)
+{
+  return (std::filesystem::temp_directory_path() / name).string();
+}
+
+} // namespace
+
+TEST_CASE("HashTable save/load")
+{
+  constexpr uint64_t kSeed = 1234;
+  std::string path = tempHashFile("shepichess_test_save_load.hash");
+  shepichess::HashTable tt(1);
+  for (shepichess::HashKey key = 1; key <= 1000; key++) {
+    tt.stash(shepichess::HashEntry {5, 100, 0x60, key * 0x9e37'79b9'7f4a'7c15ULL});
+  }
+  REQUIRE(tt.save(path, kSeed));
+
+  shepichess::HashTable loaded(1);
+  REQUIRE(loaded.load(path, kSeed));
+  for (shepichess::HashKey key = 1; key <= 1000; key++) {
+    REQUIRE(loaded.probe(key * 0x9e37'79b9'7f4a'7c15ULL) != std::nullopt);
+  }
+  // A table of a different size rehashes the entries
+  shepichess::HashTable larger(4);
+  REQUIRE(larger.load(path, kSeed));
+  REQUIRE(larger.probe(0x9e37'79b9'7f4a'7c15ULL)->depth() == 5);
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("HashTable load rejects incompatible files")
+{
+  std::string path = tempHashFile("shepichess_test_incompatible.hash");
+  shepichess::HashTable tt(1);
+  tt.stash(shepichess::HashEntry {5, 100, 0x60, 0xff});
+  REQUIRE(tt.save(path, 1));
+  // Different zobrist seed
+  REQUIRE_FALSE(tt.load(path, 2));
+  REQUIRE(tt.probe(0xff) != std::nullopt);
+  // Truncated file
+  std::filesystem::resize_file(path, 100);
+  REQUIRE_FALSE(tt.load(path, 1));
+  // Not a hash file
+  {
+    std::ofstream file(path, std::ios::trunc);
+    file << std::string(200, 'x');
+  }
+  REQUIRE_FALSE(tt.load(path, 1));
+  REQUIRE_FALSE(tt.load(tempHashFile("shepichess_test_missing.hash"), 1));
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("HashTable load rejects entry counts that overflow")
+{
+  std::string path = tempHashFile("shepichess_test_overflow.hash");
+  shepichess::HashTable tt(1);
+  REQUIRE(tt.save(path, 1));
+  // 2^61 more entries of 24 bytes wrap around to the same byte count
+  {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    constexpr std::streamoff kEntryCountOffset = 24;
+    uint64_t entry_count = 0;
+    file.seekg(kEntryCountOffset);
+    file.read(reinterpret_cast<char*>(&entry_count), sizeof(entry_count));
+    entry_count += uint64_t {1} << 61;
+    file.seekp(kEntryCountOffset);
+    file.write(reinterpret_cast<const char*>(&entry_count), sizeof(entry_count));
+  }
+  REQUIRE_FALSE(tt.load(path, 1));
+  std::filesystem::remove(path);
+}
@@ -0,0 +1,106 @@
+#include "mate_search.h"
+
+#include <string>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "bitboard.h"
+#include "movegen.h"
+
+using shepichess::MateResult;
+using shepichess::MateSearch;
+using shepichess::MateStatus;
+using shepichess::Position;
+
+namespace {
+
+bool neverStop(uint64_t)
+{
+  return false;
+}
+
+std::string pvString(const MateResult& result)
+{
+  std::string pv;
+  for (auto move : result.pv) pv += (pv.empty() ? "" : " ") + move.uci();
+  return pv;
+}
+
+// Plays the PV and checks it ends in checkmate
+bool endsInMate(Position position, const MateResult& result)
+{
+  for (auto move : result.pv) {
+    if (!position.isLegal(move)) return false;
+    position.makeMove(move);
+  }
+  shepichess::MoveList moves;
+  shepichess::generateLegalMoves(position, moves);
+  return moves.empty() && position.inCheck();
+}
+
+} // namespace
+
+TEST_CASE("Mate search proves short mates", "[mate]")
+{
+  shepichess::bitboards::init();
+  MateSearch solver {1};
+  Position position;
+  position.setFen("6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1");
+  MateResult result = solver.solve(position, 1, neverStop);
+  REQUIRE(result.status == MateStatus::Mate);
+  REQUIRE(pvString(result) == "a1a8");
+
+  // The queen sacrifice is the only mate in two
+  const std::string fen = "5rk1/1p1q2bp/p2pN1p1/2pP2Bn/2P3P1/1P6/P4QKP/5R2 w - - 1 1";
+  position.setFen(fen);
+  solver.clear();
+  REQUIRE(solver.solve(position, 1, neverStop).status == MateStatus::NoMate);
+  result = solver.solve(position, 2, neverStop);
+  REQUIRE(result.status == MateStatus::Mate);
+  REQUIRE(pvString(result) == "f2f8 g7f8 f1f8");
+  REQUIRE(result.plies == 3);
+  REQUIRE(position.fen() == fen);
+
+  // The defender delays mate the longest, a quiet queen move keeps the king boxed in
+  position.setFen("8/8/8/8/8/3k4/8/3K3Q w - - 0 1");
+  solver.clear();
+  result = solver.solve(position, 6, neverStop);
+  REQUIRE(result.status == MateStatus::Mate);
+  REQUIRE(result.plies == 11);
+  REQUIRE(result.pv.size() == 11);
+  REQUIRE(endsInMate(position, result));
+}
+
+TEST_CASE("Mate search disproves mates", "[mate]")
+{
+  shepichess::bitboards::init();
+  MateSearch solver {1};
+  Position position;
+  position.setStartPosition();
+  REQUIRE(solver.solve(position, 3, neverStop).status == MateStatus::NoMate);
+
+  // Stalemating isn't mating, and the side to move can't mate when mated itself
+  position.setFen("7k/8/6Q1/8/8/8/8/6K1 w - - 0 1");
+  REQUIRE(solver.solve(position, 1, neverStop).status == MateStatus::NoMate);
+  position.setFen("7k/5Q2/6K1/8/8/8/8/8 b - - 0 1");
+  REQUIRE(solver.solve(position, 1, neverStop).status == MateStatus::NoMate);
+  // Only mates within the limit count
+  position.setFen("8/8/8/8/8/3k4/8/3K3Q w - - 0 1");
+  REQUIRE(solver.solve(position, 3, neverStop).status == MateStatus::NoMate);
+}
+
+TEST_CASE("Mate search stops when asked", "[mate]")
+{
+  shepichess::bitboards::init();
+  MateSearch solver {1};
+  Position position;
+  position.setStartPosition();
+  uint64_t checked = 0;
+  MateResult result = solver.solve(position, 5, [&checked](uint64_t nodes) {
+    checked = nodes;
+    return true;
+  });
+  REQUIRE(result.status == MateStatus::Stopped);
+  REQUIRE(checked > 0);
+  REQUIRE(solver.nodes() < 2 * checked);
+}
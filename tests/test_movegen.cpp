@@ -0,0 +1,123 @@
+#include "movegen.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "bitboard.h"
+#include "cpu.h"
+#include "eval.h"
+#include "position.h"
+
+using shepichess::Bitboard;
+using shepichess::PieceType;
+using shepichess::Position;
+
+namespace {
+
+// Known perft results, see https://www.chessprogramming.org/Perft_Results
+struct PerftCase {
+  const char* fen;
+  int depth;
+  uint64_t nodes;
+};
+
+constexpr PerftCase kPerftCases[] = {
+  {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 4, 197281},
+  {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 3, 97862},
+  {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, 674624},
+  {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4, 422333},
+  {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 3, 62379},
+  {"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+   3,
+   89890},
+};
+
+} // namespace
+
+TEST_CASE("movegen perft", "[movegen]")
+{
+  shepichess::bitboards::init();
+  Position position;
+  for (auto&& perft_case : kPerftCases) {
+    REQUIRE(position.setFen(perft_case.fen));
+    CAPTURE(perft_case.fen);
+    REQUIRE(shepichess::perft(position, perft_case.depth) == perft_case.nodes);
+    // Making and unmaking every move must restore the position
+    REQUIRE(position.fen() == perft_case.fen);
+  }
+}
+
+TEST_CASE("movegen captures only", "[movegen]")
+{
+  shepichess::bitboards::init();
+  Position position;
+  REQUIRE(position.setFen("4k3/8/8/3p4/4P3/8/8/4K3 w - - 0 1"));
+  shepichess::MoveList captures;
+  shepichess::generateMoves<shepichess::MoveGenType::Captures>(position, captures);
+  REQUIRE(captures.size() == 1);
+  REQUIRE(captures[0].uci() == "e4d5");
+}
+
+TEST_CASE("movegen parseUCIMove", "[movegen]")
+{
+  shepichess::bitboards::init();
+  Position position;
+  REQUIRE(shepichess::parseUCIMove(position, "e2e4").uci() == "e2e4");
+  REQUIRE(shepichess::parseUCIMove(position, "e2e5").isNull());
+  REQUIRE(shepichess::parseUCIMove(position, "").isNull());
+  REQUIRE(position.setFen("4k3/1P6/8/8/8/8/8/4K2R w K - 0 1"));
+  REQUIRE(shepichess::parseUCIMove(position, "b7b8n").isPromotion());
+  REQUIRE(shepichess::parseUCIMove(position, "e1g1").isCastle());
+}
+
+TEST_CASE("movegen moveToSAN", "[movegen]")
+{
+  shepichess::bitboards::init();
+  Position position;
+  auto san = [&](std::string_view uci) {
+    return shepichess::moveToSAN(position, shepichess::parseUCIMove(position, uci));
+  };
+  REQUIRE(san("e2e4") == "e4");
+  REQUIRE(san("g1f3") == "Nf3");
+  // Knights on b1 and f3 can both reach d2, rooks on a1 and a5 both reach a3
+  REQUIRE(position.setFen("4k3/8/8/R7/3p4/5N2/8/RN2K3 w - - 0 1"));
+  REQUIRE(san("b1d2") == "Nbd2");
+  REQUIRE(san("a1a3") == "R1a3");
+  REQUIRE(san("f3d4") == "Nxd4");
+  REQUIRE(san("e1d2") == "Kd2");
+  REQUIRE(position.setFen("r3k3/1P6/8/8/8/8/8/4K2R w K - 0 1"));
+  REQUIRE(san("b7a8q") == "bxa8=Q+");
+  REQUIRE(san("e1g1") == "O-O");
+  REQUIRE(position.setFen("6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1"));
+  REQUIRE(san("a1a8") == "Ra8#");
+}
+
+TEST_CASE("movegen and slider attacks agree at every cpu level", "[movegen]")
+{
+  using shepichess::CpuLevel;
+  shepichess::bitboards::init();
+  CpuLevel detected = shepichess::detectCpuLevel();
+  REQUIRE(shepichess::cpuLevel() == detected);
+  if (detected != CpuLevel::AVX2) {
+    REQUIRE_FALSE(shepichess::setCpuLevel(CpuLevel::AVX2));
+  }
+
+  Position position;
+  REQUIRE(position.setFen(kPerftCases[1].fen));
+  int expected_eval = shepichess::evaluate(position);
+  Bitboard occupancy = position.occupied();
+  Bitboard rooks = position.piecesByType(shepichess::Color::White, PieceType::Rook);
+  Bitboard bishops = position.piecesByType(shepichess::Color::White, PieceType::Bishop);
+  Bitboard expected_attacks =
+    shepichess::attack_maps::rookAttacksSetwise(rooks, occupancy) |
+    shepichess::attack_maps::bishopAttacksSetwise(bishops, occupancy);
+  for (int level = 0; level <= static_cast<int>(detected); level++) {
+    CAPTURE(level);
+    REQUIRE(shepichess::setCpuLevel(static_cast<CpuLevel>(level)));
+    REQUIRE(shepichess::perft(position, 3) == kPerftCases[1].nodes);
+    REQUIRE(shepichess::evaluate(position) == expected_eval);
+    REQUIRE(
+      shepichess::attack_maps::sliderAttacks(rooks, bishops, occupancy) ==
+      expected_attacks);
+  }
+  REQUIRE(shepichess::setCpuLevel(detected));
+}
@@ -0,0 +1,176 @@
+#include "pgn.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "bitboard.h"
+#include "movegen.h"
+#include "position.h"
+
+using shepichess::Move;
+using shepichess::Position;
+
+namespace {
+
+const std::string kGames =
+  "[Event \"Scholar\"]\n"
+  "[Site \"?\"]\n"
+  "\n"
+  "[Result \"1-0\"]\n"
+  "\n"
+  "1. e4 e5 {a comment (with parentheses)} 2. Bc4 (2. Nf3 Nc6 (2... d6) 3. Bb5)\n"
+  "2... Nc6 $1 3.Qh5 Nf6?? ; the losing move\n"
+  "4. Qxf7# 1-0\n"
+  "\n"
+  "[Event \"Endgame\"]\n"
+  "[FEN \"8/P7/8/8/8/8/k7/4K2R w K - 0 1\"]\n"
+  "[SetUp \"1\"]\n"
+  "\n"
+  "1. O-O Kb2 2. a8Q Kc2 3. Qa4+ *\n"
+  "\n"
+  "[Event \"Broken\"]\n"
+  "\n"
+  "1. e4 e5 2. Ke3 Nc6 *\n";
+
+const std::string kScholarFen =
+  "r1bqkb1r/pppp1Qpp/2n2n2/4p3/2B1P3/8/PPPP1PPP/RNB1K1NR b KQkq - 0 4";
+
+std::vector<std::string> replayFens(std::string_view game, bool& legal)
+{
+  Position position;
+  std::vector<std::string> fens;
+  legal = shepichess::replayPgnGame(
+    game, position, [&fens](const Position& current, int ply) {
+      if (ply == static_cast<int>(fens.size())) fens.push_back(current.fen());
+    });
+  return fens;
+}
+
+void checkSANRoundTrip(Position& position, int depth)
+{
+  shepichess::MoveList moves;
+  shepichess::generateLegalMoves(position, moves);
+  for (Move move : moves) {
+    std::string san = shepichess::moveToSAN(position, move);
+    REQUIRE(shepichess::parseSAN(position, san) == move);
+    if (depth > 1) {
+      position.makeMove(move);
+      checkSANRoundTrip(position, depth - 1);
+      position.unmakeMove();
+    }
+  }
+}
+
+} // namespace
+
+TEST_CASE("SAN parsing", "[pgn]")
+{
+  shepichess::bitboards::init();
+  Position position;
+  position.setFen(
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+  checkSANRoundTrip(position, 3);
+  position.setFen("n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1");
+  checkSANRoundTrip(position, 3);
+
+  position.setStartPosition();
+  REQUIRE(shepichess::parseSAN(position, "Nf3!?").uci() == "g1f3");
+  REQUIRE(shepichess::parseSAN(position, "e4").uci() == "e2e4");
+  REQUIRE(shepichess::parseSAN(position, "Ke2").isNull());
+  REQUIRE(shepichess::parseSAN(position, "e5").isNull());
+  REQUIRE(shepichess::parseSAN(position, "Nz3").isNull());
+  REQUIRE(shepichess::parseSAN(position, "").isNull());
+
+  // Promotions without '=', castling with zeros and ambiguous moves
+  position.setFen("8/P7/8/8/8/8/k7/4K2R w K - 0 1");
+  REQUIRE(shepichess::parseSAN(position, "a8N").uci() == "a7a8n");
+  REQUIRE(shepichess::parseSAN(position, "a8=Q+").uci() == "a7a8q");
+  REQUIRE(shepichess::parseSAN(position, "a8").isNull());
+  REQUIRE(shepichess::parseSAN(position, "0-0").uci() == "e1g1");
+  position.setFen("4k3/8/8/8/8/8/4K3/R6R w - - 0 1");
+  REQUIRE(shepichess::parseSAN(position, "Rd1").isNull());
+  REQUIRE(shepichess::parseSAN(position, "Rad1").uci() == "a1d1");
+}
+
+TEST_CASE("PGN games are split and replayed", "[pgn]")
+{
+  shepichess::bitboards::init();
+  std::vector<size_t> games = shepichess::splitPgnGames(kGames);
+  REQUIRE(games.size() == 3);
+  REQUIRE(games[0] == 0);
+  REQUIRE(kGames.compare(games[1], 16, "[Event \"Endgame\"") == 0);
+  REQUIRE(kGames.compare(games[2], 15, "[Event \"Broken\"") == 0);
+  // Chunk boundaries fall inside games and tag sections
+  for (int threads = 2; threads <= 16; threads++) {
+    REQUIRE(shepichess::splitPgnGames(kGames, threads) == games);
+  }
+  REQUIRE(shepichess::splitPgnGames("1. e4 e5 *").size() == 1);
+  REQUIRE(shepichess::splitPgnGames(" \n\n").empty());
+
+  bool legal = false;
+  std::string_view text = kGames;
+  auto scholar = replayFens(text.substr(0, games[1]), legal);
+  REQUIRE(legal);
+  REQUIRE(scholar.size() == 8);
+  REQUIRE(scholar.front() == shepichess::kStartFen);
+  REQUIRE(scholar.back() == kScholarFen);
+
+  auto endgame = replayFens(text.substr(games[1], games[2] - games[1]), legal);
+  REQUIRE(legal);
+  REQUIRE(endgame.size() == 6);
+  REQUIRE(endgame.back() == "8/8/8/8/Q7/8/2k5/5RK1 b - - 2 3");
+
+  // Positions before the illegal move are still visited
+  auto broken = replayFens(text.substr(games[2]), legal);
+  REQUIRE_FALSE(legal);
+  REQUIRE(broken.size() == 3);
+}
+
+TEST_CASE("PGN index", "[pgn]")
+{
+  shepichess::bitboards::init();
+  std::string pgn_path = "pgn_index_test.pgn", index_path = "pgn_index_test.idx";
+  std::ofstream(pgn_path, std::ios::binary) << kGames << kGames;
+  shepichess::PgnIndexStats stats;
+  REQUIRE(shepichess::buildPgnIndex(pgn_path, index_path, 3, stats));
+  REQUIRE(stats.games == 6);
+  REQUIRE(stats.bad_games == 2);
+  REQUIRE(stats.positions == 2 * (8 + 6 + 3));
+
+  shepichess::PgnIndex index;
+  REQUIRE(index.open(index_path));
+  REQUIRE(index.games() == 6);
+  REQUIRE(index.positions() == stats.positions);
+  Position position;
+  position.setStartPosition();
+  // The start position, then after 1. e4 e5 in the scholar and broken games
+  auto records = index.find(position.zobrist());
+  REQUIRE(records.size() == 4);
+  position.setFen("rnbqkbnr/pppp1ppp/8/4p3/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2");
+  records = index.find(position.zobrist());
+  REQUIRE(records.size() == 4);
+  std::vector<uint32_t> found_games;
+  for (auto&& record : records) {
+    REQUIRE(record.ply == 2);
+    found_games.push_back(record.game);
+  }
+  REQUIRE(found_games == std::vector<uint32_t> {0, 2, 3, 5});
+  REQUIRE(index.gameOffset(3) == kGames.size());
+
+  position.setFen(kScholarFen);
+  records = index.find(position.zobrist());
+  REQUIRE(records.size() == 2);
+  REQUIRE(records[0].ply == 7);
+  position.setFen("4k3/8/8/8/8/8/8/4K3 w - - 0 1");
+  REQUIRE(index.find(position.zobrist()).empty());
+
+  // Files that aren't an index are rejected
+  index.close();
+  REQUIRE_FALSE(index.open(pgn_path));
+  std::remove(pgn_path.c_str());
+  std::remove(index_path.c_str());
+}
@@ -0,0 +1,255 @@
+#include "position.h"
+
+#include <string>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "bitboard.h"
+#include "movegen.h"
+
+using shepichess::Color, shepichess::HashKey, shepichess::Piece, shepichess::Position;
+
+TEST_CASE("Position FEN round trip", "[position]")
+{
+  constexpr const char* kFens[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+    "8/8/8/8/8/8/8/K6k b - - 99 150",
+  };
+  Position position;
+  for (auto&& fen : kFens) {
+    REQUIRE(position.setFen(fen));
+    REQUIRE(position.fen() == fen);
+  }
+}
+
+TEST_CASE("Position rejects invalid FEN", "[position]")
+{
+  Position position;
+  REQUIRE_FALSE(position.setFen(""));
+  REQUIRE_FALSE(position.setFen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP w KQkq - 0 1"));
+  REQUIRE_FALSE(
+    position.setFen("rnbqkbnr/pppppppp/9/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"));
+  REQUIRE_FALSE(
+    position.setFen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR x KQkq - 0 1"));
+  // Exactly one king per side
+  REQUIRE_FALSE(position.setFen("8/8/8/8/8/8/8/8 w - - 0 1"));
+  REQUIRE_FALSE(position.setFen("4k3/8/8/8/8/8/8/8 w - - 0 1"));
+  REQUIRE_FALSE(position.setFen("4k3/8/8/8/8/8/8/3KK3 w - - 0 1"));
+  // The side not to move is in check, by a slider, knight and pawn
+  REQUIRE_FALSE(position.setFen("4k3/8/8/8/4R3/8/8/4K3 w - - 0 1"));
+  REQUIRE_FALSE(position.setFen("4k3/8/3N4/8/8/8/8/4K3 w - - 0 1"));
+  REQUIRE_FALSE(position.setFen("4k3/8/8/8/8/8/3p4/4K3 b - - 0 1"));
+  // The position is left unchanged
+  REQUIRE(position.fen() == shepichess::kStartFen);
+}
+
+TEST_CASE("Position drops castling rights without a king and rook", "[position]")
+{
+  Position position;
+  REQUIRE(position.setFen("r3k3/8/8/8/8/8/8/1R2K2R w KQkq - 0 1"));
+  REQUIRE(position.fen() == "r3k3/8/8/8/8/8/8/1R2K2R w Kq - 0 1");
+  REQUIRE(position.setFen("r3k2r/8/8/8/8/8/8/R2K3R w KQkq - 0 1"));
+  REQUIRE(position.fen() == "r3k2r/8/8/8/8/8/8/R2K3R w kq - 0 1");
+  // Without the rights there are no castling moves to generate
+  shepichess::MoveList moves;
+  shepichess::generateLegalMoves(position, moves);
+  for (auto move : moves) REQUIRE_FALSE(move.isCastle());
+}
+
+TEST_CASE("Position make/unmake", "[position]")
+{
+  shepichess::bitboards::init();
+  Position position;
+  HashKey start_key = position.zobrist();
+  for (const char* uci : {"e2e4", "d7d5", "e4d5", "d8d5", "b1c3"}) {
+    position.makeMove(shepichess::parseUCIMove(position, uci));
+  }
+  REQUIRE(
+    position.fen() == "rnb1kbnr/ppp1pppp/8/3q4/8/2N5/PPPP1PPP/R1BQKBNR b KQkq - 1 3");
+  REQUIRE(position.pieceOn(shepichess::parseSquare("d5")) == Piece::BlackQueen);
+  REQUIRE(position.sideToMove() == Color::Black);
+  // Incremental zobrist key matches one computed from scratch
+  Position copy;
+  copy.setFen(position.fen());
+  REQUIRE(copy.zobrist() == position.zobrist());
+  for (int i = 0; i < 5; i++) position.unmakeMove();
+  REQUIRE(position.fen() == shepichess::kStartFen);
+  REQUIRE(position.zobrist() == start_key);
+}
+
+TEST_CASE("Position en passant is only set when capturable", "[position]")
+{
+  shepichess::bitboards::init();
+  Position position;
+  position.makeMove(shepichess::parseUCIMove(position, "e2e4"));
+  REQUIRE(position.state().enpassant_square == shepichess::kNoSquare);
+  position.setFen("4k3/8/8/8/3p4/8/4P3/4K3 w - - 0 1");
+  position.makeMove(shepichess::parseUCIMove(position, "e2e4"));
+  REQUIRE(position.state().enpassant_square == shepichess::parseSquare("e3"));
+  Position copy;
+  copy.setFen(position.fen());
+  REQUIRE(copy.zobrist() == position.zobrist());
+}
+
+TEST_CASE("Position check and draw detection", "[position]")
+{
+  shepichess::bitboards::init();
+  Position position;
+  REQUIRE(position.setFen("4k3/8/8/8/8/8/8/4K2R b - - 0 1"));
+  REQUIRE_FALSE(position.inCheck());
+  REQUIRE(position.setFen("4k2R/8/8/8/8/8/8/4K3 b - - 0 1"));
+  REQUIRE(position.inCheck());
+  position.setStartPosition();
+  for (const char* uci : {"g1f3", "g8f6", "f3g1", "f6g8"}) {
+    REQUIRE_FALSE(position.isDraw());
+    position.makeMove(shepichess::parseUCIMove(position, uci));
+  }
+  REQUIRE(position.isDraw());
+}
+
+TEST_CASE("Position upcoming repetition detection", "[position]")
+{
+  shepichess::bitboards::init();
+  Position position;
+  REQUIRE(position.setFen("4k3/8/8/8/8/8/8/R3K3 w - - 0 1"));
+  for (const char* uci : {"a1a2", "e8d8", "a2a1"}) {
+    position.makeMove(shepichess::parseUCIMove(position, uci));
+  }
+  // Black can play d8e8 to repeat the start position
+  REQUIRE(position.hasUpcomingRepetition(4));
+  // The cycle started before the search root
+  REQUIRE_FALSE(position.hasUpcomingRepetition(3));
+  // Black's king moves no longer cancel out
+  position.makeMove(shepichess::parseUCIMove(position, "d8d7"));
+  REQUIRE_FALSE(position.hasUpcomingRepetition(5));
+  // The halfmove clock counts moves from before the FEN, which aren't known
+  REQUIRE(position.setFen("4k3/8/8/8/8/8/8/R3K3 w - - 20 1"));
+  REQUIRE_FALSE(position.hasUpcomingRepetition(10));
+}
+
+TEST_CASE("Position upcoming repetition needs a clear path", "[position]")
+{
+  shepichess::bitboards::init();
+  constexpr const char* kMoves[] = {
+    "e8d8", "a1b1", "d8d7", "b1b3", "d7e7", "b3a3", "e7e8"};
+  Position position;
+  // The rook went around, and can return to a1 in one move
+  REQUIRE(position.setFen("4k3/8/8/8/8/8/8/R6K b - - 0 1"));
+  for (const char* uci : kMoves) {
+    position.makeMove(shepichess::parseUCIMove(position, uci));
+  }
+  REQUIRE(position.hasUpcomingRepetition(8));
+  // The king on a2 blocks the rook
+  REQUIRE(position.setFen("4k3/8/8/8/8/8/K7/R7 b - - 0 1"));
+  for (const char* uci : kMoves) {
+    position.makeMove(shepichess::parseUCIMove(position, uci));
+  }
+  REQUIRE_FALSE(position.hasUpcomingRepetition(8));
+}
+
+TEST_CASE("Position keeps a fixed size history", "[position]")
+{
+  shepichess::bitboards::init();
+  Position position;
+  constexpr const char* kShuffle[] = {"g1f3", "g8f6", "f3g1", "f6g8"};
+  for (int i = 0; i < shepichess::kHistorySize + 10; i++) {
+    position.makeMove(shepichess::parseUCIMove(position, kShuffle[i % 4]));
+  }
+  REQUIRE(position.gamePly() == shepichess::kHistorySize + 10);
+  REQUIRE(position.undoablePlies() == shepichess::kHistorySize - 1);
+  while (position.undoablePlies() > 0) position.unmakeMove();
+  REQUIRE(position.gamePly() == 11);
+  REQUIRE(
+    position.fen() == "rnbqkb1r/pppppppp/5n2/8/8/8/PPPPPPPP/RNBQKBNR b KQkq - 11 6");
+}
+
+TEST_CASE("Position null move", "[position]")
+{
+  shepichess::bitboards::init();
+  Position position;
+  REQUIRE(position.setFen("4k3/3p4/8/4P3/8/8/8/4K3 b - - 0 1"));
+  position.makeMove(shepichess::parseUCIMove(position, "d7d5"));
+  std::string fen = position.fen();
+  HashKey hash = position.zobrist();
+  position.makeNullMove();
+  REQUIRE(position.sideToMove() == Color::Black);
+  REQUIRE(position.fen() == "4k3/8/8/3pP3/8/8/8/4K3 b - - 1 2");
+  REQUIRE(position.zobrist() != hash);
+  position.unmakeNullMove();
+  REQUIRE(position.fen() == fen);
+  REQUIRE(position.zobrist() == hash);
+}
+
+TEST_CASE("Position repetitions don't span a null move", "[position]")
+{
+  shepichess::bitboards::init();
+  Position position;
+  // The start position is reached again, but only through two null moves
+  position.makeNullMove();
+  position.makeMove(shepichess::parseUCIMove(position, "g8f6"));
+  position.makeNullMove();
+  position.makeMove(shepichess::parseUCIMove(position, "f6g8"));
+  REQUIRE(
+    position.fen() == "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 4 3");
+  REQUIRE_FALSE(position.isDraw());
+  REQUIRE_FALSE(position.hasUpcomingRepetition(4));
+}
+
+namespace {
+
+// Walks the move tree checking the cached attack information against a position
+// set up from scratch, and isLegal against making the move
+void checkAttackCache(Position& position, int depth)
+{
+  Position fresh;
+  REQUIRE(fresh.setFen(position.fen()));
+  const shepichess::PositionState& cached = position.state();
+  REQUIRE(cached.checkers == fresh.state().checkers);
+  REQUIRE(cached.king_blockers == fresh.state().king_blockers);
+  REQUIRE(cached.check_squares == fresh.state().check_squares);
+  if (depth == 0) return;
+  shepichess::MoveList moves;
+  shepichess::generateMoves<shepichess::MoveGenType::All>(position, moves);
+  Color us = position.sideToMove();
+  for (shepichess::Move move : moves) {
+    position.makeMove(move);
+    bool legal = !position.isSquareAttacked(position.kingSquare(us), ~us);
+    if (legal) checkAttackCache(position, depth - 1);
+    position.unmakeMove();
+    CAPTURE(position.fen(), move.uci());
+    REQUIRE(position.isLegal(move) == legal);
+  }
+}
+
+} // namespace
+
+TEST_CASE("Position caches checkers, pins and check squares", "[position]")
+{
+  shepichess::bitboards::init();
+  Position position;
+  // The e4 knight is pinned by the e8 rook, the c3 bishop checks
+  REQUIRE(position.setFen("4r1k1/8/8/8/4N3/2b5/8/4K3 w - - 0 1"));
+  const shepichess::PositionState& state = position.state();
+  REQUIRE(state.checkers == shepichess::bitboards::fromSquare(21));
+  REQUIRE(state.king_blockers[0] == shepichess::bitboards::fromSquare(27));
+  REQUIRE(state.check_squares[shepichess::index(shepichess::PieceType::King)] == 0);
+  // The pinned knight can't block the check
+  using shepichess::Move, shepichess::MoveFlag;
+  REQUIRE_FALSE(position.isLegal(Move {27, 12, MoveFlag::Quiet}));
+  REQUIRE(position.isLegal(Move {3, 11, MoveFlag::Quiet}));
+
+  // Discovered checks, en passant, castling, promotions and pins
+  for (const char* fen :
+       {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8"}) {
+    REQUIRE(position.setFen(fen));
+    checkAttackCache(position, 3);
+  }
+  // The null move only swaps the side the check squares are for
+  position.makeNullMove();
+  checkAttackCache(position, 1);
+}
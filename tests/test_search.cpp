@@ -0,0 +1,267 @@
+#include "search.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
+
+#include "bitboard.h"
+#include "movegen.h"
+
+using namespace std::chrono_literals;
+using Catch::Matchers::Contains;
+
+// Counts heap allocations made by the node search through the global operator
+// new while enabled
+namespace {
+
+std::atomic<bool> count_allocations {false};
+std::atomic<size_t> allocation_count {0};
+
+} // namespace
+
+void* operator new(size_t size)
+{
+  if (count_allocations.load(std::memory_order_relaxed) && shepichess::inNodeSearch()) {
+    allocation_count++;
+  }
+  if (void* memory = std::malloc(size ? size : 1)) return memory;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+  std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+  std::free(memory);
+}
+
+namespace {
+
+struct SearchFixture {
+  shepichess::ThreadPool threads {1};
+  shepichess::HashTable tt {1};
+  std::stringstream out;
+  shepichess::UCIOutput output {out};
+  shepichess::Search search {threads, tt, output};
+  shepichess::Position position;
+
+  SearchFixture() { shepichess::bitboards::init(); }
+  shepichess::Move run(const shepichess::SearchLimits& limits)
+  {
+    search.start(position, limits);
+    search.wait();
+    return search.bestMove();
+  }
+};
+
+} // namespace
+
+TEST_CASE("Search finds mate in one", "[search]")
+{
+  SearchFixture fixture;
+  fixture.position.setFen("6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1");
+  shepichess::SearchLimits limits;
+  limits.depth = 3;
+  limits.start_time = shepichess::SearchLimits::Clock::now();
+  REQUIRE(fixture.run(limits).uci() == "a1a8");
+  REQUIRE_THAT(
+    fixture.out.str(), Contains("score mate 1") && Contains("bestmove a1a8"));
+}
+
+TEST_CASE("Search solves go mate", "[search]")
+{
+  SearchFixture fixture;
+  fixture.position.setFen(
+    "r1b1kb1r/pppp1ppp/5q2/4n3/3KP3/2N3PN/PPP4P/R1BQ1B1R b kq - 0 1");
+  shepichess::SearchLimits limits;
+  limits.mate = 4;
+  limits.start_time = shepichess::SearchLimits::Clock::now();
+  REQUIRE(fixture.run(limits).uci() == "f8c5");
+  REQUIRE(fixture.search.score() == shepichess::kMateScore - 5);
+  REQUIRE_THAT(
+    fixture.out.str(),
+    Contains("score mate 3") && Contains("bestmove f8c5 ponder d4c5"));
+
+  fixture.out.str("");
+  fixture.position.setStartPosition();
+  limits.mate = 2;
+  // A move is still played without a mate, also when stopped by the limits
+  REQUIRE_FALSE(fixture.run(limits).isNull());
+  REQUIRE_THAT(fixture.out.str(), Contains("no mate in 2") && !Contains("0000"));
+  limits.mate = 10;
+  limits.nodes = 1;
+  REQUIRE_FALSE(fixture.run(limits).isNull());
+}
+
+TEST_CASE("Search respects searchmoves and node limits", "[search]")
+{
+  SearchFixture fixture;
+  shepichess::SearchLimits limits;
+  limits.nodes = 5000;
+  limits.search_moves.push_back(shepichess::parseUCIMove(fixture.position, "a2a3"));
+  limits.start_time = shepichess::SearchLimits::Clock::now();
+  REQUIRE(fixture.run(limits).uci() == "a2a3");
+  REQUIRE(fixture.search.nodes() < 5000 + 1024);
+}
+
+TEST_CASE("Search reports no move when there is none", "[search]")
+{
+  SearchFixture fixture;
+  fixture.position.setFen("7k/5Q2/6K1/8/8/8/8/8 b - - 0 1");
+  shepichess::SearchLimits limits;
+  limits.depth = 2;
+  REQUIRE(fixture.run(limits).isNull());
+  REQUIRE_THAT(fixture.out.str(), Contains("bestmove 0000"));
+}
+
+TEST_CASE("Search start latency", "[search]")
+{
+  SearchFixture fixture;
+  shepichess::SearchLimits limits;
+  limits.depth = 1;
+  // Warm up the pool once, then measure go -> search start on an idle pool
+  fixture.run(limits);
+  limits.start_time = shepichess::SearchLimits::Clock::now();
+  fixture.run(limits);
+  REQUIRE(fixture.search.startLatency() < 10ms);
+}
+
+TEST_CASE("Search reports MultiPV lines", "[search]")
+{
+  SearchFixture fixture;
+  fixture.position.setFen("6k1/5ppp/8/8/8/8/5PPP/R5K1 w - - 0 1");
+  shepichess::SearchLimits limits;
+  limits.depth = 3;
+  limits.multi_pv = 3;
+  limits.start_time = shepichess::SearchLimits::Clock::now();
+  REQUIRE(fixture.run(limits).uci() == "a1a8");
+  std::string out = fixture.out.str();
+  REQUIRE_THAT(
+    out,
+    Contains("depth 3 seldepth") && Contains("multipv 1 score mate 1 ") &&
+      Contains("multipv 2 ") && Contains("multipv 3 ") && !Contains("multipv 4"));
+  // Each line has a different first move
+  std::istringstream lines(out);
+  std::set<std::string> first_moves;
+  for (std::string line; std::getline(lines, line);) {
+    if (line.find("depth 3 ") == std::string::npos) continue;
+    std::string pv = line.substr(line.find(" pv ") + 4);
+    first_moves.insert(pv.substr(0, pv.find(' ')));
+  }
+  REQUIRE(first_moves.size() == 3);
+}
+
+TEST_CASE("Search limits MultiPV to the number of moves", "[search]")
+{
+  SearchFixture fixture;
+  fixture.position.setFen("7k/8/8/8/8/8/8/K7 w - - 0 1");
+  shepichess::SearchLimits limits;
+  limits.depth = 2;
+  limits.multi_pv = 10;
+  limits.start_time = shepichess::SearchLimits::Clock::now();
+  fixture.run(limits);
+  REQUIRE_THAT(fixture.out.str(), Contains("multipv 3 ") && !Contains("multipv 4"));
+}
+
+TEST_CASE("Search doesn't allocate per node", "[search]")
+{
+  SearchFixture fixture;
+  fixture.position.setFen(
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP2BPPP/R1BQK2R w KQ - 0 8");
+  shepichess::SearchLimits limits;
+  limits.depth = 6;
+  limits.start_time = shepichess::SearchLimits::Clock::now();
+  // The first search sizes the root move list
+  fixture.run(limits);
+  fixture.out.str("");
+  fixture.tt.clear();
+  allocation_count = 0;
+  count_allocations = true;
+  fixture.run(limits);
+  count_allocations = false;
+  // Reporting and sorting the root moves between iterations may allocate, the
+  // nodes below never do
+  REQUIRE(fixture.search.nodes() > 10000);
+  REQUIRE(allocation_count == 0);
+
+  // Runs well past the info interval, with the fast early iterations' lines held
+  // back while later ones are searched
+  limits.depth = 0;
+  limits.move_time = 500;
+  limits.start_time = shepichess::SearchLimits::Clock::now();
+  count_allocations = true;
+  fixture.run(limits);
+  count_allocations = false;
+  REQUIRE(allocation_count == 0);
+}
+
+TEST_CASE("Search ponders until ponderhit", "[search]")
+{
+  SearchFixture fixture;
+  shepichess::SearchLimits limits;
+  limits.ponder = true;
+  limits.move_time = 50;
+  limits.start_time = shepichess::SearchLimits::Clock::now();
+  fixture.search.start(fixture.position, limits);
+  // Time limits don't apply while pondering
+  std::this_thread::sleep_for(200ms);
+  REQUIRE_THAT(fixture.out.str(), !Contains("bestmove"));
+  uint64_t nodes = fixture.search.nodes();
+  REQUIRE(nodes > 0);
+  // The search continues, with the move time counting from ponderhit
+  auto ponderhit_time = shepichess::SearchLimits::Clock::now();
+  fixture.search.ponderhit();
+  fixture.search.wait();
+  REQUIRE(shepichess::SearchLimits::Clock::now() - ponderhit_time < 500ms);
+  REQUIRE(fixture.search.nodes() > nodes);
+  REQUIRE_THAT(fixture.out.str(), Contains("bestmove") && Contains(" ponder "));
+}
+
+TEST_CASE("Search stops pondering on a ponder miss", "[search]")
+{
+  SearchFixture fixture;
+  shepichess::SearchLimits limits;
+  limits.ponder = true;
+  limits.start_time = shepichess::SearchLimits::Clock::now();
+  fixture.search.start(fixture.position, limits);
+  std::this_thread::sleep_for(50ms);
+  auto stop_time = shepichess::SearchLimits::Clock::now();
+  fixture.search.stop();
+  fixture.search.wait();
+  REQUIRE(shepichess::SearchLimits::Clock::now() - stop_time < 50ms);
+  REQUIRE_THAT(fixture.out.str(), Contains("bestmove"));
+}
+
+TEST_CASE("Search selectivity keeps tactics and saves nodes", "[search]")
+{
+  SearchFixture fixture;
+  // Scholar's mate is still found with every pruning technique enabled
+  fixture.position.setFen(
+    "r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 4 4");
+  shepichess::SearchLimits limits;
+  limits.depth = 6;
+  limits.start_time = shepichess::SearchLimits::Clock::now();
+  REQUIRE(fixture.run(limits).uci() == "h5f7");
+  REQUIRE_THAT(fixture.out.str(), Contains("score mate 1"));
+
+  fixture.position.setStartPosition();
+  fixture.tt.clear();
+  fixture.run(limits);
+  uint64_t selective_nodes = fixture.search.nodes();
+  fixture.search.setParams(shepichess::SearchParams {
+    false, false, false, false, false, false});
+  fixture.tt.clear();
+  fixture.run(limits);
+  REQUIRE(selective_nodes < fixture.search.nodes());
+}
@@ -0,0 +1,130 @@
+#include "selfplay.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
+
+#include "position.h"
+
+using Catch::Matchers::Contains;
+using shepichess::MatchScore;
+using shepichess::SelfPlayConfig;
+
+TEST_CASE("selfplay parses arguments", "[selfplay]")
+{
+  SelfPlayConfig config;
+  REQUIRE(shepichess::parseSelfPlayArgs(
+    {"--games", "10", "--tc", "5+0.05", "--option2", "Hash File=a b", "--sprt", "0,5"},
+    config));
+  REQUIRE(config.games == 10);
+  REQUIRE(config.base_time == 5000);
+  REQUIRE(config.increment == 50);
+  REQUIRE(config.options[1].size() == 1);
+  REQUIRE(config.options[1][0].first == "Hash File");
+  REQUIRE(config.options[1][0].second == "a b");
+  REQUIRE(config.sprt);
+  REQUIRE(config.elo1 == 5.0);
+
+  SelfPlayConfig invalid;
+  REQUIRE_FALSE(shepichess::parseSelfPlayArgs({"--games", "10"}, invalid));
+  REQUIRE_FALSE(shepichess::parseSelfPlayArgs({"--nodes", "x"}, invalid));
+  REQUIRE_FALSE(shepichess::parseSelfPlayArgs({"--nodes"}, invalid));
+  REQUIRE_FALSE(shepichess::parseSelfPlayArgs({"--sprt", "5,0"}, invalid));
+}
+
+TEST_CASE("selfplay sprt", "[selfplay]")
+{
+  // An even match favours elo0, a lopsided one elo1
+  MatchScore even {400, 400, 200};
+  REQUIRE(shepichess::sprtLLR(even, 0.0, 5.0) < 0.0);
+  REQUIRE(shepichess::eloDifference(even) == 0.0);
+  MatchScore winning {500, 300, 200};
+  REQUIRE(shepichess::sprtLLR(winning, 0.0, 5.0) > 2.94);
+  REQUIRE(std::abs(shepichess::eloDifference(winning) - 70.4) < 0.1);
+  // A patch that never loses still passes
+  auto [lower, upper] = shepichess::sprtBounds(shepichess::SelfPlayConfig {});
+  REQUIRE(shepichess::sprtLLR({60, 0, 140}, 0.0, 5.0) >= upper);
+  REQUIRE(shepichess::sprtLLR({0, 60, 140}, 0.0, 5.0) <= lower);
+  // Without any spread in the results there is nothing to estimate
+  REQUIRE(shepichess::sprtLLR({0, 0, 50}, 0.0, 5.0) == 0.0);
+  REQUIRE(shepichess::sprtLLR({}, 0.0, 5.0) == 0.0);
+}
+
+TEST_CASE("selfplay plays games", "[selfplay]")
+{
+  std::string openings_path = "selfplay_test.epd";
+  std::string pgn_path = "selfplay_test.pgn";
+  std::remove(pgn_path.c_str());
+  {
+    std::ofstream openings(openings_path);
+    openings << "4k3/8/8/8/8/8/4P3/4K3 w - - id \"pawn\";\n";
+    openings << "not a position\n";
+  }
+
+  SelfPlayConfig config;
+  config.games = 3;
+  config.concurrency = 2;
+  config.nodes = 2000;
+  config.hash_size = 1;
+  config.openings = openings_path;
+  config.pgn = pgn_path;
+  config.options[1] = {{"Threads", "1"}};
+  std::stringstream out;
+  shepichess::SelfPlay selfplay(config, out);
+  REQUIRE(selfplay.run());
+  // Rounded up so both engines play each opening with both colors
+  REQUIRE(selfplay.score().games() == 4);
+  REQUIRE_THAT(out.str(), Contains("Finished 4"));
+
+  std::ifstream pgn(pgn_path);
+  std::stringstream games;
+  games << pgn.rdbuf();
+  REQUIRE_THAT(games.str(), Contains("[FEN \"4k3/8/8/8/8/8/4P3/4K3 w - - 0 1\"]"));
+  REQUIRE_THAT(games.str(), Contains("[Round \"4\"]"));
+  REQUIRE_THAT(games.str(), Contains("1. "));
+
+  // Unknown options and invalid values fail before any game is played
+  for (auto&& [name, value] : {std::pair {"No Such Option", "1"},
+                               std::pair {"Hash", "abc"},
+                               std::pair {"Hash", "0"}}) {
+    CAPTURE(name, value);
+    config.options[0] = {{name, value}};
+    shepichess::SelfPlay invalid(config, out);
+    REQUIRE_FALSE(invalid.run());
+    REQUIRE(invalid.score().games() == 0);
+  }
+  std::remove(openings_path.c_str());
+  std::remove(pgn_path.c_str());
+}
+
+TEST_CASE("selfplay writes training data", "[selfplay]")
+{
+  std::string data_path = "selfplay_test.data";
+  std::remove(data_path.c_str());
+  SelfPlayConfig config = shepichess::dataGenConfig();
+  REQUIRE(shepichess::parseSelfPlayArgs(
+    {"--games", "2", "--concurrency", "2", "--depth", "3", "--data", data_path},
+    config));
+  REQUIRE(config.random_plies > 0);
+  std::stringstream out;
+  shepichess::SelfPlay selfplay(config, out);
+  REQUIRE(selfplay.run());
+  REQUIRE(selfplay.score().games() == 2);
+
+  shepichess::TrainingDataReader reader;
+  REQUIRE(reader.open(data_path));
+  REQUIRE(reader.size() > 0);
+  REQUIRE_THAT(out.str(), Contains(std::to_string(reader.size()) + " positions"));
+  shepichess::Position position;
+  for (auto&& packed : reader) {
+    REQUIRE(packed.unpack(position));
+    REQUIRE_FALSE(position.inCheck());
+  }
+  reader.close();
+  std::remove(data_path.c_str());
+}
@@ -0,0 +1,254 @@
+#include "server.h"
+
+#if !defined(_WIN32)
+
+#  include <string>
+#  include <string_view>
+#  include <thread>
+#  include <vector>
+
+#  include <poll.h>
+#  include <sys/socket.h>
+#  include <sys/un.h>
+#  include <unistd.h>
+
+#  include <catch2/catch_test_macros.hpp>
+#  include <catch2/matchers/catch_matchers_string.hpp>
+
+using Catch::Matchers::Contains;
+using Catch::Matchers::StartsWith;
+
+namespace {
+
+const std::string kSocketPath = "shepichess_server_test.sock";
+
+// Blocking line based client, reads give up after a timeout so a broken server
+// fails the test instead of hanging it
+class Client {
+public:
+  Client()
+  {
+    fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    kSocketPath.copy(address.sun_path, sizeof(address.sun_path) - 1);
+    connected =
+      ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+  }
+  ~Client() { close(); }
+
+  Client(const Client&) = delete;
+  Client& operator=(const Client&) = delete;
+
+  void send(const std::string& line)
+  {
+    std::string data = line + '\n';
+    ::send(fd, data.data(), data.size(), 0);
+  }
+
+  // Returns the first line starting with prefix, or an empty string on timeout
+  // or disconnect. Lines before it are skipped.
+  std::string readUntil(std::string_view prefix)
+  {
+    while (true) {
+      size_t end = buffer.find('\n');
+      if (end != std::string::npos) {
+        std::string line = buffer.substr(0, end);
+        buffer.erase(0, end + 1);
+        if (line.compare(0, prefix.size(), prefix) == 0) return line;
+        continue;
+      }
+      pollfd poll_fd {fd, POLLIN, 0};
+      if (::poll(&poll_fd, 1, 10000) <= 0) return "";
+      char data[1024];
+      ssize_t received = ::recv(fd, data, sizeof(data), 0);
+      if (received <= 0) return "";
+      buffer.append(data, static_cast<size_t>(received));
+    }
+  }
+
+  void close()
+  {
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+  }
+
+  bool connected = false;
+
+private:
+  int fd = -1;
+  std::string buffer;
+};
+
+shepichess::ServerConfig testConfig(int workers)
+{
+  shepichess::ServerConfig config;
+  config.socket_path = kSocketPath;
+  config.workers = workers;
+  config.hash_size = 4;
+  return config;
+}
+
+} // namespace
+
+TEST_CASE("server parses arguments", "[server]")
+{
+  shepichess::ServerConfig config;
+  REQUIRE(shepichess::parseServerArgs(
+    {"--socket", "a.sock", "--workers", "3", "--sessions", "8", "--hash", "64",
+     "--nodes", "5000", "--movetime", "250"},
+    config));
+  REQUIRE(config.socket_path == "a.sock");
+  REQUIRE(config.workers == 3);
+  REQUIRE(config.max_sessions == 8);
+  REQUIRE(config.hash_size == 64);
+  REQUIRE(config.max_nodes == 5000);
+  REQUIRE(config.max_time == 250);
+
+  shepichess::ServerConfig invalid;
+  REQUIRE_FALSE(shepichess::parseServerArgs({"--workers", "2"}, invalid));
+  REQUIRE_FALSE(
+    shepichess::parseServerArgs({"--socket", "a", "--workers", "0"}, invalid));
+  REQUIRE_FALSE(
+    shepichess::parseServerArgs({"--socket", "a", "--sessions", "0"}, invalid));
+  REQUIRE_FALSE(shepichess::parseServerArgs({"--socket", "a", "--port", "1"}, invalid));
+  REQUIRE_FALSE(shepichess::parseServerArgs({"--socket"}, invalid));
+}
+
+TEST_CASE("server runs more sessions than workers", "[server]")
+{
+  shepichess::AnalysisServer server(testConfig(2));
+  REQUIRE(server.start());
+
+  constexpr int kSessions = 5;
+  std::vector<std::string> best_moves(kSessions);
+  std::vector<std::thread> clients;
+  for (int i = 0; i < kSessions; i++) {
+    clients.emplace_back([&best_moves, i]() {
+      Client client;
+      if (!client.connected) return;
+      client.send("uci");
+      if (client.readUntil("uciok").empty()) return;
+      // Sessions have their own positions
+      client.send(i % 2 ? "position startpos moves e2e4" : "position startpos");
+      client.send("go depth 5");
+      best_moves[i] = client.readUntil("bestmove");
+      client.send("quit");
+    });
+  }
+  for (auto&& client : clients) client.join();
+  for (auto&& best_move : best_moves) REQUIRE_THAT(best_move, StartsWith("bestmove "));
+  server.stop();
+}
+
+TEST_CASE("server session commands", "[server]")
+{
+  shepichess::AnalysisServer server(testConfig(1));
+  REQUIRE(server.start());
+  Client client;
+  REQUIRE(client.connected);
+
+  client.send("uci");
+  REQUIRE_THAT(client.readUntil("id name"), StartsWith("id name shepichess"));
+  REQUIRE_THAT(client.readUntil("option"), Contains("name MultiPV type spin"));
+  client.send("isready");
+  REQUIRE(client.readUntil("readyok") == "readyok");
+
+  // Scholar's mate
+  client.send("setoption name MultiPV value 2");
+  client.send(
+    "position fen r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 4 4");
+  client.send("go depth 3");
+  REQUIRE_THAT(client.readUntil("info depth 3"), Contains("multipv 1"));
+  REQUIRE_THAT(client.readUntil("info depth 3"), Contains("multipv 2"));
+  REQUIRE(client.readUntil("bestmove") == "bestmove h5f7");
+
+  // Invalid positions are reported and the previous one is kept
+  client.send("setoption name MultiPV value 1");
+  client.send("position startpos moves e2e5");
+  REQUIRE_THAT(client.readUntil("info string"), Contains("invalid position"));
+  client.send("go depth 3");
+  REQUIRE(client.readUntil("bestmove") == "bestmove h5f7");
+  server.stop();
+}
+
+TEST_CASE("server turns clients away above the session limit", "[server]")
+{
+  shepichess::ServerConfig config = testConfig(1);
+  config.max_sessions = 1;
+  shepichess::AnalysisServer server(config);
+  REQUIRE(server.start());
+  Client first;
+  REQUIRE(first.connected);
+  first.send("isready");
+  REQUIRE(first.readUntil("readyok") == "readyok");
+
+  {
+    Client second;
+    REQUIRE(second.connected);
+    REQUIRE_THAT(second.readUntil("info string"), Contains("too many sessions"));
+    REQUIRE(second.readUntil("anything").empty());
+  }
+
+  // Slots of disconnected sessions are reused
+  first.send("quit");
+  REQUIRE(first.readUntil("anything").empty());
+  Client third;
+  REQUIRE(third.connected);
+  third.send("isready");
+  REQUIRE(third.readUntil("readyok") == "readyok");
+  server.stop();
+}
+
+TEST_CASE("server limits every request", "[server]")
+{
+  shepichess::ServerConfig config = testConfig(1);
+  config.max_nodes = 20000;
+  shepichess::AnalysisServer server(config);
+  REQUIRE(server.start());
+
+  // Infinite searches end at the cap without stop
+  Client first;
+  REQUIRE(first.connected);
+  first.send("position startpos");
+  first.send("go infinite");
+  REQUIRE_THAT(first.readUntil("bestmove"), StartsWith("bestmove "));
+
+  // The only worker is busy with the first session, stopping the second one's
+  // queued search still answers with a bestmove
+  Client second;
+  REQUIRE(second.connected);
+  first.send("go infinite");
+  second.send("position startpos");
+  second.send("go depth 30");
+  second.send("stop");
+  REQUIRE_THAT(second.readUntil("bestmove"), StartsWith("bestmove "));
+  REQUIRE_THAT(first.readUntil("bestmove"), StartsWith("bestmove "));
+  server.stop();
+}
+
+TEST_CASE("server survives clients disconnecting mid search", "[server]")
+{
+  shepichess::AnalysisServer server(testConfig(1));
+  REQUIRE(server.start());
+  {
+    Client client;
+    REQUIRE(client.connected);
+    client.send("position startpos");
+    client.send("go infinite");
+    REQUIRE_THAT(client.readUntil("info depth"), StartsWith("info depth"));
+  }
+  Client next;
+  REQUIRE(next.connected);
+  next.send("position startpos");
+  next.send("go depth 2");
+  REQUIRE_THAT(next.readUntil("bestmove"), StartsWith("bestmove "));
+
+  // Stopping ends sessions that are still connected
+  Client idle;
+  REQUIRE(idle.connected);
+  server.stop();
+  REQUIRE(idle.readUntil("anything").empty());
+}
+
+#endif
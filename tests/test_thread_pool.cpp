@@ -0,0 +1,37 @@
+#include "thread_pool.h"
+
+#include <atomic>
+#include <mutex>
+#include <set>
+
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE("ThreadPool runs job on every thread", "[thread_pool]")
+{
+  shepichess::ThreadPool threads(4);
+  std::mutex lock;
+  std::set<size_t> indices;
+  threads.start([&](size_t index) {
+    std::scoped_lock insert_lock(lock);
+    indices.insert(index);
+  });
+  threads.wait();
+  REQUIRE(indices == std::set<size_t> {0, 1, 2, 3});
+  REQUIRE_FALSE(threads.busy());
+}
+
+TEST_CASE("ThreadPool reuses threads across jobs and resizes", "[thread_pool]")
+{
+  shepichess::ThreadPool threads(2);
+  std::atomic<int> runs = 0;
+  for (int i = 0; i < 100; i++) {
+    threads.start([&](size_t) { runs++; });
+  }
+  threads.wait();
+  REQUIRE(runs == 200);
+  threads.resize(3);
+  REQUIRE(threads.size() == 3);
+  threads.start([&](size_t) { runs++; });
+  threads.wait();
+  REQUIRE(runs == 203);
+}
@@ -0,0 +1,72 @@
+#include "tracing.h"
+
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
+
+using Catch::Matchers::Contains;
+
+namespace {
+
+std::string trace()
+{
+  std::stringstream out;
+  shepichess::writeTrace(out);
+  return out.str();
+}
+
+} // namespace
+
+TEST_CASE("Tracing records zones per thread", "[tracing]")
+{
+  REQUIRE_FALSE(shepichess::startTracing(""));
+  REQUIRE(shepichess::startTracing("test-trace.json"));
+  REQUIRE(shepichess::tracing());
+  REQUIRE(shepichess::tracePath() == "test-trace.json");
+  {
+    shepichess::TraceZone zone("test zone", "say \"hi\"");
+  }
+  std::thread worker([]() {
+    shepichess::setTraceThreadName("test worker");
+    shepichess::TraceZone zone("worker zone", 42);
+  });
+  worker.join();
+  shepichess::stopTracing();
+  {
+    shepichess::TraceZone zone("after stop");
+  }
+
+  std::string json = trace();
+  REQUIRE_THAT(json, Contains("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+  REQUIRE_THAT(
+    json,
+    Contains("{\"name\":\"test zone\",\"ph\":\"X\"") &&
+      Contains("\"args\":{\"detail\":\"say \\\"hi\\\"\"}"));
+  // The worker's events outlive it
+  REQUIRE_THAT(
+    json,
+    Contains("\"args\":{\"name\":\"test worker\"}") &&
+      Contains("\"args\":{\"detail\":\"42\"}"));
+  REQUIRE_THAT(json, !Contains("after stop"));
+}
+
+TEST_CASE("Tracing keeps the latest events and drops old recordings", "[tracing]")
+{
+  REQUIRE(shepichess::startTracing("test-trace.json"));
+  shepichess::traceEvent("old recording", 0, 1);
+  REQUIRE(shepichess::startTracing("test-trace.json"));
+  int64_t now = shepichess::traceClock();
+  shepichess::traceEvent("overwritten", now, now);
+  for (size_t i = 0; i < shepichess::kTraceBufferSize; i++) {
+    shepichess::traceEvent("kept", now, now + 1000);
+  }
+  shepichess::stopTracing();
+
+  std::string json = trace();
+  REQUIRE_THAT(json, Contains("\"name\":\"kept\""));
+  REQUIRE_THAT(json, !Contains("overwritten") && !Contains("old recording"));
+  REQUIRE_THAT(json, Contains("\"dur\":1.000"));
+}
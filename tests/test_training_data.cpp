@@ -0,0 +1,92 @@
+#include "training_data.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "bitboard.h"
+#include "position.h"
+
+using shepichess::PackedPosition;
+using shepichess::Position;
+
+TEST_CASE("training data packs positions", "[training_data]")
+{
+  shepichess::bitboards::init();
+  constexpr const char* kFens[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "rnbqkbnr/pppp1ppp/8/8/4pP2/8/PPPPP1PP/RNBQKBNR b Kq f3 0 3",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 47 120",
+  };
+  Position position;
+  for (const char* fen : kFens) {
+    CAPTURE(fen);
+    REQUIRE(position.setFen(fen));
+    PackedPosition packed = PackedPosition::pack(position, -35);
+    REQUIRE(packed.score == -35);
+    REQUIRE(packed.result == PackedPosition::Draw);
+    REQUIRE(packed.fen() == fen);
+    Position unpacked;
+    REQUIRE(packed.unpack(unpacked));
+    REQUIRE(unpacked.zobrist() == position.zobrist());
+  }
+}
+
+TEST_CASE("training data writers and reader", "[training_data]")
+{
+  shepichess::bitboards::init();
+  std::string path = "training_data_test.data";
+  std::remove(path.c_str());
+  Position position;
+  constexpr int kThreads = 4;
+  // More than one buffer per thread, so writes interleave in the file
+  constexpr int kPositions = shepichess::TrainingDataWriter::kBufferSize + 100;
+
+  shepichess::TrainingDataFile file;
+  REQUIRE(file.open(path));
+  std::vector<std::thread> threads;
+  for (int thread = 0; thread < kThreads; thread++) {
+    threads.emplace_back([&, thread] {
+      shepichess::TrainingDataWriter writer(file);
+      for (int i = 0; i < kPositions; i++) {
+        writer.push(PackedPosition::pack(position, thread * kPositions + i));
+      }
+    });
+  }
+  for (auto&& thread : threads) thread.join();
+  REQUIRE(file.positionsWritten() == kThreads * kPositions);
+  file.close();
+
+  shepichess::TrainingDataReader reader;
+  REQUIRE(reader.open(path));
+  REQUIRE(reader.size() == kThreads * kPositions);
+  std::vector<bool> seen(kThreads * kPositions);
+  for (auto&& packed : reader) {
+    REQUIRE(packed.fen() == shepichess::kStartFen);
+    seen[packed.score] = true;
+  }
+  REQUIRE(std::find(seen.begin(), seen.end(), false) == seen.end());
+  reader.close();
+
+  // Opening again appends
+  REQUIRE(file.open(path));
+  {
+    shepichess::TrainingDataWriter writer(file);
+    writer.push(PackedPosition::pack(position, 0));
+  }
+  file.close();
+  REQUIRE(reader.open(path));
+  REQUIRE(reader.size() == kThreads * kPositions + 1);
+  reader.close();
+
+  // Partial records are rejected
+  std::ofstream(path, std::ios::binary | std::ios::app) << "x";
+  REQUIRE_FALSE(reader.open(path));
+  std::remove(path.c_str());
+}
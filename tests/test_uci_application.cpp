@@ -5,6 +5,8 @@
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_string.hpp>
 
+#include "cpu.h"
+
 using Catch::Matchers::Contains;
 using Catch::Matchers::EndsWith;
 
@@ -16,6 +18,9 @@ TEST_CASE("uci_application command uci", "[application]")
   app.mainLoop();
   REQUIRE_THAT(
     out.str(), Contains("id author") && Contains("id name") && EndsWith("uciok\n"));
+  // The instruction set is part of the name
+  std::string cpu {shepichess::cpuLevelName(shepichess::cpuLevel())};
+  REQUIRE_THAT(out.str(), Contains("id name shepichess (" + cpu + ")"));
 }
 
 TEST_CASE("uci_application command isready", "[application]")
@@ -25,4 +30,170 @@ TEST_CASE("uci_application command isready", "[application]")
   shepichess::UCIApp app(in, out);
   app.mainLoop();
   REQUIRE(out.str() == "readyok\n");
-}
\ No newline at end of file
+}
+
+TEST_CASE("uci_application advertises options", "[application]")
+{
+  std::stringstream in {"uci\nquit\n"};
+  std::stringstream out;
+  shepichess::UCIApp app(in, out);
+  app.mainLoop();
+  REQUIRE_THAT(
+    out.str(),
+    Contains("option name Hash type spin") &&
+      Contains("option name Threads type spin") &&
+      Contains("option name Clear Hash type button"));
+}
+
+TEST_CASE("uci_application setoption Hash and Threads", "[application]")
+{
+  std::stringstream in {
+    "setoption name Hash value 2\nsetoption name Threads value 2\n"
+    "setoption name Clear Hash\nucinewgame\nisready\nquit\n"};
+  std::stringstream out;
+  shepichess::UCIApp app(in, out);
+  app.mainLoop();
+  REQUIRE(out.str() == "readyok\n");
+}
+
+// Waiting for go infinite to finish would block before reading the stop
+TEST_CASE("uci_application refuses reconfiguring while searching", "[application]")
+{
+  std::stringstream in {
+    "go infinite\n"
+    "setoption name Hash value 2\n"
+    "setoption name Threads value 2\n"
+    "ucinewgame\n"
+    "bench 1\n"
+    "stop\n"
+    "setoption name Hash value 2\n"
+    "isready\n"
+    "quit\n"};
+  std::stringstream out;
+  shepichess::UCIApp app(in, out);
+  app.mainLoop();
+  REQUIRE_THAT(
+    out.str(),
+    Contains("info string Hash ignored while searching") &&
+      Contains("info string Threads ignored while searching") &&
+      Contains("info string ucinewgame ignored while searching") &&
+      Contains("info string bench ignored while searching") &&
+      EndsWith("readyok\n"));
+  // Accepted again once stopped
+  std::string output = out.str();
+  REQUIRE(output.find("Hash ignored") == output.rfind("Hash ignored"));
+}
+
+TEST_CASE("uci_application position moves are applied incrementally", "[application]")
+{
+  std::stringstream in {
+    "position startpos moves e2e4 e7e5\n"
+    "position startpos moves e2e4 e7e5 g1f3 b8c6\n"
+    // Take back a move and play a different one
+    "position startpos moves e2e4 e7e5 g1f3 g8f6\n"
+    "quit\n"};
+  std::stringstream out;
+  shepichess::UCIApp app(in, out);
+  app.mainLoop();
+  const shepichess::Position& position = app.getPosition();
+  REQUIRE(
+    position.fen() ==
+    "rnbqkb1r/pppp1ppp/5n2/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3");
+  REQUIRE(position.gamePly() == 4);
+}
+
+TEST_CASE("uci_application keeps the position on invalid commands", "[application]")
+{
+  std::stringstream in {
+    "position startpos moves e2e4 e7e5\n"
+    // Takes back e7e5 before reaching the illegal move
+    "position startpos moves e2e4 d7d5 e1e3\n"
+    "position fen 4k3/8/8/8/8/8/4P3/4K3 w - - 0 1 moves e2e5\n"
+    "position fen not a fen\n"
+    "position somewhere\n"
+    // Still applied incrementally from the kept moves
+    "position startpos moves e2e4 e7e5 g1f3\n"
+    "quit\n"};
+  std::stringstream out;
+  shepichess::UCIApp app(in, out);
+  app.mainLoop();
+  REQUIRE(
+    app.getPosition().fen() ==
+    "rnbqkbnr/pppp1ppp/8/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R b KQkq - 1 2");
+  std::string output = out.str();
+  size_t count = 0;
+  for (size_t at = output.find("info string invalid position"); at != output.npos;
+       at = output.find("info string invalid position", at + 1)) {
+    count++;
+  }
+  REQUIRE(count == 4);
+}
+
+TEST_CASE("uci_application takes back more moves than kept", "[application]")
+{
+  // Knights shuffle back and forth for longer than the position history
+  std::string moves;
+  for (int i = 0; i < shepichess::kHistorySize / 2; i++) {
+    moves += " g1f3 g8f6 f3g1 f6g8";
+  }
+  std::stringstream in {
+    "position startpos moves" + moves + "\n" +
+    "position startpos moves e2e4\n"
+    "quit\n"};
+  std::stringstream out;
+  shepichess::UCIApp app(in, out);
+  app.mainLoop();
+  const shepichess::Position& position = app.getPosition();
+  REQUIRE(
+    position.fen() == "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1");
+  REQUIRE(position.gamePly() == 1);
+}
+
+TEST_CASE("uci_application position fen", "[application]")
+{
+  std::stringstream in {
+    "position fen 4k3/8/8/8/8/8/4P3/4K3 w - - 0 1 moves e2e4 e8d7\n"
+    "position startpos\n"
+    "position fen 4k3/8/8/8/8/8/4P3/4K3 w - - 0 1 moves e2e4 e8d8\n"
+    "quit\n"};
+  std::stringstream out;
+  shepichess::UCIApp app(in, out);
+  app.mainLoop();
+  REQUIRE(app.getPosition().fen() == "3k4/8/8/8/4P3/8/8/4K3 w - - 1 2");
+}
+
+TEST_CASE("uci_application go", "[application]")
+{
+  std::stringstream in {"position startpos moves e2e4\ngo depth 2\nisready\nquit\n"};
+  std::stringstream out;
+  shepichess::UCIApp app(in, out);
+  app.mainLoop();
+  // quit stops the search, but a bestmove must still be sent
+  REQUIRE_THAT(out.str(), Contains("readyok") && Contains("bestmove"));
+}
+
+TEST_CASE("uci_application go ponder and ponderhit", "[application]")
+{
+  std::stringstream in {
+    "uci\n"
+    "position startpos moves e2e4\n"
+    "go ponder wtime 1000 btime 1000\n"
+    "ponderhit\n"
+    "isready\n"
+    "quit\n"};
+  std::stringstream out;
+  shepichess::UCIApp app(in, out);
+  app.mainLoop();
+  REQUIRE_THAT(out.str(), Contains("option name Ponder type check default false"));
+  REQUIRE_THAT(out.str(), Contains("readyok") && Contains("bestmove"));
+}
+
+TEST_CASE("uci_application bench", "[application]")
+{
+  std::stringstream in {
+    "setoption name Null Move Pruning value false\nbench 3\nbench 0\nquit\n"};
+  std::stringstream out;
+  shepichess::UCIApp app(in, out);
+  app.mainLoop();
+  REQUIRE_THAT(out.str(), Contains(" nodes ") && Contains(" nps\n"));
+}
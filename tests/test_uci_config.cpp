@@ -0,0 +1,84 @@
+#include "uci_config.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+using shepichess::UCIConfig, shepichess::UCIOption;
+
+TEST_CASE("UCIOption uciString", "[uci_config]")
+{
+  REQUIRE(
+    UCIOption::spin("Hash", 16, 1, 1024).uciString() ==
+    "name Hash type spin default 16 min 1 max 1024");
+  REQUIRE(
+    UCIOption::check("Ponder", false).uciString() ==
+    "name Ponder type check default false");
+  REQUIRE(
+    UCIOption::combo("Style", "Normal", {"Solid", "Normal"}).uciString() ==
+    "name Style type combo default Normal var Solid var Normal");
+  REQUIRE(
+    UCIOption::button("Clear Hash", {}).uciString() == "name Clear Hash type button");
+  REQUIRE(
+    UCIOption::string("Log File", "").uciString() ==
+    "name Log File type string default <empty>");
+}
+
+TEST_CASE("UCIOption spin bounds", "[uci_config]")
+{
+  UCIOption option = UCIOption::spin("Threads", 1, 1, 8);
+  REQUIRE(option.set("4"));
+  REQUIRE(option.asInt() == 4);
+  REQUIRE_FALSE(option.set("0"));
+  REQUIRE_FALSE(option.set("9"));
+  REQUIRE_FALSE(option.set("4x"));
+  REQUIRE_FALSE(option.set(""));
+  REQUIRE(option.asInt() == 4);
+}
+
+TEST_CASE("UCIOption check and combo values", "[uci_config]")
+{
+  UCIOption check = UCIOption::check("Ponder", false);
+  REQUIRE(check.set("true"));
+  REQUIRE(check.asBool());
+  REQUIRE_FALSE(check.set("yes"));
+  UCIOption combo = UCIOption::combo("Style", "Normal", {"Solid", "Normal"});
+  REQUIRE(combo.set("solid"));
+  REQUIRE(combo.asString() == "Solid");
+  REQUIRE_FALSE(combo.set("Risky"));
+}
+
+TEST_CASE("UCIConfig setOption", "[uci_config]")
+{
+  UCIConfig config;
+  int64_t hash_size = 0;
+  int button_presses = 0;
+  auto resizeHash = [&](const UCIOption& option) {
+    hash_size = option.asInt();
+    return true;
+  };
+  auto clearHash = [&](const UCIOption&) {
+    button_presses++;
+    return true;
+  };
+  config.addOption(UCIOption::spin("Hash", 16, 1, 1024, resizeHash));
+  config.addOption(UCIOption::button("Clear Hash", clearHash));
+  // Names are case insensitive
+  REQUIRE(config.setOption("hash", "32"));
+  REQUIRE(hash_size == 32);
+  REQUIRE(config.getOption("HASH")->asInt() == 32);
+  REQUIRE_FALSE(config.setOption("Hash", "2048"));
+  REQUIRE(hash_size == 32);
+  REQUIRE(config.setOption("Clear Hash", ""));
+  REQUIRE(button_presses == 1);
+  REQUIRE_FALSE(config.setOption("Unknown", "1"));
+  REQUIRE(config.getOption("Unknown") == nullptr);
+}
+
+TEST_CASE("UCIConfig rolls back values the callback rejects", "[uci_config]")
+{
+  UCIConfig config;
+  auto resizeHash = [](const UCIOption& option) { return option.asInt() <= 64; };
+  config.addOption(UCIOption::spin("Hash", 16, 1, 1024, resizeHash));
+  REQUIRE(config.setOption("Hash", "64"));
+  REQUIRE_FALSE(config.setOption("Hash", "128"));
+  REQUIRE(config.getOption("Hash")->asInt() == 64);
+}
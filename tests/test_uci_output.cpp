@@ -0,0 +1,43 @@
+#include "uci_output.h"
+
+#include <chrono>
+#include <sstream>
+#include <thread>
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("uci_output info lines are coalesced", "[uci_output]")
+{
+  std::stringstream out;
+  shepichess::UCIOutput output(out, 1h);
+  output.sendInfo("info depth 1");
+  output.sendInfo("info depth 2");
+  output.sendInfo("info depth 3");
+  // Only the first line is written, the rest are held until the interval passes
+  REQUIRE(out.str() == "info depth 1\n");
+  output.sendBestMove("bestmove e2e4");
+  REQUIRE(out.str() == "info depth 1\ninfo depth 3\nbestmove e2e4\n");
+}
+
+TEST_CASE("uci_output writes held info after the interval", "[uci_output]")
+{
+  std::stringstream out;
+  shepichess::UCIOutput output(out, 20ms);
+  output.sendInfo("info depth 1");
+  output.sendInfo("info depth 2");
+  std::this_thread::sleep_for(200ms);
+  // Taking the output's lock orders the read after the background write
+  output.flush();
+  REQUIRE(out.str() == "info depth 1\ninfo depth 2\n");
+}
+
+TEST_CASE("uci_output regular lines are not rate limited", "[uci_output]")
+{
+  std::stringstream out;
+  shepichess::UCIOutput output(out, 1h);
+  output.send("readyok");
+  output.send("readyok");
+  REQUIRE(out.str() == "readyok\nreadyok\n");
+}
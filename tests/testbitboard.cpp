@@ -1,5 +1,7 @@
 #include "bitboard.h"
 
+#include <random>
+
 #include <catch2/catch_test_macros.hpp>
 
 using shepichess::Bitboard, shepichess::Direction;
@@ -154,4 +156,59 @@ TEST_CASE("attack_maps::queenAttacks", "[bitboard, attack_maps]")
   Bitboard blockers = 0xff'ff'c3'c3'c3'c3'ff'ff;
   REQUIRE(queenAttacks(27, 0) == 0x88'49'2a'1c'f7'1c'2a'49);
   REQUIRE(queenAttacks(27, blockers) == 0x00'48'2a'1c'76'1c'2a'00);
-}
\ No newline at end of file
+}
+TEST_CASE("attack_maps::between and line", "[bitboard, attack_maps]")
+{
+  using shepichess::attack_maps::between, shepichess::attack_maps::line;
+  shepichess::bitboards::init();
+  // h1-h8 and h1-a8
+  REQUIRE(between(0, 56) == 0x00'01'01'01'01'01'01'00);
+  REQUIRE(between(56, 0) == between(0, 56));
+  REQUIRE(line(0, 56) == 0x01'01'01'01'01'01'01'01);
+  REQUIRE(between(0, 63) == 0x00'40'20'10'08'04'02'00);
+  REQUIRE(line(9, 18) == 0x80'40'20'10'08'04'02'01);
+  // Adjacent squares have nothing between them, h1-f2 aren't aligned
+  REQUIRE(between(0, 1) == 0);
+  REQUIRE(line(0, 1) == 0xff);
+  REQUIRE(between(0, 10) == 0);
+  REQUIRE(line(0, 10) == 0);
+}
+
+TEST_CASE("bitboards::occludedFill", "[bitboard]")
+{
+  using shepichess::bitboards::fromSquare;
+  using shepichess::bitboards::occludedFill;
+  using shepichess::bitboards::slidingAttacks;
+  // Rooks on a1 and h4, blocker on a5
+  Bitboard rooks = fromSquare(7) | fromSquare(24);
+  Bitboard empty = ~(rooks | fromSquare(39));
+  REQUIRE(occludedFill<Direction::North>(rooks, empty) == 0x01'01'01'01'81'80'80'80);
+  REQUIRE(slidingAttacks<Direction::North>(rooks, empty) == 0x01'01'01'81'80'80'80'00);
+  REQUIRE(slidingAttacks<Direction::East>(rooks, empty) == 0x7f);
+  REQUIRE(slidingAttacks<Direction::West>(rooks, empty) == 0xfe'00'00'00);
+  // Fills don't wrap around the board edges
+  REQUIRE(slidingAttacks<Direction::NorthEast>(fromSquare(24), ~Bitboard {0}) == 0);
+  REQUIRE(slidingAttacks<Direction::SouthWest>(fromSquare(31), ~Bitboard {0}) == 0);
+}
+
+TEST_CASE("attack_maps setwise attacks match magics", "[bitboard, attack_maps]")
+{
+  using namespace shepichess::attack_maps;
+  shepichess::bitboards::init();
+  std::mt19937_64 rng {42};
+  for (int i = 0; i < 1000; i++) {
+    Bitboard occupancy = rng() & rng();
+    Bitboard rooks = occupancy & rng() & rng(), bishops = occupancy & rng() & rng();
+    Bitboard rook_attacks = 0, bishop_attacks = 0;
+    for (Bitboard set = rooks; set; set = shepichess::bitboards::poplsb(set)) {
+      rook_attacks |= rookAttacks(shepichess::bitboards::bitscan(set), occupancy);
+    }
+    for (Bitboard set = bishops; set; set = shepichess::bitboards::poplsb(set)) {
+      bishop_attacks |= bishopAttacks(shepichess::bitboards::bitscan(set), occupancy);
+    }
+    REQUIRE(rookAttacksSetwise(rooks, occupancy) == rook_attacks);
+    REQUIRE(bishopAttacksSetwise(bishops, occupancy) == bishop_attacks);
+    REQUIRE(
+      sliderAttacks(rooks, bishops, occupancy) == (rook_attacks | bishop_attacks));
+  }
+}